@@ -3,30 +3,41 @@
 #include <mutex>
 #include <chrono>
 #include <vector>
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "magazine.h"
 
 using namespace std;
 using namespace std::chrono;
 
 /*
-	䵿ȭ
+	성긴동기화
 
-	1.  ü mtx ü  ִ.
-	2. push pop  lock Ѵ.
+	1. 스택 객체가 mtx 객체를 가지고 있다.
+	2. push와 pop이 같은 lock을 가져야한다.
+	3. 노드는 new, delete 대신 스레드별 Magazine에서 꺼내고 반환한다. -> 전역 할당자가 숨은 직렬화 지점이 되지 않도록
+	4. top과 next는 락 안에서만 읽고 쓰므로 volatile도 atomic도 필요없다. -> lock, unlock이 acquire, release
 */
 
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
 class Node
 {
 public:
 	int key{};
-	Node* volatile next{};
+	Node* next{};
 	Node() = default;
 	Node(int newKey) { key = newKey; }
 	~Node() = default;
 };
 
+Magazine<Node, MAX_THREADS> magazine{};
+NodeStats<MAX_THREADS> stats{};
+
 class Stack
 {
-	Node* volatile top{};
+	Node* top{};
 	mutex mtx{};
 public:
 	Stack() = default;
@@ -39,15 +50,25 @@ public:
 		{
 			ptr = top;
 			top = ptr->next;
-			delete ptr;
+			magazine.free(THREAD_ID, ptr);
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
 		}
 	}
+	Node* newNode(int key)
+	{
+		Node* node{ magazine.alloc(THREAD_ID) };
+		stats.onAlloc(THREAD_ID);
+		node->key = key;
+		node->next = nullptr;
+		return node;
+	}
 	void push(int key)
 	{
-		Node* newNode{ new Node{key} };
+		Node* node{ newNode(key) };
 		mtx.lock();
-		newNode->next = top;
-		top = newNode;
+		node->next = top;
+		top = node;
 		mtx.unlock();
 	}
 	int pop()
@@ -58,7 +79,9 @@ public:
 		int val{ cur->key };
 		top = top->next;
 		mtx.unlock();
-		delete cur;
+		magazine.free(THREAD_ID, cur);
+		stats.onRemove(THREAD_ID);
+		stats.onFree(THREAD_ID);
 		return val;
 	}
 	void printElement(int count)
@@ -75,12 +98,13 @@ public:
 };
 
 constexpr int NUM_TEST{ 10000000 };
-constexpr int MAX_THREADS{ 8 };
 
 Stack stk;
 
-void ThreadFunc(int numOfThread)
+void ThreadFunc(int numOfThread, int threadID)
 {
+	THREAD_ID = threadID;
+
 	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
 	{
 		switch (rand() % 2 || i < 1000 / numOfThread)
@@ -95,20 +119,29 @@ void ThreadFunc(int numOfThread)
 int main()
 {
 	vector<thread> threads{};
+	RssSampler sampler{};
 
 	for (int i = 1; i <= MAX_THREADS; i *= 2)
 	{
 		threads.clear();
 		stk.init();
+		magazine.resetCount();
 
+		sampler.start();
 		auto start{ high_resolution_clock::now() };
 
-		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i);
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
 		for (auto& thread : threads) thread.join();
+		sampler.stop();
 
 		stk.printElement(20);
 
 		auto duration{ high_resolution_clock::now() - start };
-		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds\n";
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << "Allocator Calls = " << magazine.getAllocatorCalls() << " (new/delete = " << magazine.getRequests() << ")\n";
+		stats.print();
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
 	}
 }
\ No newline at end of file
@@ -4,77 +4,121 @@
 #include <atomic>
 #include <chrono>
 #include <vector>
+#include "hazard_pointer.h"
+#include "magazine.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
 
 using namespace std;
 using namespace std::chrono;
 
 /*
-	䵿ȭ
-
-	1.  ü mtx ü  ִ.
-	2. push pop  lock Ѵ.
+	성긴동기화
+
+	1. 스택 객체가 mtx 객체를 가지고 있다.
+	2. push와 pop이 같은 lock을 가져야한다.
+	3. pop한 노드는 해저드 포인터로 보호하고, 아무도 참조하지 않을 때 delete한다. -> ABA, 해제된 메모리 접근 방지
+	4. 노드는 new, delete 대신 스레드별 Magazine에서 꺼내고 반환한다. -> 전역 할당자가 숨은 직렬화 지점이 되지 않도록
+	5. top은 atomic으로 선언하고 CAS는 release, 읽기는 acquire(해저드 포인터의 재확인)로 한다.
+	   -> next는 스택에 들어가기 전에만 쓰고, 들어간 뒤에는 읽기만 하므로 atomic이 아니어도 된다.
 */
 
+constexpr int MAX_THREADS{ 8 };
+constexpr int SCAN_THRESHOLD{ 64 };	// retire 리스트가 이만큼 쌓이면 scan
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
 class Node
 {
 public:
 	int key{};
-	Node* volatile next{};
+	Node* next{};
 	Node() = default;
 	Node(int newKey) { key = newKey; }
 	~Node() = default;
 };
 
+Magazine<Node, MAX_THREADS> magazine{};
+NodeStats<MAX_THREADS> stats{};
+
+// 해저드 포인터가 해제할 노드를 delete하는 대신 매거진에 반환
+struct NodeDeleter
+{
+	void operator()(Node* node) const
+	{
+		magazine.free(THREAD_ID, node);
+		stats.onFree(THREAD_ID);
+	}
+};
+
 class Stack
 {
-	Node* volatile top{};
+	atomic<Node*> top{};
+	HazardPointer<Node, MAX_THREADS, 1, NodeDeleter> hp{ SCAN_THRESHOLD };
 public:
 	Stack() = default;
 	~Stack() { init(); }
 
 	void init()
 	{
-		Node* ptr{};
-		while (top)
+		Node* ptr{ top.load(memory_order_relaxed) };
+		while (ptr)
 		{
-			ptr = top;
-			top = ptr->next;
-			delete ptr;
+			Node* next{ ptr->next };
+			magazine.free(THREAD_ID, ptr);
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
+			ptr = next;
 		}
+		top.store(nullptr, memory_order_relaxed);
+		hp.clear();
 	}
+	Node* newNode(int key)
+	{
+		Node* node{ magazine.alloc(THREAD_ID) };
+		stats.onAlloc(THREAD_ID);
+		node->key = key;
+		node->next = nullptr;
+		return node;
+	}
+	void setReclaim(bool reclaim) { hp.setEnabled(reclaim); }
 
-	bool CAS(Node* volatile& addr, const Node* oldNode, const Node* newNode)
+	bool CAS(atomic<Node*>& addr, Node* oldNode, Node* newNode)
 	{
-		long long oldvalue{ reinterpret_cast<long long>(oldNode) };
-		long long newvalue{ reinterpret_cast<long long>(newNode) };
-		return atomic_compare_exchange_strong((atomic<long long> volatile*)(&addr), &oldvalue, newvalue);
+		return addr.compare_exchange_strong(oldNode, newNode, memory_order_release, memory_order_relaxed);
 	}
 
 	void push(int key)
 	{
-		Node* newNode{ new Node{key} };
+		Node* node{ newNode(key) };
 
 		while (true)
 		{
-			Node* cur{ top };
-			newNode->next = cur;
-			if (CAS(top, cur, newNode)) return;
+			Node* cur{ top.load(memory_order_relaxed) };
+			node->next = cur;
+			if (CAS(top, cur, node)) return;
 		}
 	}
 	int pop()
 	{
 		while (true)
 		{
-			Node* cur{ top };
+			Node* cur{ hp.protect(THREAD_ID, 0, top) };
 			if (!cur) return -1;
 
 			int val{ cur->key };
-			if (CAS(top, cur, cur->next)) { /*delete cur;*/ return val; }
+			if (CAS(top, cur, cur->next))
+			{
+				hp.release(THREAD_ID);
+				stats.onRemove(THREAD_ID);
+				hp.retire(THREAD_ID, cur);
+				return val;
+			}
 		}
 	}
 	void printElement(int count)
 	{
-		Node* cur{ top };
+		Node* cur{ top.load() };
 		for (int i = 0; i < count; ++i)
 		{
 			if (!cur) break;
@@ -86,12 +130,13 @@ public:
 };
 
 constexpr int NUM_TEST{ 10000000 };
-constexpr int MAX_THREADS{ 8 };
 
 Stack stk;
 
-void ThreadFunc(int numOfThread)
+void ThreadFunc(int numOfThread, int threadID)
 {
+	THREAD_ID = threadID;
+
 	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
 	{
 		switch (rand() % 2 || i < 1000 / numOfThread)
@@ -106,20 +151,44 @@ void ThreadFunc(int numOfThread)
 int main()
 {
 	vector<thread> threads{};
+	RssSampler sampler{};
 
-	for (int i = 1; i <= MAX_THREADS; i *= 2)
-	{
-		threads.clear();
-		stk.init();
-
-		auto start{ high_resolution_clock::now() };
+	stressQueue(MAX_THREADS, STRESS_OPS, false,
+		[](int threadID, int value) { THREAD_ID = threadID; stk.push(value); },
+		[](int threadID) { THREAD_ID = threadID; return stk.pop(); });
 
-		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i);
-		for (auto& thread : threads) thread.join();
-
-		stk.printElement(20);
+	// 해저드 포인터로 노드를 해제하는 버전과 해제하지 않는 메모리 릭 버전을 비교
+	for (bool reclaim : { true, false })
+	{
+		stk.setReclaim(reclaim);
+		cout << (reclaim ? "[Hazard Pointer]\n" : "[Leak]\n");
 
-		auto duration{ high_resolution_clock::now() - start };
-		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds\n";
+		for (int i = 1; i <= MAX_THREADS; i *= 2)
+		{
+			threads.clear();
+			stk.init();
+			magazine.resetCount();
+
+			size_t startMemory{ getResidentMemory() };
+			sampler.start();
+			auto start{ high_resolution_clock::now() };
+
+			for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
+			for (auto& thread : threads) thread.join();
+			sampler.stop();
+
+			stk.printElement(20);
+
+			auto duration{ high_resolution_clock::now() - start };
+			double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+			size_t endMemory{ getResidentMemory() };
+			cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+			cout << duration_cast<nanoseconds>(duration).count() / NUM_TEST << " ns/op, ";
+			cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB), ";
+			cout << "Allocator Calls = " << magazine.getAllocatorCalls() << " (new/delete = " << magazine.getRequests() << ")\n";
+			stats.print();
+			cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+			cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+		}
 	}
 }
\ No newline at end of file
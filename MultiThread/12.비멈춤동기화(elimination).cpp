@@ -4,80 +4,96 @@
 #include <atomic>
 #include <chrono>
 #include <vector>
+#include "hazard_pointer.h"
+#include "magazine.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
 
 using namespace std;
 using namespace std::chrono;
 
 /*
-	䵿ȭ(elimination)
+	성긴동기화(elimination)
 
-	1. push pop  ÿ Ͼ  꿡 Ѵ. (ȯ )
-	2.  浹󵵿  BackOff Ѵ.
+	1. push와 pop이 거의 동시에 일어난 경우 연산에서 제외한다. (교환자 구현)
+	2. 스레드 충돌빈도에 따라 BackOff를 설정한다.
+	3. pop한 노드는 해저드 포인터로 보호하고, 아무도 참조하지 않을 때 delete한다. -> ABA, 해제된 메모리 접근 방지
+	4. 노드는 new, delete 대신 스레드별 Magazine에서 꺼내고 반환한다. -> 전역 할당자가 숨은 직렬화 지점이 되지 않도록
 
-	  ڵ    ->  ȭؾ
+	5. pop은 교환자에 POP을 넣는다. push는 상대가 pop일 때만, pop은 상대가 push일 때만 교환에 성공한 것으로 본다.
+	   -> push끼리, pop끼리 만나면 둘 다 실패로 보고 스택을 다시 시도한다.
+	6. 기다리던 스레드가 포기할 때도 CAS로 슬롯을 비운다. -> 그 사이에 상대가 값을 넣었다면 교환에 성공한 것
+	7. top은 atomic으로 선언하고 CAS는 release, 교환자의 슬롯은 acq_rel로 한다.
+
+	※ 현재 코드는 성능이 개선되지 않음 -> 좀더 최적화해야함
 */
 
 constexpr int NUM_TEST{ 10000000 };
 constexpr int MAX_THREADS{ 8 };
-thread_local int NUM_THREADS{};		// 帶 NUM_THREADS  Ҵ
+constexpr int SCAN_THRESHOLD{ 64 };	// retire 리스트가 이만큼 쌓이면 scan
+thread_local int NUM_THREADS{};		// 스레드마다 NUM_THREADS 변수가 할당됨
+thread_local int THREAD_ID{};
+
+constexpr int VALUE_MASK{ 0x3FFFFFFF };		// 교환자 슬롯에 담을 수 있는 값
+constexpr int POP{ VALUE_MASK };			// pop이 교환자에 넣는 값 -> push하는 값은 이보다 작아야 한다.
 
 class Exchanger
 {
 private:
 	enum class State { EMPTY, WAITING, BUSY };
 private:
-	atomic<int> slot{};
+	atomic<int> slot{};		// | state(2) | value(30) |
 private:
-	State getState()
-	{
-		int tmp{ slot };
-		return static_cast<State>(tmp >> 30 & 0x3);
-	}
-	int getValue()
+	static State getState(int tmp) { return static_cast<State>(tmp >> 30 & 0x3); }
+	static int getValue(int tmp) { return tmp & VALUE_MASK; }
+	static int pack(State state, int value) { return (static_cast<int>(state) << 30) | value; }
+	bool CAS(int oldSlot, State newState, int newValue)
 	{
-		int tmp{ slot };
-		return tmp & 0x7FFFFFFF;
+		return slot.compare_exchange_strong(oldSlot, pack(newState, newValue), memory_order_acq_rel, memory_order_relaxed);
 	}
-	bool CAS(State oldState, State newState, int oldValue, int newValue)
+	// 상대가 남긴 값을 가져가고 슬롯을 비운다. BUSY인 동안은 아무도 슬롯을 바꾸지 않는다.
+	int take()
 	{
-		int oldSlot{ (static_cast<int>(oldState) << 30) + oldValue };
-		int newSlot{ (static_cast<int>(newState) << 30) + newValue };
-
-		return atomic_compare_exchange_strong(&slot, &oldSlot, newSlot);
+		int value{ getValue(slot.load(memory_order_acquire)) };
+		slot.store(0, memory_order_release);
+		return value;
 	}
 public:
-	int exchange(int val, bool* isTimeOut, bool* isBusy)
+	// 교환에 성공하면 상대의 값을 partner에 담고 true를 반환한다.
+	bool exchange(int value, int* partner, bool* isTimeOut, bool* isBusy)
 	{
-		static int numOfLoop{ 100 };
+		constexpr int numOfLoop{ 100 };
 
-		for(int i = 0; i < numOfLoop; ++i)
+		for (int i = 0; i < numOfLoop; ++i)
 		{
-			switch (getState())
+			int tmp{ slot.load(memory_order_acquire) };
+			switch (getState(tmp))
 			{
 			case State::EMPTY:
 			{
-				if (CAS(State::EMPTY, State::WAITING, 0, val))
+				if (!CAS(tmp, State::WAITING, value)) continue;
+				for (int cnt = 0; cnt < numOfLoop; ++cnt)
+					if (State::BUSY == getState(slot.load(memory_order_acquire)))
+					{
+						*partner = take();
+						return true;
+					}
+				// 포기할 때도 CAS로 비운다. 실패했다면 그 사이에 상대가 값을 넣은 것이므로 가져간다.
+				if (CAS(pack(State::WAITING, value), State::EMPTY, 0))
 				{
-					int cnt{};
-					while (getState() != State::BUSY) 
-						if (++cnt > numOfLoop)
-						{
-							*isTimeOut = true;
-							return 0;
-						}
-					slot = 0;
-					return getValue();
+					*isTimeOut = true;
+					return false;
 				}
-				else continue;
+				*partner = take();
+				return true;
 			}
-			break;
 			case State::WAITING:
 			{
-				int oldValue{ getValue() };
-				if (CAS(State::WAITING, State::BUSY, oldValue, val)) return oldValue;
-				else continue;
+				if (!CAS(tmp, State::BUSY, value)) continue;
+				*partner = getValue(tmp);
+				return true;
 			}
-			break;
 			case State::BUSY:
 				*isBusy = true;
 				break;
@@ -85,27 +101,27 @@ public:
 		}
 
 		*isBusy = true;
-		return 0;
+		return false;
 	}
 };
 
 class BackOff 
 {
-	int range{ 1 };
+	atomic<int> range{ 1 };		// 여러 스레드가 고치므로 atomic. 대략적인 값이면 충분하므로 relaxed
 	Exchanger exchanger[MAX_THREADS];
 public:
 	BackOff() = default;
 	~BackOff() = default;
 
-	int visit(int value, bool* isTimeOut) 
+	bool visit(int value, int* partner) 
 	{
-		int slot{ rand() % range };
-		bool isBusy{}; 
-		int ret{ exchanger[slot].exchange(value, isTimeOut, &isBusy) };
+		int oldRange{ range.load(memory_order_relaxed) };
+		bool isTimeOut{}, isBusy{};
+		bool result{ exchanger[rand() % oldRange].exchange(value, partner, &isTimeOut, &isBusy) };
 
-		if (*isTimeOut && range > 1) --range;
-		if (isBusy && range <= NUM_THREADS / 2) ++range;
-		return ret;
+		if (isTimeOut && oldRange > 1) range.compare_exchange_strong(oldRange, oldRange - 1, memory_order_relaxed);
+		if (isBusy && oldRange <= NUM_THREADS / 2) range.compare_exchange_strong(oldRange, oldRange + 1, memory_order_relaxed);
+		return result;
 	}
 };
 
@@ -113,72 +129,107 @@ class Node
 {
 public:
 	int key{};
-	Node* volatile next{};
+	Node* next{};
 	Node() = default;
 	Node(int newKey) { key = newKey; }
 	~Node() = default;
 };
 
+Magazine<Node, MAX_THREADS> magazine{};
+NodeStats<MAX_THREADS> stats{};
+
+// 해저드 포인터가 해제할 노드를 delete하는 대신 매거진에 반환
+struct NodeDeleter
+{
+	void operator()(Node* node) const
+	{
+		magazine.free(THREAD_ID, node);
+		stats.onFree(THREAD_ID);
+	}
+};
+
 class Stack
 {
 private:
 	BackOff bo{};
-	Node* volatile top{};
+	atomic<Node*> top{};
+	HazardPointer<Node, MAX_THREADS, 1, NodeDeleter> hp{ SCAN_THRESHOLD };
 public:
 	Stack() = default;
 	~Stack() { init(); }
 
 	void init()
 	{
-		Node* ptr{};
-		while (top)
+		Node* ptr{ top.load(memory_order_relaxed) };
+		while (ptr)
 		{
-			ptr = top;
-			top = ptr->next;
-			delete ptr;
+			Node* next{ ptr->next };
+			magazine.free(THREAD_ID, ptr);
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
+			ptr = next;
 		}
+		top.store(nullptr, memory_order_relaxed);
+		hp.clear();
 	}
+	Node* newNode(int key)
+	{
+		Node* node{ magazine.alloc(THREAD_ID) };
+		stats.onAlloc(THREAD_ID);
+		node->key = key;
+		node->next = nullptr;
+		return node;
+	}
+	void setReclaim(bool reclaim) { hp.setEnabled(reclaim); }
 
-	bool CAS(Node* volatile& addr, const Node* oldNode, const Node* newNode)
+	bool CAS(atomic<Node*>& addr, Node* oldNode, Node* newNode)
 	{
-		long long oldvalue{ reinterpret_cast<long long>(oldNode) };
-		long long newvalue{ reinterpret_cast<long long>(newNode) };
-		return atomic_compare_exchange_strong((atomic<long long> volatile*)(&addr), &oldvalue, newvalue);
+		return addr.compare_exchange_strong(oldNode, newNode, memory_order_release, memory_order_relaxed);
 	}
 
 	void push(int key)
 	{
-		Node* newNode{ new Node{key} };
+		Node* node{ newNode(key) };
 
 		while (true)
 		{
-			Node* cur{ top };
-			newNode->next = cur;
-			if (CAS(top, cur, newNode)) return;
+			Node* cur{ top.load(memory_order_relaxed) };
+			node->next = cur;
+			if (CAS(top, cur, node)) return;
 
-			bool isTimeOut{};
-			int ret{ bo.visit(key, &isTimeOut) };
-			if (!isTimeOut && ret) return;
+			int partner{};
+			if (bo.visit(key, &partner) && POP == partner)
+			{
+				magazine.free(THREAD_ID, node);		// 교환에 성공하면 노드는 스택에 들어가지 않는다.
+				stats.onRemove(THREAD_ID);
+				stats.onFree(THREAD_ID);
+				return;
+			}
 		}
 	}
 	int pop()
 	{
 		while (true)
 		{
-			Node* cur{ top };
+			Node* cur{ hp.protect(THREAD_ID, 0, top) };
 			if (!cur) return -1;
 
 			int val{ cur->key };
-			if (CAS(top, cur, cur->next)) { /*delete cur;*/ return val; }
+			if (CAS(top, cur, cur->next))
+			{
+				hp.release(THREAD_ID);
+				stats.onRemove(THREAD_ID);
+				hp.retire(THREAD_ID, cur);
+				return val;
+			}
 
-			bool isTimeOut{};
-			int ret{ bo.visit(0, &isTimeOut) };
-			if (!isTimeOut && ret) return ret;
+			int partner{};
+			if (bo.visit(POP, &partner) && POP != partner) { hp.release(THREAD_ID); return partner; }
 		}
 	}
 	void printElement(int count)
 	{
-		Node* cur{ top };
+		Node* cur{ top.load() };
 		for (int i = 0; i < count; ++i)
 		{
 			if (!cur) break;
@@ -191,9 +242,10 @@ public:
 
 Stack stk;
 
-void ThreadFunc(int numOfThread)
+void ThreadFunc(int numOfThread, int threadID)
 {
 	NUM_THREADS = numOfThread;
+	THREAD_ID = threadID;
 
 	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
 	{
@@ -209,20 +261,44 @@ void ThreadFunc(int numOfThread)
 int main()
 {
 	vector<thread> threads{};
+	RssSampler sampler{};
+
+	stressQueue(MAX_THREADS, STRESS_OPS, false,
+		[](int threadID, int value) { NUM_THREADS = MAX_THREADS; THREAD_ID = threadID; stk.push(value); },
+		[](int threadID) { NUM_THREADS = MAX_THREADS; THREAD_ID = threadID; return stk.pop(); });
 
-	for (int i = 1; i <= MAX_THREADS; i *= 2)
+	// 해저드 포인터로 노드를 해제하는 버전과 해제하지 않는 메모리 릭 버전을 비교
+	for (bool reclaim : { true, false })
 	{
-		threads.clear();
-		stk.init();
+		stk.setReclaim(reclaim);
+		cout << (reclaim ? "[Hazard Pointer]\n" : "[Leak]\n");
 
-		auto start{ high_resolution_clock::now() };
+		for (int i = 1; i <= MAX_THREADS; i *= 2)
+		{
+			threads.clear();
+			stk.init();
+			magazine.resetCount();
 
-		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i);
-		for (auto& thread : threads) thread.join();
+			size_t startMemory{ getResidentMemory() };
+			sampler.start();
+			auto start{ high_resolution_clock::now() };
 
-		stk.printElement(20);
+			for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
+			for (auto& thread : threads) thread.join();
+			sampler.stop();
 
-		auto duration{ high_resolution_clock::now() - start };
-		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds\n";
+			stk.printElement(20);
+
+			auto duration{ high_resolution_clock::now() - start };
+			double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+			size_t endMemory{ getResidentMemory() };
+			cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+			cout << duration_cast<nanoseconds>(duration).count() / NUM_TEST << " ns/op, ";
+			cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB), ";
+			cout << "Allocator Calls = " << magazine.getAllocatorCalls() << " (new/delete = " << magazine.getRequests() << ")\n";
+			stats.print();
+			cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+			cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+		}
 	}
 }
\ No newline at end of file
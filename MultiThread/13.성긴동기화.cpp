@@ -1,19 +1,24 @@
 #include <iostream>
+#include <thread>
 #include <mutex>
 #include <chrono>
 #include <vector>
+#include "memory_usage.h"
+#include "node_stats.h"
 
 using namespace std;
 using namespace std::chrono;
 
 /*
-	䵿ȭ
+	성긴동기화
 
-	1. Ʈ ü mtx ü  ִ.
-	2. Ʈ ü ŷѴ.
+	1. 리스트 객체가 mtx 객체를 가지고 있다.
+	2. 리스트 자체를 락킹한다.
 */
 
 constexpr int MAX_LEVEL{ 8 };
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
 
 class Node
 {
@@ -32,6 +37,8 @@ public:
 	~Node() = default;
 };
 
+NodeStats<MAX_THREADS> stats{};
+
 class SkipList
 {
 private:
@@ -57,6 +64,8 @@ public:
 			Node* target{ node };
 			node = node->next[0];
 			delete target;
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
 		}
 		for (auto& i : head.next) i = &tail;
 	}
@@ -90,6 +99,7 @@ public:
 			while (rand() % 2 == 1) if (++topLevel == MAX_LEVEL) break;
 
 			Node* newNode{ new Node{value, topLevel} };
+			stats.onAlloc(THREAD_ID);
 			for (int i = 0; i <= topLevel; ++i)
 			{
 				pred[i]->next[i] = newNode;
@@ -112,6 +122,8 @@ public:
 		{
 			for (int i = 0; i <= curr[0]->topLevel; ++i) pred[i]->next[i] = curr[0]->next[i];
 			delete curr[0];
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
 
 			mtx.unlock();
 			return true;
@@ -157,14 +169,15 @@ public:
 
 constexpr int NUM_TEST{ 4000000 };
 constexpr int KEY_RANGE{ 1000 };
-constexpr int MAX_THREADS{ 8 };
 
 SkipList lst;
 
-void ThreadFunc(int numOfThread)
+void ThreadFunc(int numOfThread, int threadID)
 {
 	int key{};
 
+	THREAD_ID = threadID;
+
 	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
 	{
 		switch (rand() % 3) {
@@ -189,18 +202,25 @@ void ThreadFunc(int numOfThread)
 int main()
 {
 	vector<thread> threads{};
+	RssSampler sampler{};
 
 	for (int i = 1; i <= MAX_THREADS; i *= 2)
 	{
 		threads.clear();
+		sampler.start();
 		auto start{ high_resolution_clock::now() };
 
-		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i);
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
 		for (auto& thread : threads) thread.join();
+		sampler.stop();
 
 		lst.printElement(20);
 
 		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
 		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds\n";
+		stats.print();
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
 	}
 }
\ No newline at end of file
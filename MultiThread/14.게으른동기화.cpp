@@ -1,22 +1,34 @@
 #include <iostream>
+#include <thread>
 #include <mutex>
+#include <atomic>
 #include <chrono>
 #include <vector>
+#include "ebr.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
 
 using namespace std;
 using namespace std::chrono;
 
 /*
-	ȭ
+	게으른동기화
 
-	1. ȿ ˻翡 Ʈ ȸ ʴ´.
-	2.  帶 Ʈ ŵǾ Ǻϴ ŷ ߰ -> isRemoved
-	3. add, remove  尡   Ǵϴ  ʿϴ. -> isLinkFinished
+	1. 유효성 검사에서 리스트를 순회하지 않는다.
+	2. 각 노드마다 리스트에서 제거되었는지 판별하는 마킹변수를 추가 -> isRemoved
+	3. add, remove시 모든 노드가 연결이 끝났는지 판단하는 변수가 필요하다. -> isLinkFinished
 
-	 ŷ ŵۺ  ǾѴ.
+	4. 리스트에서 떼어낸 노드는 EBR로 모든 스레드가 참조하지 않게 된 뒤에 delete한다.
+	5. next와 두 변수는 atomic으로 선언한다. 락 없는 순회는 acquire로 읽고, 연결과 isLinkFinished는 release로 쓴다.
+	   -> 락을 잡은 뒤의 유효성 검사는 lock이 acquire이므로 relaxed로 충분하다.
+
+	※ 마킹은 제거동작보다 먼저 실행되야한다. -> 떼어내는 store가 release이므로 마킹은 relaxed로 충분하다.
 */
 
 constexpr int MAX_LEVEL{ 8 };
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
 
 class Node
 {
@@ -25,8 +37,8 @@ private:
 public:
 	int key{};
 	int topLevel{ MAX_LEVEL };
-	Node* volatile next[MAX_LEVEL + 1]{};
-	volatile bool isRemoved{}, isLinkFinished{};
+	atomic<Node*> next[MAX_LEVEL + 1]{};
+	atomic<bool> isRemoved{}, isLinkFinished{};
 public:
 	Node() = default;
 	Node(int value, int top)
@@ -40,17 +52,31 @@ public:
 	void unlock() { mtx.unlock(); }
 };
 
+NodeStats<MAX_THREADS> stats{};
+
+// EBR이 노드를 delete할 때 해제 수를 센다.
+struct NodeDeleter
+{
+	void operator()(Node* node) const
+	{
+		delete node;
+		stats.onFree(THREAD_ID);
+	}
+};
+
 class SkipList
 {
 private:
 	Node head{}, tail{};
+	EBR<Node, MAX_THREADS, NodeDeleter> ebr{};
 public:
 	SkipList()
 	{
 		head.key = 0x80000000;
 		tail.key = 0x7FFFFFFF;
-		for (auto& i : head.next) i = &tail;
-		head.isLinkFinished = tail.isLinkFinished = true;
+		for (auto& i : head.next) i.store(&tail, memory_order_relaxed);
+		head.isLinkFinished.store(true, memory_order_relaxed);
+		tail.isLinkFinished.store(true, memory_order_relaxed);
 	};
 	~SkipList()
 	{
@@ -59,15 +85,19 @@ public:
 
 	void clear()
 	{
-		Node* node{ head.next[0] };
+		Node* node{ head.next[0].load(memory_order_relaxed) };
 		while (&tail != node)
 		{
 			Node* target{ node };
-			node = node->next[0];
+			node = node->next[0].load(memory_order_relaxed);
 			delete target;
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
 		}
-		for (auto& i : head.next) i = &tail;
+		for (auto& i : head.next) i.store(&tail, memory_order_relaxed);
+		ebr.clear();
 	}
+	void setReclaim(bool reclaim) { ebr.setEnabled(reclaim); }
 
 	int find(int value, Node* pred[], Node* curr[])
 	{
@@ -77,12 +107,12 @@ public:
 		for (int curLevel = MAX_LEVEL; curLevel >= 0; --curLevel)
 		{
 			if (curLevel != MAX_LEVEL) pred[curLevel] = pred[curLevel + 1];
-			curr[curLevel] = pred[curLevel]->next[curLevel];
+			curr[curLevel] = pred[curLevel]->next[curLevel].load(memory_order_acquire);
 
 			while (curr[curLevel]->key < value)
 			{
 				pred[curLevel] = curr[curLevel];
-				curr[curLevel] = curr[curLevel]->next[curLevel];
+				curr[curLevel] = curr[curLevel]->next[curLevel].load(memory_order_acquire);
 			}
 
 			if (foundLevel == -1 && curr[curLevel]->key == value) foundLevel = curLevel;
@@ -95,13 +125,15 @@ public:
 		Node* pred[MAX_LEVEL + 1]{};
 		Node* curr[MAX_LEVEL + 1]{};
 
+		ebr.start(THREAD_ID);
 		while (true)
 		{
 			int foundLevel{ find(value, pred, curr) };
 			if (foundLevel != -1)
 			{
-				if (curr[0]->isRemoved) continue;
-				while (!curr[0]->isLinkFinished);
+				if (curr[0]->isRemoved.load(memory_order_relaxed)) continue;
+				while (!curr[0]->isLinkFinished.load(memory_order_acquire));
+				ebr.end(THREAD_ID);
 				return false;
 			}
 
@@ -110,8 +142,8 @@ public:
 			for (curLevel = 0; curLevel <= MAX_LEVEL; ++curLevel)
 			{
 				pred[curLevel]->lock();
-				isValid = !pred[0]->isRemoved && !curr[0]->isRemoved &&
-					curr[curLevel] == pred[curLevel]->next[curLevel];
+				isValid = !pred[curLevel]->isRemoved.load(memory_order_relaxed) && !curr[curLevel]->isRemoved.load(memory_order_relaxed) &&
+					curr[curLevel] == pred[curLevel]->next[curLevel].load(memory_order_relaxed);
 				if (!isValid) break;
 			}
 
@@ -126,11 +158,13 @@ public:
 				while (rand() % 2 == 1) if (++topLevel == MAX_LEVEL) break;
 
 				Node* newNode{ new Node{value, topLevel} };
-				for (int i = 0; i <= topLevel; ++i) newNode->next[i] = curr[i];
-				for (int i = 0; i <= topLevel; ++i) pred[i]->next[i] = newNode;
+				stats.onAlloc(THREAD_ID);
+				for (int i = 0; i <= topLevel; ++i) newNode->next[i].store(curr[i], memory_order_relaxed);
+				for (int i = 0; i <= topLevel; ++i) pred[i]->next[i].store(newNode, memory_order_release);
 
-				newNode->isLinkFinished = true;
+				newNode->isLinkFinished.store(true, memory_order_release);
 				for (int i = 0; i <= MAX_LEVEL; ++i) pred[i]->unlock();
+				ebr.end(THREAD_ID);
 				return true;
 			}
 		}
@@ -140,14 +174,20 @@ public:
 		Node* pred[MAX_LEVEL + 1]{};
 		Node* curr[MAX_LEVEL + 1]{};
 
+		ebr.start(THREAD_ID);
 		int foundLevel{ find(value, pred, curr) };
+		if (foundLevel == -1) { ebr.end(THREAD_ID); return false; }
+
 		Node* target{ curr[foundLevel] };
-		if (foundLevel == -1 || target->isRemoved || !target->isLinkFinished || target->topLevel != foundLevel)
+		if (target->isRemoved.load(memory_order_relaxed) || !target->isLinkFinished.load(memory_order_acquire) || target->topLevel != foundLevel)
+		{
+			ebr.end(THREAD_ID);
 			return false;
+		}
 
 		target->lock();
-		if (target->isRemoved) { target->unlock(); return false; }
-		target->isRemoved = true;
+		if (target->isRemoved.load(memory_order_relaxed)) { target->unlock(); ebr.end(THREAD_ID); return false; }
+		target->isRemoved.store(true, memory_order_relaxed);
 
 		while (true)
 		{
@@ -156,7 +196,7 @@ public:
 			for (curLevel = 0; curLevel <= MAX_LEVEL; ++curLevel)
 			{
 				pred[curLevel]->lock();
-				isValid = !pred[0]->isRemoved && curr[curLevel] == pred[curLevel]->next[curLevel];
+				isValid = !pred[curLevel]->isRemoved.load(memory_order_relaxed) && curr[curLevel] == pred[curLevel]->next[curLevel].load(memory_order_relaxed);
 				if (!isValid) break;
 			}
 
@@ -167,11 +207,13 @@ public:
 				continue;
 			}
 
-			for (int i = curr[0]->topLevel; i >= 0; --i) pred[i]->next[i] = curr[0]->next[i];
-			//delete curr[0];
+			for (int i = curr[0]->topLevel; i >= 0; --i) pred[i]->next[i].store(curr[0]->next[i].load(memory_order_relaxed), memory_order_release);
 
 			for (int i = 0; i <= MAX_LEVEL; ++i) pred[i]->unlock();
 			target->unlock();
+			stats.onRemove(THREAD_ID);
+			ebr.retire(THREAD_ID, target);
+			ebr.end(THREAD_ID);
 			return true;
 		}
 	}
@@ -180,19 +222,21 @@ public:
 		Node* pred[MAX_LEVEL + 1]{};
 		Node* curr[MAX_LEVEL + 1]{};
 
+		ebr.start(THREAD_ID);
 		int foundLevel{ find(value, pred, curr) };
-
-		return foundLevel != -1 && curr[foundLevel]->isLinkFinished && !curr[foundLevel]->isRemoved;
+		bool result{ foundLevel != -1 && curr[foundLevel]->isLinkFinished.load(memory_order_acquire) && !curr[foundLevel]->isRemoved.load(memory_order_relaxed) };
+		ebr.end(THREAD_ID);
+		return result;
 	}
 	void printElement(int count)
 	{
-		Node* cur{ head.next[0] };
+		Node* cur{ head.next[0].load() };
 		for (int i = 0; i < count; ++i)
 		{
 			if (&tail == cur)
 				break;
 			cout << cur->key << " ";
-			cur = cur->next[0];
+			cur = cur->next[0].load();
 		}
 		cout << endl;
 	}
@@ -200,14 +244,15 @@ public:
 
 constexpr int NUM_TEST{ 4000000 };
 constexpr int KEY_RANGE{ 1000 };
-constexpr int MAX_THREADS{ 8 };
 
 SkipList lst;
 
-void ThreadFunc(int numOfThread)
+void ThreadFunc(int numOfThread, int threadID)
 {
 	int key{};
 
+	THREAD_ID = threadID;
+
 	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
 	{
 		switch (rand() % 3) {
@@ -232,18 +277,43 @@ void ThreadFunc(int numOfThread)
 int main()
 {
 	vector<thread> threads{};
+	RssSampler sampler{};
 
-	for (int i = 1; i <= MAX_THREADS; i *= 2)
-	{
-		threads.clear();
-		auto start{ high_resolution_clock::now() };
+	stressSet(MAX_THREADS, STRESS_OPS, STRESS_KEY_RANGE,
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.add(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.remove(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.contain(key); });
 
-		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i);
-		for (auto& thread : threads) thread.join();
-
-		lst.printElement(20);
+	// EBR로 노드를 해제하는 버전과 기존의 메모리 릭 버전을 비교
+	for (bool reclaim : { true, false })
+	{
+		lst.setReclaim(reclaim);
+		cout << (reclaim ? "[EBR]\n" : "[Leak]\n");
 
-		auto duration{ high_resolution_clock::now() - start };
-		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds\n";
+		for (int i = 1; i <= MAX_THREADS; i *= 2)
+		{
+			threads.clear();
+			lst.clear();
+
+			size_t startMemory{ getResidentMemory() };
+			sampler.start();
+			auto start{ high_resolution_clock::now() };
+
+			for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
+			for (auto& thread : threads) thread.join();
+			sampler.stop();
+
+			lst.printElement(20);
+
+			auto duration{ high_resolution_clock::now() - start };
+			double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+			size_t endMemory{ getResidentMemory() };
+			cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+			cout << "Throughput = " << static_cast<long long>(NUM_TEST / seconds) << " ops/sec, ";
+			cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB)\n";
+			stats.print();
+			cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+			cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+		}
 	}
 }
\ No newline at end of file
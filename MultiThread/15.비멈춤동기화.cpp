@@ -0,0 +1,393 @@
+#include <chrono> 
+#include <iostream> 
+#include <thread> 
+#include <vector> 
+#include <atomic> 
+#include "ebr.h"
+#include "node_pool.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
+
+using namespace std; 
+using namespace std::chrono; 
+
+/*
+	비멈춤동기화
+
+	1. 모든 레벨의 next를 CPtr(인덱스 + 버전 + 마킹)로 관리해 연결과 마킹을 CAS 한번으로 한다. -> 락이 없다.
+	2. add는 0레벨에 연결되는 순간 추가된 것으로 본다. 위 레벨은 그 뒤에 아래에서부터 하나씩 연결한다.
+	3. remove는 위 레벨부터 마킹하고, 0레벨의 마킹에 성공한 스레드만 제거에 성공한다.
+	4. find는 지나가면서 마킹된 노드를 떼어낸다. contain은 떼어내지 않고 건너뛰기만 한다. -> contain은 대기가 없다.
+	5. 노드는 NodePool에서 할당하고, 떼어낸 노드는 EBR로 모든 스레드가 참조하지 않게 된 뒤에 풀에 반환한다.
+
+	※ 위 레벨을 연결하는 도중에 제거될 수 있다. -> 한 레벨에서 떼어냈다고 리스트에서 빠진 것이 아니다.
+	   -> add와 remove 중 나중에 끝나는 쪽이 find로 모든 레벨에서 떼어낸 뒤 retire한다. (owners)
+	※ 게으른동기화와 달리 isLinkFinished를 기다리거나 여러 pred를 락킹하지 않는다.
+*/
+
+constexpr int MAX_LEVEL{ 8 };
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+// | index(32) | version(31) | removed(1) |
+class CPtr
+{
+private:
+	atomic<long long> value{};
+private:
+	static long long pack(uint32_t index, unsigned version, bool removed)
+	{
+		return static_cast<long long>((static_cast<unsigned long long>(index) << 32) | ((version & 0x7FFFFFFF) << 1) | (removed ? 0x01 : 0x00));
+	}
+public:
+	// 버전은 이전 값에서 하나 증가시킨다. 아직 공개되지 않은 노드나 혼자 쓰는 리스트에만 사용
+	void set(uint32_t index, bool removed)
+	{
+		value.store(pack(index, getVersion() + 1, removed), memory_order_relaxed);
+	}
+	uint32_t getIndex()
+	{
+		return static_cast<uint32_t>(static_cast<unsigned long long>(value.load(memory_order_acquire)) >> 32);
+	}
+	uint32_t getIndex(bool* removed)
+	{
+		long long val{ value.load(memory_order_acquire) };
+		*removed = val & 0x01;
+		return static_cast<uint32_t>(static_cast<unsigned long long>(val) >> 32);
+	}
+	uint32_t getIndex(bool* removed, unsigned* version)
+	{
+		long long val{ value.load(memory_order_acquire) };
+		*removed = val & 0x01;
+		*version = static_cast<unsigned>(val >> 1) & 0x7FFFFFFF;
+		return static_cast<uint32_t>(static_cast<unsigned long long>(val) >> 32);
+	}
+	unsigned getVersion()
+	{
+		return static_cast<unsigned>(value.load(memory_order_relaxed) >> 1) & 0x7FFFFFFF;
+	}
+	// version은 oldIndex를 읽었을 때의 버전. 성공하면 버전이 하나 증가한다.
+	bool CAS(uint32_t oldIndex, uint32_t newIndex, bool oldRemoved, bool newRemoved, unsigned version)
+	{
+		long long oldVal{ pack(oldIndex, version, oldRemoved) };
+		long long newVal{ pack(newIndex, version + 1, newRemoved) };
+
+		return value.compare_exchange_strong(oldVal, newVal, memory_order_acq_rel, memory_order_relaxed);
+	}
+};
+
+class Node
+{
+public:
+	int key{};
+	int topLevel{ MAX_LEVEL };
+	uint32_t index{};			// 풀에서 자신의 인덱스
+	atomic<int> owners{};		// 아직 노드를 다루고 있는 add, remove의 수. 0으로 만든 쪽이 retire한다.
+	CPtr next[MAX_LEVEL + 1]{};
+public:
+	Node() = default;
+	~Node() = default;
+};
+
+NodePool<Node, MAX_THREADS> pool{};
+NodeStats<MAX_THREADS> stats{};
+
+// EBR이 해제할 노드를 delete하는 대신 풀에 반환
+struct NodeDeleter
+{
+	void operator()(Node* node) const
+	{
+		pool.free(THREAD_ID, node->index);
+		stats.onFree(THREAD_ID);
+	}
+};
+
+class SkipList
+{
+private:
+	Node* head{}, * tail{};
+	EBR<Node, MAX_THREADS, NodeDeleter> ebr{};
+public:
+	SkipList()
+	{
+		head = newNode(0x80000000, MAX_LEVEL);
+		tail = newNode(0x7FFFFFFF, MAX_LEVEL);
+		for (auto& i : head->next) i.set(tail->index, false);
+	}
+	~SkipList() = default;
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void clear()
+	{
+		uint32_t index{ head->next[0].getIndex() };
+		while (index != tail->index)
+		{
+			Node* target{ pool.get(index) };
+			index = target->next[0].getIndex();
+			pool.free(THREAD_ID, target->index);
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
+		}
+		for (auto& i : head->next) i.set(tail->index, false);
+		ebr.clear();
+	}
+	void setReclaim(bool reclaim) { ebr.setEnabled(reclaim); }
+	Node* newNode(int key, int topLevel)
+	{
+		uint32_t index{ pool.alloc(THREAD_ID) };
+		Node* node{ pool.get(index) };
+		node->key = key;
+		node->topLevel = topLevel;
+		node->index = index;
+		node->owners.store(2, memory_order_relaxed);
+		return node;
+	}
+
+	// versions에는 preds[i]->next[i]에서 succs[i]를 읽었을 때의 버전을 돌려준다.
+	bool find(int key, Node* preds[], Node* succs[], unsigned versions[])
+	{
+		bool isRemoved{};
+
+	RETRY:
+		Node* pred{ head };
+		for (int level = MAX_LEVEL; level >= 0; --level)
+		{
+			unsigned predVersion{};
+			Node* curr{ pool.get(pred->next[level].getIndex(&isRemoved, &predVersion)) };
+
+			while (true)
+			{
+				Node* succ{ pool.get(curr->next[level].getIndex(&isRemoved)) };
+
+				// 이 레벨에서만 떼어낸다. retire는 owners를 0으로 만든 쪽이 한다.
+				while (isRemoved)
+				{
+					if (!pred->next[level].CAS(curr->index, succ->index, false, false, predVersion)) goto RETRY;
+					++predVersion;
+					curr = succ;
+					succ = pool.get(curr->next[level].getIndex(&isRemoved));
+				}
+
+				if (curr->key >= key) break;
+				pred = curr;
+				curr = pool.get(curr->next[level].getIndex(&isRemoved, &predVersion));
+			}
+
+			preds[level] = pred;
+			succs[level] = curr;
+			versions[level] = predVersion;
+		}
+		return succs[0]->key == key;
+	}
+	bool add(int key)
+	{
+		Node* preds[MAX_LEVEL + 1]{};
+		Node* succs[MAX_LEVEL + 1]{};
+		unsigned versions[MAX_LEVEL + 1]{};
+		Node* node{};
+
+		int topLevel{};
+		while (rand() % 2 == 1) if (++topLevel == MAX_LEVEL) break;
+
+		ebr.start(THREAD_ID);
+		while (true)
+		{
+			if (find(key, preds, succs, versions))
+			{
+				ebr.end(THREAD_ID);
+				if (node) pool.free(THREAD_ID, node->index);
+				return false;
+			}
+
+			if (!node) node = newNode(key, topLevel);
+			for (int level = 0; level <= topLevel; ++level) node->next[level].set(succs[level]->index, false);
+			if (preds[0]->next[0].CAS(succs[0]->index, node->index, false, false, versions[0])) break;
+		}
+		stats.onAlloc(THREAD_ID);		// 리스트에 들어간 노드만 센다.
+
+		for (int level = 1; level <= topLevel; ++level)
+		{
+			while (true)
+			{
+				bool isRemoved{};
+				unsigned version{};
+				uint32_t succ{ node->next[level].getIndex(&isRemoved, &version) };
+				if (isRemoved) break;		// 이미 제거중이면 더 연결하지 않는다.
+
+				// find를 다시 했다면 succs가 바뀌었을 수 있다.
+				if (succ != succs[level]->index && !node->next[level].CAS(succ, succs[level]->index, false, false, version)) continue;
+				if (preds[level]->next[level].CAS(succs[level]->index, node->index, false, false, versions[level])) break;
+				find(key, preds, succs, versions);
+			}
+		}
+
+		release(node, preds, succs, versions);
+		ebr.end(THREAD_ID);
+		return true;
+	}
+	bool remove(int key)
+	{
+		Node* preds[MAX_LEVEL + 1]{};
+		Node* succs[MAX_LEVEL + 1]{};
+		unsigned versions[MAX_LEVEL + 1]{};
+
+		ebr.start(THREAD_ID);
+		if (!find(key, preds, succs, versions))
+		{
+			ebr.end(THREAD_ID);
+			return false;
+		}
+
+		Node* target{ succs[0] };
+		for (int level = target->topLevel; level >= 0; --level)
+		{
+			while (true)
+			{
+				bool isRemoved{};
+				unsigned version{};
+				uint32_t succ{ target->next[level].getIndex(&isRemoved, &version) };
+
+				if (isRemoved)
+				{
+					if (level > 0) break;
+					ebr.end(THREAD_ID);		// 0레벨은 다른 스레드가 먼저 마킹했다.
+					return false;
+				}
+				if (target->next[level].CAS(succ, succ, false, true, version)) break;
+			}
+		}
+
+		stats.onRemove(THREAD_ID);
+		release(target, preds, succs, versions);
+		ebr.end(THREAD_ID);
+		return true;
+	}
+	bool contain(int key)
+	{
+		bool isRemoved{};
+
+		ebr.start(THREAD_ID);
+		Node* pred{ head };
+		Node* curr{};
+		for (int level = MAX_LEVEL; level >= 0; --level)
+		{
+			curr = pool.get(pred->next[level].getIndex());
+			while (true)
+			{
+				Node* succ{ pool.get(curr->next[level].getIndex(&isRemoved)) };
+				while (isRemoved)
+				{
+					curr = succ;
+					succ = pool.get(curr->next[level].getIndex(&isRemoved));
+				}
+
+				if (curr->key >= key) break;
+				pred = curr;
+				curr = succ;
+			}
+		}
+		bool result{ curr->key == key };
+		ebr.end(THREAD_ID);
+		return result;
+	}
+	void printElement(int count)
+	{
+		Node* node{ pool.get(head->next[0].getIndex()) };
+		while (node != tail)
+		{
+			cout << node->key << ", ";
+			node = pool.get(node->next[0].getIndex());
+			--count;
+			if (!count) break;
+		}
+		cout << "\n";
+	}
+private:
+	// add가 연결을 끝냈거나 remove가 마킹을 끝냈을 때 호출한다.
+	// 나중에 호출한 쪽은 상대가 한 연결과 마킹을 모두 본다. -> 모든 레벨에서 떼어낸 뒤 retire
+	void release(Node* node, Node* preds[], Node* succs[], unsigned versions[])
+	{
+		if (node->owners.fetch_sub(1, memory_order_acq_rel) != 1) return;
+		find(node->key, preds, succs, versions);
+		ebr.retire(THREAD_ID, node);
+	}
+};
+
+const int NUM_TEST{ 4000000 };
+const int KEY_RANGE{ 1000 };
+
+SkipList lst; 
+
+void ThreadFunc(int numOfThread, int threadID)
+{
+	int key{};
+
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; i++)
+	{
+		switch (rand() % 3)
+		{
+		case 0:
+			key = rand() % KEY_RANGE;
+			lst.add(key);
+			break;
+		case 1:
+			key = rand() % KEY_RANGE;
+			lst.remove(key);
+			break;
+		case 2:
+			key = rand() % KEY_RANGE;
+			lst.contain(key);
+			break;
+		default:
+			cout << "Error\n";
+			exit(-1);
+		}
+	}
+}
+
+int main()
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	stressSet(MAX_THREADS, STRESS_OPS, STRESS_KEY_RANGE,
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.add(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.remove(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.contain(key); });
+
+	// EBR로 노드를 해제하는 버전과 기존의 메모리 릭 버전을 비교
+	for (bool reclaim : { true, false })
+	{
+		lst.setReclaim(reclaim);
+		cout << (reclaim ? "[EBR]\n" : "[Leak]\n");
+
+		for (int i = 1; i <= MAX_THREADS; i *= 2)
+		{
+			threads.clear();
+			lst.clear();
+
+			size_t startMemory{ getResidentMemory() };
+			sampler.start();
+			auto start{ high_resolution_clock::now() };
+
+			for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
+			for (auto& thread : threads) thread.join();
+			sampler.stop();
+
+			lst.printElement(20);
+
+			auto duration{ high_resolution_clock::now() - start };
+			double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+			size_t endMemory{ getResidentMemory() };
+			cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+			cout << "Throughput = " << static_cast<long long>(NUM_TEST / seconds) << " ops/sec, ";
+			cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB)\n";
+			stats.print();
+			cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+			cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+		}
+	}
+}
@@ -0,0 +1,444 @@
+#include <chrono> 
+#include <iostream> 
+#include <thread> 
+#include <vector> 
+#include <atomic> 
+#include "ebr.h"
+#include "node_pool.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
+
+using namespace std; 
+using namespace std::chrono; 
+
+/*
+	비멈춤동기화(split-ordered hash set)
+
+	1. 모든 키를 6번의 비멈춤 리스트 하나에 넣고, 버킷은 리스트 중간을 가리키는 보초노드로 만든다.
+	2. 리스트는 키의 비트를 뒤집은 순서(split order)로 정렬한다.
+	   -> 버킷 수를 두배로 늘려도 노드를 옮길 필요가 없다. 새 버킷의 보초노드를 부모 버킷 뒤에 끼워넣기만 하면 된다.
+	3. 일반 키는 최상위 비트를 켜고 뒤집어 최하위 비트가 1, 보초노드는 버킷 번호를 뒤집어 최하위 비트가 0
+	   -> 같은 값이라도 보초노드가 일반 노드보다 앞에 온다.
+	4. 버킷의 보초노드는 처음 사용될 때 만든다. (부모 버킷 = 최상위 비트를 끈 버킷)
+	5. 버킷 테이블은 세그먼트 단위로 할당한다. -> 늘릴 때 기존 버킷을 복사하지 않는다.
+	6. 평균 버킷 길이가 LOAD_FACTOR를 넘으면 버킷 수(size)를 CAS로 두배로 늘린다.
+
+	※ add, remove, contain은 자기 버킷의 보초노드부터 순회한다. -> 기대 시간 O(1)
+	※ 키는 0 이상 0x7FFFFFFF 미만이어야 한다. (해시는 키 그대로, 0x7FFFFFFF는 tail)
+*/
+
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+constexpr uint32_t SEGMENT_BITS{ 12 };
+constexpr uint32_t SEGMENT_SIZE{ 1u << SEGMENT_BITS };		// 세그먼트 하나의 버킷 수
+constexpr uint32_t MAX_SEGMENTS{ 1024 };
+constexpr uint32_t MAX_BUCKETS{ SEGMENT_SIZE * MAX_SEGMENTS };
+constexpr int LOAD_FACTOR{ 2 };								// 버킷당 평균 노드 수가 이를 넘으면 버킷 수를 늘린다.
+
+uint32_t reverseBits(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+	x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+	x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
+	x = ((x >> 8) & 0x00FF00FF) | ((x & 0x00FF00FF) << 8);
+	return (x >> 16) | (x << 16);
+}
+uint32_t makeRegularKey(int key) { return reverseBits(static_cast<uint32_t>(key) | 0x80000000); }
+uint32_t makeSentinelKey(uint32_t bucket) { return reverseBits(bucket); }
+
+// | index(32) | version(31) | removed(1) |
+class CPtr
+{
+private:
+	atomic<long long> value{};
+private:
+	static long long pack(uint32_t index, unsigned version, bool removed)
+	{
+		return static_cast<long long>((static_cast<unsigned long long>(index) << 32) | ((version & 0x7FFFFFFF) << 1) | (removed ? 0x01 : 0x00));
+	}
+public:
+	// 버전은 이전 값에서 하나 증가시킨다. 아직 공개되지 않은 노드나 혼자 쓰는 리스트에만 사용
+	void set(uint32_t index, bool removed)
+	{
+		value.store(pack(index, getVersion() + 1, removed), memory_order_relaxed);
+	}
+	uint32_t getIndex()
+	{
+		return static_cast<uint32_t>(static_cast<unsigned long long>(value.load(memory_order_acquire)) >> 32);
+	}
+	uint32_t getIndex(bool* removed)
+	{
+		long long val{ value.load(memory_order_acquire) };
+		*removed = val & 0x01;
+		return static_cast<uint32_t>(static_cast<unsigned long long>(val) >> 32);
+	}
+	uint32_t getIndex(bool* removed, unsigned* version)
+	{
+		long long val{ value.load(memory_order_acquire) };
+		*removed = val & 0x01;
+		*version = static_cast<unsigned>(val >> 1) & 0x7FFFFFFF;
+		return static_cast<uint32_t>(static_cast<unsigned long long>(val) >> 32);
+	}
+	unsigned getVersion()
+	{
+		return static_cast<unsigned>(value.load(memory_order_relaxed) >> 1) & 0x7FFFFFFF;
+	}
+	// version은 oldIndex를 읽었을 때의 버전. 성공하면 버전이 하나 증가한다.
+	bool CAS(uint32_t oldIndex, uint32_t newIndex, bool oldRemoved, bool newRemoved, unsigned version)
+	{
+		long long oldVal{ pack(oldIndex, version, oldRemoved) };
+		long long newVal{ pack(newIndex, version + 1, newRemoved) };
+
+		return value.compare_exchange_strong(oldVal, newVal, memory_order_acq_rel, memory_order_relaxed);
+	}
+};
+
+class Node
+{
+public:
+	int key{};
+	uint32_t soKey{};		// split order 키
+	uint32_t index{};		// 풀에서 자신의 인덱스
+	CPtr next{};
+public:
+	Node() = default;
+	~Node() = default;
+};
+
+NodePool<Node, MAX_THREADS> pool{};
+NodeStats<MAX_THREADS> stats{};
+
+// EBR이 해제할 노드를 delete하는 대신 풀에 반환
+struct NodeDeleter
+{
+	void operator()(Node* node) const
+	{
+		pool.free(THREAD_ID, node->index);
+		stats.onFree(THREAD_ID);
+	}
+};
+
+// 버킷 번호 -> 보초노드의 인덱스. 세그먼트는 처음 쓰일 때 CAS로 붙인다.
+class BucketTable
+{
+private:
+	atomic<atomic<uint32_t>*> segments[MAX_SEGMENTS]{};
+public:
+	BucketTable() = default;
+	~BucketTable() { for (auto& segment : segments) delete[] segment.load(); }
+
+	uint32_t get(uint32_t bucket)
+	{
+		atomic<uint32_t>* segment{ segments[bucket >> SEGMENT_BITS].load(memory_order_acquire) };
+		return segment ? segment[bucket & (SEGMENT_SIZE - 1)].load(memory_order_acquire) : NIL;
+	}
+	void set(uint32_t bucket, uint32_t index)
+	{
+		atomic<atomic<uint32_t>*>& slot{ segments[bucket >> SEGMENT_BITS] };
+		atomic<uint32_t>* segment{ slot.load(memory_order_acquire) };
+		if (!segment)
+		{
+			atomic<uint32_t>* fresh{ new atomic<uint32_t>[SEGMENT_SIZE]{} };
+			if (slot.compare_exchange_strong(segment, fresh, memory_order_acq_rel, memory_order_acquire)) segment = fresh;
+			else delete[] fresh;
+		}
+		segment[bucket & (SEGMENT_SIZE - 1)].store(index, memory_order_release);
+	}
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void clear()
+	{
+		for (auto& segment : segments)
+		{
+			delete[] segment.load(memory_order_relaxed);
+			segment.store(nullptr, memory_order_relaxed);
+		}
+	}
+};
+
+class HashSet
+{
+	Node* head{}, * tail{};
+	BucketTable buckets{};
+	atomic<uint32_t> size{ 2 };		// 버킷 수, 항상 2의 거듭제곱
+	atomic<int> count{};			// 들어있는 키의 수
+	EBR<Node, MAX_THREADS, NodeDeleter> ebr{};
+public:
+	HashSet()
+	{
+		head = newNode(0, makeSentinelKey(0));
+		tail = newNode(0x7FFFFFFF, 0xFFFFFFFF);
+		head->next.set(tail->index, false);
+		buckets.set(0, head->index);
+	}
+	~HashSet() = default;
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void clear()
+	{
+		Node* ptr{};
+		while (head->next.getIndex() != tail->index)
+		{
+			ptr = pool.get(head->next.getIndex());
+			head->next.set(ptr->next.getIndex(), false);
+			pool.free(THREAD_ID, ptr->index);
+			if (!(ptr->soKey & 0x01)) continue;		// 보초노드는 세지 않는다.
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
+		}
+		ebr.clear();
+		buckets.clear();
+		buckets.set(0, head->index);
+		size.store(2, memory_order_relaxed);
+		count.store(0, memory_order_relaxed);
+	}
+	void setReclaim(bool reclaim) { ebr.setEnabled(reclaim); }
+	Node* newNode(int key, uint32_t soKey)
+	{
+		uint32_t index{ pool.alloc(THREAD_ID) };
+		Node* node{ pool.get(index) };
+		node->key = key;
+		node->soKey = soKey;
+		node->index = index;
+		return node;
+	}
+	// 6번 리스트의 find와 같다. 단, head 대신 start(보초노드)부터 순회한다.
+	void find(Node* start, uint32_t soKey, Node*& pred, Node*& curr, unsigned& version)
+	{
+		Node* predNode{}, * currNode{};
+		unsigned predVersion{};
+		bool isRemoved{};
+
+	RETRY:
+		predNode = start;
+		currNode = pool.get(predNode->next.getIndex(&isRemoved, &predVersion));
+
+		while (true)
+		{
+			Node* succ{ pool.get(currNode->next.getIndex(&isRemoved)) };
+
+			while (isRemoved)
+			{
+				if (!predNode->next.CAS(currNode->index, succ->index, false, false, predVersion)) goto RETRY;
+				ebr.retire(THREAD_ID, currNode);
+				++predVersion;
+				currNode = succ;
+				succ = pool.get(currNode->next.getIndex(&isRemoved));
+			}
+
+			if (currNode->soKey >= soKey)
+			{
+				pred = predNode;
+				curr = currNode;
+				version = predVersion;
+				return;
+			}
+
+			predNode = currNode;
+			currNode = pool.get(currNode->next.getIndex(&isRemoved, &predVersion));
+		}
+	}
+	bool add(int key)
+	{
+		uint32_t soKey{ makeRegularKey(key) };
+		Node* pred{}, * curr{};
+		Node* node{};
+		unsigned version{};
+
+		ebr.start(THREAD_ID);
+		Node* start{ getBucket(key) };
+		while (true)
+		{
+			find(start, soKey, pred, curr, version);
+
+			if (soKey == curr->soKey)
+			{
+				ebr.end(THREAD_ID);
+				if (node) pool.free(THREAD_ID, node->index);
+				return false;
+			}
+
+			if (!node) node = newNode(key, soKey);
+			node->next.set(curr->index, false);
+			if (pred->next.CAS(curr->index, node->index, false, false, version)) break;
+		}
+		stats.onAlloc(THREAD_ID);
+		ebr.end(THREAD_ID);
+
+		uint32_t oldSize{ size.load(memory_order_relaxed) };
+		if (count.fetch_add(1, memory_order_relaxed) + 1 > LOAD_FACTOR * static_cast<long long>(oldSize) && oldSize < MAX_BUCKETS)
+			size.compare_exchange_strong(oldSize, oldSize * 2, memory_order_relaxed);
+		return true;
+	}
+	bool remove(int key)
+	{
+		uint32_t soKey{ makeRegularKey(key) };
+		Node* pred{}, * curr{};
+		unsigned version{};
+
+		ebr.start(THREAD_ID);
+		Node* start{ getBucket(key) };
+		while (true)
+		{
+			find(start, soKey, pred, curr, version);
+
+			if (soKey != curr->soKey)
+			{
+				ebr.end(THREAD_ID);
+				return false;
+			}
+
+			bool isRemoved{};
+			unsigned succVersion{};
+			uint32_t succ{ curr->next.getIndex(&isRemoved, &succVersion) };
+
+			// 마킹에 성공한 스레드만 제거에 성공한다. 떼어내지 못하면 이후의 find가 떼어내고 retire한다.
+			if (!curr->next.CAS(succ, succ, false, true, succVersion)) continue;
+			stats.onRemove(THREAD_ID);
+			count.fetch_sub(1, memory_order_relaxed);
+			if (pred->next.CAS(curr->index, succ, false, false, version)) ebr.retire(THREAD_ID, curr);
+			ebr.end(THREAD_ID);
+			return true;
+		}
+	}
+	bool contain(int key)
+	{
+		uint32_t soKey{ makeRegularKey(key) };
+		bool removed{};
+
+		ebr.start(THREAD_ID);
+		Node* curr{ getBucket(key) };
+		while (curr->soKey < soKey) curr = pool.get(curr->next.getIndex());
+		curr->next.getIndex(&removed);
+		bool result{ curr->soKey == soKey && !removed };
+		ebr.end(THREAD_ID);
+		return result;
+	}
+	void printElement(int count)
+	{
+		Node* node{ pool.get(head->next.getIndex()) };
+		while (node != tail)
+		{
+			if (node->soKey & 0x01)
+			{
+				cout << node->key << ", ";
+				if (!(--count)) break;
+			}
+			node = pool.get(node->next.getIndex());
+		}
+		cout << "\n";
+	}
+	uint32_t getBucketCount() { return size.load(memory_order_relaxed); }
+private:
+	// key가 속한 버킷의 보초노드. 처음 쓰이는 버킷이면 만든다.
+	Node* getBucket(int key)
+	{
+		uint32_t bucket{ static_cast<uint32_t>(key) & (size.load(memory_order_relaxed) - 1) };
+		uint32_t index{ buckets.get(bucket) };
+		return (NIL == index) ? initializeBucket(bucket) : pool.get(index);
+	}
+	Node* initializeBucket(uint32_t bucket)
+	{
+		uint32_t parentBucket{ getParent(bucket) };
+		uint32_t parentIndex{ buckets.get(parentBucket) };
+		Node* parent{ (NIL == parentIndex) ? initializeBucket(parentBucket) : pool.get(parentIndex) };
+
+		Node* sentinel{ newNode(static_cast<int>(bucket), makeSentinelKey(bucket)) };
+		Node* pred{}, * curr{};
+		unsigned version{};
+		while (true)
+		{
+			find(parent, sentinel->soKey, pred, curr, version);
+
+			// 다른 스레드가 먼저 만들었다면 그 보초노드를 쓴다.
+			if (sentinel->soKey == curr->soKey)
+			{
+				pool.free(THREAD_ID, sentinel->index);
+				sentinel = curr;
+				break;
+			}
+
+			sentinel->next.set(curr->index, false);
+			if (pred->next.CAS(curr->index, sentinel->index, false, false, version)) break;
+		}
+		buckets.set(bucket, sentinel->index);
+		return sentinel;
+	}
+	// 최상위 비트를 끈 버킷
+	static uint32_t getParent(uint32_t bucket)
+	{
+		uint32_t msb{ 0x80000000 };
+		while (!(bucket & msb)) msb >>= 1;
+		return bucket & ~msb;
+	}
+};
+
+const int NUM_TEST{ 4000000 };
+const int KEY_RANGE{ 1000 };
+
+HashSet set; 
+
+void ThreadFunc(int numOfThread, int threadID)
+{
+	int key{};
+
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; i++)
+	{
+		switch (rand() % 3)
+		{
+		case 0:
+			key = rand() % KEY_RANGE;
+			set.add(key);
+			break;
+		case 1:
+			key = rand() % KEY_RANGE;
+			set.remove(key);
+			break;
+		case 2:
+			key = rand() % KEY_RANGE;
+			set.contain(key);
+			break;
+		default:
+			cout << "Error\n";
+			exit(-1);
+		}
+	}
+}
+
+int main()
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	stressSet(MAX_THREADS, STRESS_OPS, STRESS_KEY_RANGE,
+		[](int threadID, int key) { THREAD_ID = threadID; return set.add(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return set.remove(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return set.contain(key); });
+
+	for (int i = 1; i <= MAX_THREADS; i *= 2)
+	{
+		threads.clear();
+		set.clear();
+
+		sampler.start();
+		auto start{ high_resolution_clock::now() };
+
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
+		for (auto& thread : threads) thread.join();
+		sampler.stop();
+
+		set.printElement(20);
+
+		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << "Throughput = " << static_cast<long long>(NUM_TEST / seconds) << " ops/sec, ";
+		cout << "Buckets = " << set.getBucketCount() << "\n";
+		stats.print();
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+	}
+}
@@ -0,0 +1,301 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include "ebr.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	세밀한동기화(striped hash set)
+
+	1. 락은 NUM_STRIPES개로 고정하고, 버킷 i는 락 i % NUM_STRIPES가 보호한다.
+	   -> 버킷 수는 항상 NUM_STRIPES의 배수이므로 키가 속한 락은 버킷 수가 바뀌어도 같다. (key % NUM_STRIPES)
+	2. 버킷은 정렬된 짧은 리스트. add, remove는 스트라이프 락을 잡고, contains는 게으른동기화처럼 락 없이 순회한다.
+	   -> remove는 마킹한 뒤에 떼어낸다. contains는 마킹되지 않은 노드를 찾았을 때만 true
+	3. 평균 버킷 길이가 THRESHOLD를 넘으면, 그것을 발견한 스레드가 모든 락을 순서대로 잡고 버킷 수를 두배로 늘린다.
+	   -> 다른 스레드의 add, remove는 그동안 자기 락에서 기다린다.
+	4. 새 테이블에는 노드를 복사해서 넣고 포인터 하나로 교체한다. -> 이전 테이블을 순회중인 contains는 그대로 끝까지 순회할 수 있다.
+	5. 떼어낸 노드와 이전 테이블의 노드는 EBR로 아무도 참조하지 않게 된 뒤에 delete한다.
+
+	※ 이전 테이블의 버킷 배열은 clear할 때 해제한다. -> 두배씩 늘어나므로 모두 합쳐도 현재 테이블보다 작다.
+	※ 성긴동기화 리스트의 전역 mtx와 달리 서로 다른 스트라이프의 연산은 동시에 진행된다.
+*/
+
+constexpr int MAX_THREADS{ 8 };
+constexpr int NUM_STRIPES{ 64 };
+constexpr int THRESHOLD{ 4 };		// 버킷당 평균 노드 수가 이를 넘으면 버킷 수를 늘린다.
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+class Node
+{
+public:
+	int key{};
+	atomic<bool> marked{};
+	atomic<Node*> next{};
+public:
+	Node() = default;
+	Node(int value) { key = value; }
+	~Node() = default;
+};
+
+NodeStats<MAX_THREADS> stats{};
+
+// EBR이 노드를 delete할 때 해제 수를 센다.
+struct NodeDeleter
+{
+	void operator()(Node* node) const
+	{
+		delete node;
+		stats.onFree(THREAD_ID);
+	}
+};
+
+class Table
+{
+public:
+	vector<atomic<Node*>> buckets;
+public:
+	explicit Table(size_t size) : buckets(size) {}
+
+	atomic<Node*>& getBucket(int key) { return buckets[static_cast<unsigned>(key) % buckets.size()]; }
+};
+
+class HashSet
+{
+private:
+	struct alignas(64) Stripe
+	{
+		mutex mtx{};
+	};
+private:
+	Stripe stripes[NUM_STRIPES]{};
+	atomic<Table*> table{};
+	vector<unique_ptr<Table>> tables{};		// 지금까지 만든 테이블. 락을 모두 잡은 스레드만 추가한다.
+	atomic<int> count{};
+	EBR<Node, MAX_THREADS, NodeDeleter> ebr{};
+public:
+	HashSet() { reset(); }
+	~HashSet() { clear(); }
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void clear()
+	{
+		for (auto& bucket : table.load(memory_order_relaxed)->buckets)
+		{
+			Node* node{ bucket.load(memory_order_relaxed) };
+			while (node)
+			{
+				Node* next{ node->next.load(memory_order_relaxed) };
+				delete node;
+				stats.onRemove(THREAD_ID);
+				stats.onFree(THREAD_ID);
+				node = next;
+			}
+		}
+		ebr.clear();
+		reset();
+	}
+	bool add(int key)
+	{
+		mutex& mtx{ getLock(key) };
+		mtx.lock();
+
+		// 락을 잡은 동안에는 테이블이 바뀌지 않는다.
+		Table* current{ table.load(memory_order_relaxed) };
+		atomic<Node*>* link{ &current->getBucket(key) };
+		Node* curr{ link->load(memory_order_relaxed) };
+		while (curr && curr->key < key)
+		{
+			link = &curr->next;
+			curr = link->load(memory_order_relaxed);
+		}
+		if (curr && key == curr->key)
+		{
+			mtx.unlock();
+			return false;
+		}
+
+		Node* node{ new Node{ key } };
+		stats.onAlloc(THREAD_ID);
+		node->next.store(curr, memory_order_relaxed);
+		link->store(node, memory_order_release);		// 락 없이 순회하는 contains도 초기화된 노드를 보도록
+		mtx.unlock();
+
+		size_t size{ current->buckets.size() };
+		if (count.fetch_add(1, memory_order_relaxed) + 1 > THRESHOLD * static_cast<long long>(size)) resize(current);
+		return true;
+	}
+	bool remove(int key)
+	{
+		mutex& mtx{ getLock(key) };
+		mtx.lock();
+
+		Table* current{ table.load(memory_order_relaxed) };
+		atomic<Node*>* link{ &current->getBucket(key) };
+		Node* curr{ link->load(memory_order_relaxed) };
+		while (curr && curr->key < key)
+		{
+			link = &curr->next;
+			curr = link->load(memory_order_relaxed);
+		}
+		if (!curr || key != curr->key)
+		{
+			mtx.unlock();
+			return false;
+		}
+
+		curr->marked.store(true, memory_order_relaxed);		// 떼어내는 store가 release이므로 마킹이 먼저 보인다.
+		link->store(curr->next.load(memory_order_relaxed), memory_order_release);
+		mtx.unlock();
+
+		count.fetch_sub(1, memory_order_relaxed);
+		stats.onRemove(THREAD_ID);
+		ebr.retire(THREAD_ID, curr);
+		return true;
+	}
+	bool contains(int key)
+	{
+		ebr.start(THREAD_ID);
+		Node* curr{ table.load(memory_order_acquire)->getBucket(key).load(memory_order_acquire) };
+		while (curr && curr->key < key) curr = curr->next.load(memory_order_acquire);
+		bool result{ curr && key == curr->key && !curr->marked.load(memory_order_relaxed) };
+		ebr.end(THREAD_ID);
+		return result;
+	}
+	size_t getBucketCount() { return table.load(memory_order_relaxed)->buckets.size(); }
+	void printElement(int count)
+	{
+		for (auto& bucket : table.load()->buckets)
+			for (Node* node = bucket.load(); node; node = node->next.load())
+			{
+				cout << node->key << " ";
+				if (!(--count)) { cout << "\n"; return; }
+			}
+		cout << "\n";
+	}
+private:
+	mutex& getLock(int key) { return stripes[static_cast<unsigned>(key) % NUM_STRIPES].mtx; }
+	void reset()
+	{
+		tables.clear();
+		tables.emplace_back(new Table{ NUM_STRIPES });
+		table.store(tables.back().get(), memory_order_relaxed);
+		count.store(0, memory_order_relaxed);
+	}
+	// oldTable을 보고 크기를 늘리기로 했다면, 락을 모두 잡은 뒤에도 그대로인지 확인한다.
+	void resize(Table* oldTable)
+	{
+		for (auto& stripe : stripes) stripe.mtx.lock();
+
+		if (oldTable == table.load(memory_order_relaxed))
+		{
+			unique_ptr<Table> newTable{ new Table{ oldTable->buckets.size() * 2 } };
+
+			// 버킷 하나의 키는 정렬되어 있고 같은 새 버킷으로 가는 키끼리도 순서가 유지된다. -> 뒤에 이어붙인다.
+			vector<atomic<Node*>*> tails(newTable->buckets.size());
+			for (size_t i = 0; i < tails.size(); ++i) tails[i] = &newTable->buckets[i];
+			for (auto& bucket : oldTable->buckets)
+				for (Node* node = bucket.load(memory_order_relaxed); node; node = node->next.load(memory_order_relaxed))
+				{
+					Node* copy{ new Node{ node->key } };
+					stats.onAlloc(THREAD_ID);
+					atomic<Node*>*& tail{ tails[static_cast<unsigned>(node->key) % tails.size()] };
+					tail->store(copy, memory_order_relaxed);
+					tail = &copy->next;
+				}
+
+			table.store(newTable.get(), memory_order_release);		// 교체 전의 복사가 모두 보이도록
+			tables.push_back(move(newTable));
+
+			// next는 그대로 두므로 이전 테이블을 순회중인 contains는 계속 진행할 수 있다.
+			for (auto& bucket : oldTable->buckets)
+			{
+				Node* node{ bucket.load(memory_order_relaxed) };
+				while (node)
+				{
+					Node* next{ node->next.load(memory_order_relaxed) };		// retire하면 바로 해제될 수 있다.
+					stats.onRemove(THREAD_ID);
+					ebr.retire(THREAD_ID, node);
+					node = next;
+				}
+			}
+		}
+
+		for (auto& stripe : stripes) stripe.mtx.unlock();
+	}
+};
+
+constexpr int NUM_TEST{ 4000000 };
+constexpr int KEY_RANGE{ 1000 };
+
+HashSet set;
+
+void ThreadFunc(int numOfThread, int threadID)
+{
+	int key{};
+
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		switch (rand() % 3) {
+		case 0:
+			key = rand() % KEY_RANGE;
+			set.add(key);
+			break;
+		case 1:
+			key = rand() % KEY_RANGE;
+			set.remove(key);
+			break;
+		case 2:
+			key = rand() % KEY_RANGE;
+			set.contains(key);
+			break;
+		default: cout << "Error\n";
+			exit(-1);
+		}
+	}
+}
+
+int main()
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	stressSet(MAX_THREADS, STRESS_OPS, STRESS_KEY_RANGE,
+		[](int threadID, int key) { THREAD_ID = threadID; return set.add(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return set.remove(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return set.contains(key); });
+
+	for (int i = 1; i <= MAX_THREADS; i *= 2)
+	{
+		threads.clear();
+		set.clear();
+
+		sampler.start();
+		auto start{ high_resolution_clock::now() };
+
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
+		for (auto& thread : threads) thread.join();
+		sampler.stop();
+
+		set.printElement(20);
+
+		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << "Throughput = " << static_cast<long long>(NUM_TEST / seconds) << " ops/sec, ";
+		cout << "Buckets = " << set.getBucketCount() << "\n";
+		stats.print();
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+	}
+}
@@ -0,0 +1,426 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "ebr.h"
+#include "memory_usage.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	비멈춤동기화(open addressing hash set)
+
+	1. 노드 없이 키를 평평한 배열에 직접 저장한다. 슬롯 16개가 한 그룹이고, 그룹의 키 16개는 캐시라인 하나(64바이트)
+	2. 슬롯마다 1바이트 태그를 따로 둔다. 그룹의 태그 16개를 SSE2 명령 한번으로 비교해 후보 슬롯만 키를 읽는다.
+	   - EMPTY(0xFF): 아직 키가 없는 슬롯
+	   - h2(0x00 ~ 0x7E): 키가 들어있다. h2는 해시의 상위 7비트
+	   - h2 | 0x80: 삭제된 키 (툼스톤) -> 같은 키를 다시 넣으면 태그만 h2로 되돌린다.
+	   - MOVED(0x7F): 새 테이블로 옮긴 슬롯 -> 더이상 바뀌지 않는다.
+	3. 슬롯의 키는 CAS로 한번만 기록하고 바꾸지 않는다. -> 키는 탐색 순서에서 처음 자리잡은 슬롯 하나에만 존재한다.
+	4. add, remove는 태그의 CAS로 이루어진다. (EMPTY/툼스톤 -> h2, h2 -> 툼스톤)
+	5. 키가 기록된 슬롯(툼스톤 포함)이 3/4을 넘거나 빈 슬롯이 없으면 새 테이블로 옮긴다. 옮기는 일은 테이블을 쓰는 스레드들이 나눠서 한다.
+	   - 새 테이블은 이전 테이블의 next에 CAS로 하나만 단다. 크기는 이전 테이블 이상 -> 옮기는 키가 넘치지 않는다.
+	   - 스레드는 그룹을 하나씩 맡아(claimed의 fetch_add) 슬롯의 태그를 MOVED로 바꾸고, 들어있던 키를 새 테이블에 넣는다.
+	   - 연산이 MOVED 태그를 만나면 옮기는 일을 돕고 새 테이블에서 다시 한다. -> 태그의 CAS가 MOVED에서 실패하므로 옮긴 슬롯은 바뀌지 않는다.
+	   - 모든 그룹을 옮기면 table을 새 테이블로 바꾼다. 그 전까지는 이전 테이블이 기준이고, 새 테이블에는 옮기는 스레드만 쓴다.
+	   ※ 옮기기를 마치려면 다른 스레드가 맡은 그룹(슬롯 16개)이 끝나기를 기다린다. 쓰기 연산이 끝나기를 기다리지는 않는다.
+	6. 이전 테이블은 EBR로 해제한다. 모든 연산은 에포크 안에서 테이블을 읽는다.
+	   -> 툼스톤만 정리하는 같은 크기의 재해시가 계속 일어나도 메모리가 쌓이지 않는다. (스레드마다 마지막으로 떼어낸 테이블까지만 남는다.)
+
+	※ 찾는 키는 대부분 첫 그룹에 있다. -> 조회 한번에 태그 16바이트와 키 캐시라인 하나
+	※ 태그가 EMPTY여도 키가 기록되어 있을 수 있다. (키를 기록하고 태그를 바꾸기 전) -> 탐색은 키까지 비어있는 슬롯에서만 멈춘다.
+	※ 키는 0 이상이어야 한다. (-1은 빈 슬롯)
+*/
+
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+constexpr int GROUP_SIZE{ 16 };
+constexpr uint8_t EMPTY{ 0xFF };
+constexpr uint8_t DELETED{ 0x80 };		// 툼스톤 비트
+constexpr uint8_t MOVED{ 0x7F };		// 새 테이블로 옮긴 슬롯. h2는 0x7E까지만 쓴다.
+constexpr int EMPTY_KEY{ -1 };
+constexpr size_t MIN_GROUPS{ 4 };		// 태그 영역(그룹당 16바이트)이 캐시라인의 배수가 되도록
+
+// mask의 가장 낮은 1 비트 위치
+inline int lowestBit(unsigned mask)
+{
+#ifdef _MSC_VER
+	unsigned long index{};
+	_BitScanForward(&index, mask);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+class Table
+{
+public:
+	size_t numGroups{};
+	atomic<size_t> used{};		// 키가 기록된 슬롯 수 (툼스톤 포함)
+	atomic<Table*> next{};		// 옮겨갈 새 테이블
+	atomic<size_t> claimed{};	// 옮기기를 맡은 그룹 수
+	atomic<size_t> moved{};		// 옮기기를 마친 그룹 수
+private:
+	unique_ptr<char[]> storage{};
+	atomic<uint8_t>* tags{};	// [numGroups * GROUP_SIZE]
+	atomic<int>* keys{};		// [numGroups * GROUP_SIZE], 그룹마다 64바이트에 정렬
+public:
+	explicit Table(size_t groups)
+	{
+		numGroups = groups;
+		size_t slots{ numGroups * GROUP_SIZE };
+		storage.reset(new char[slots * (sizeof(atomic<uint8_t>) + sizeof(atomic<int>)) + 63]);
+
+		char* base{ reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(storage.get()) + 63) & ~uintptr_t{ 63 }) };
+		tags = reinterpret_cast<atomic<uint8_t>*>(base);
+		keys = reinterpret_cast<atomic<int>*>(base + slots * sizeof(atomic<uint8_t>));
+		for (size_t i = 0; i < slots; ++i)
+		{
+			new (&tags[i]) atomic<uint8_t>{ EMPTY };
+			new (&keys[i]) atomic<int>{ EMPTY_KEY };
+		}
+	}
+
+	size_t capacity() { return numGroups * GROUP_SIZE; }
+	uint8_t getTag(size_t slot) { return tags[slot].load(memory_order_relaxed); }
+	int getKey(size_t slot) { return keys[slot].load(memory_order_relaxed); }
+
+	// 키가 이미 있으면 false, 새로 넣었거나 툼스톤을 되살렸으면 true
+	// 빈 슬롯이 없거나 옮기는 중인 그룹을 만나면 retry -> 새 테이블로 옮긴 뒤에 다시 한다.
+	bool add(int key, bool* retry)
+	{
+		uint64_t hash{ getHash(key) };
+		uint8_t h2{ getH2(hash) };
+
+		for (size_t i = 0, group = getGroup(hash); i < numGroups; ++i, group = (group + 1) & (numGroups - 1))
+		{
+			size_t first{ group * GROUP_SIZE };
+
+			// 같은 키가 들어있거나 삭제된 슬롯
+			for (unsigned mask = match(first, h2) | match(first, h2 | DELETED); mask; mask &= mask - 1)
+			{
+				size_t slot{ first + lowestBit(mask) };
+				if (key == keys[slot].load(memory_order_acquire)) return revive(slot, h2, retry);
+			}
+
+			// 옮긴 슬롯이 빈 슬롯이었는지, key가 들어있었는지 알 수 없다.
+			if (match(first, MOVED))
+			{
+				*retry = true;
+				return false;
+			}
+
+			// 빈 슬롯: 키를 먼저 CAS로 차지하고 태그를 바꾼다. 같은 키를 넣는 스레드끼리는 같은 슬롯을 차지한다.
+			for (unsigned mask = match(first, EMPTY); mask; mask &= mask - 1)
+			{
+				size_t slot{ first + lowestBit(mask) };
+				int old{ EMPTY_KEY };
+				if (keys[slot].compare_exchange_strong(old, key, memory_order_acq_rel, memory_order_acquire))
+				{
+					used.fetch_add(1, memory_order_relaxed);
+					old = key;
+				}
+				if (key == old) return revive(slot, h2, retry);
+			}
+		}
+
+		*retry = true;
+		return false;
+	}
+	bool remove(int key, bool* retry)
+	{
+		uint64_t hash{ getHash(key) };
+		uint8_t h2{ getH2(hash) };
+		size_t slot{};
+
+		if (!find(key, hash, &slot, retry)) return false;
+		uint8_t tag{ h2 };
+		if (tags[slot].compare_exchange_strong(tag, static_cast<uint8_t>(h2 | DELETED), memory_order_acq_rel, memory_order_relaxed)) return true;
+		if (MOVED == tag) *retry = true;
+		return false;
+	}
+	bool contain(int key, bool* retry)
+	{
+		size_t slot{};
+		return find(key, getHash(key), &slot, retry);
+	}
+	// group의 슬롯을 하나씩 MOVED로 바꾸고, 바꾸기 전에 들어있던 키를 to에 넣는다. 그룹마다 한 스레드만 호출한다.
+	void moveGroup(size_t group, Table* to)
+	{
+		for (size_t slot = group * GROUP_SIZE; slot < (group + 1) * GROUP_SIZE; ++slot)
+		{
+			uint8_t tag{ tags[slot].exchange(MOVED, memory_order_acq_rel) };
+			if (tag & DELETED) continue;		// EMPTY 또는 툼스톤
+			bool retry{};
+			to->add(keys[slot].load(memory_order_acquire), &retry);
+		}
+	}
+private:
+	// 들어있는(태그가 h2인) key의 슬롯을 찾는다. 옮기는 중인 그룹을 만나면 retry
+	bool find(int key, uint64_t hash, size_t* slot, bool* retry)
+	{
+		uint8_t h2{ getH2(hash) };
+
+		for (size_t i = 0, group = getGroup(hash); i < numGroups; ++i, group = (group + 1) & (numGroups - 1))
+		{
+			size_t first{ group * GROUP_SIZE };
+
+			for (unsigned mask = match(first, h2); mask; mask &= mask - 1)
+			{
+				*slot = first + lowestBit(mask);
+				if (key == keys[*slot].load(memory_order_acquire)) return true;
+			}
+
+			if (match(first, MOVED))
+			{
+				*retry = true;
+				return false;
+			}
+
+			// 키까지 비어있는 슬롯이 있으면 key는 이보다 뒤에 있을 수 없다.
+			for (unsigned mask = match(first, EMPTY); mask; mask &= mask - 1)
+			{
+				int other{ keys[first + lowestBit(mask)].load(memory_order_acquire) };
+				if (EMPTY_KEY == other || key == other) return false;
+			}
+		}
+		return false;
+	}
+	// key가 기록된 슬롯의 태그를 h2로 바꾼다. 이미 h2면 다른 스레드가 먼저 넣은 것, MOVED면 retry
+	bool revive(size_t slot, uint8_t h2, bool* retry)
+	{
+		uint8_t tag{ tags[slot].load(memory_order_relaxed) };
+		while (h2 != tag)
+		{
+			if (MOVED == tag)
+			{
+				*retry = true;
+				return false;
+			}
+			if (tags[slot].compare_exchange_weak(tag, h2, memory_order_acq_rel, memory_order_relaxed)) return true;
+		}
+		return false;
+	}
+	// 그룹의 태그 16개를 한번에 value와 비교해 일치하는 슬롯을 비트로 돌려준다.
+	unsigned match(size_t first, uint8_t value)
+	{
+#ifdef USE_SSE2
+		// 태그 16개를 한 명령으로 읽는다. (바이트 단위로는 원자적) 이후의 키 읽기가 앞서지 않도록 acquire fence
+		__m128i group{ _mm_load_si128(reinterpret_cast<const __m128i*>(&tags[first])) };
+		atomic_thread_fence(memory_order_acquire);
+		return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(value)))));
+#else
+		unsigned mask{};
+		for (int i = 0; i < GROUP_SIZE; ++i)
+			if (value == tags[first + i].load(memory_order_relaxed)) mask |= 1u << i;
+		atomic_thread_fence(memory_order_acquire);
+		return mask;
+#endif
+	}
+	static uint64_t getHash(int key) { return static_cast<uint64_t>(static_cast<uint32_t>(key)) * 0x9E3779B97F4A7C15ULL; }
+	static uint8_t getH2(uint64_t hash) { return static_cast<uint8_t>((hash >> 57) % 127); }	// 0x7F는 MOVED이므로 0x7E까지만
+	size_t getGroup(uint64_t hash) { return static_cast<size_t>(hash >> 32) & (numGroups - 1); }
+};
+
+class HashSet
+{
+private:
+	atomic<Table*> table{};
+	EBR<Table, MAX_THREADS> ebr{};
+	atomic<int> count{};					// 들어있는 키의 수
+public:
+	HashSet() { reset(); }
+	~HashSet() { delete table.load(memory_order_relaxed); }
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void clear() { reset(); }
+	bool add(int key)
+	{
+		ebr.start(THREAD_ID);
+		while (true)
+		{
+			Table* current{ table.load(memory_order_acquire) };
+			bool retry{};
+			bool result{ current->add(key, &retry) };
+			if (retry)
+			{
+				migrate(current);
+				continue;
+			}
+
+			if (result) count.fetch_add(1, memory_order_relaxed);
+			if (current->used.load(memory_order_relaxed) * 4 > current->capacity() * 3) migrate(current);
+			ebr.end(THREAD_ID);
+			return result;
+		}
+	}
+	bool remove(int key)
+	{
+		ebr.start(THREAD_ID);
+		while (true)
+		{
+			Table* current{ table.load(memory_order_acquire) };
+			bool retry{};
+			bool result{ current->remove(key, &retry) };
+			if (retry)
+			{
+				migrate(current);
+				continue;
+			}
+
+			if (result) count.fetch_sub(1, memory_order_relaxed);
+			ebr.end(THREAD_ID);
+			return result;
+		}
+	}
+	bool contain(int key)
+	{
+		ebr.start(THREAD_ID);
+		while (true)
+		{
+			Table* current{ table.load(memory_order_acquire) };
+			bool retry{};
+			bool result{ current->contain(key, &retry) };
+			if (retry)
+			{
+				migrate(current);
+				continue;
+			}
+
+			ebr.end(THREAD_ID);
+			return result;
+		}
+	}
+	void printElement(int count)
+	{
+		Table* current{ table.load() };
+		for (size_t slot = 0; slot < current->capacity(); ++slot)
+		{
+			if (current->getTag(slot) & DELETED) continue;		// EMPTY 또는 툼스톤
+			cout << current->getKey(slot) << " ";
+			if (!(--count)) break;
+		}
+		cout << "\n";
+	}
+	void printSlots()
+	{
+		Table* current{ table.load() };
+		cout << "\tSlots: capacity = " << current->capacity() << ", used = " << current->used << ", live = " << count << "\n";
+	}
+private:
+	void reset()
+	{
+		delete table.load(memory_order_relaxed);
+		ebr.clear();
+		table.store(new Table{ MIN_GROUPS }, memory_order_relaxed);
+		count.store(0, memory_order_relaxed);
+	}
+	// oldTable을 새 테이블로 옮기는 일을 돕는다. 에포크 안에서 호출한다.
+	void migrate(Table* oldTable)
+	{
+		Table* newTable{ oldTable->next.load(memory_order_acquire) };
+		if (!newTable)
+		{
+			// 툼스톤이 대부분이면 크기는 그대로 두고 정리만 한다.
+			size_t groups{ oldTable->numGroups };
+			if (static_cast<size_t>(count.load(memory_order_relaxed)) * 2 > oldTable->capacity()) groups *= 2;
+
+			Table* created{ new Table{ groups } };
+			if (oldTable->next.compare_exchange_strong(newTable, created, memory_order_acq_rel, memory_order_acquire)) newTable = created;
+			else delete created;		// 다른 스레드가 먼저 달았다.
+		}
+
+		// 남은 그룹을 하나씩 맡아 옮긴다.
+		for (size_t group = oldTable->claimed.fetch_add(1, memory_order_relaxed); group < oldTable->numGroups; group = oldTable->claimed.fetch_add(1, memory_order_relaxed))
+		{
+			oldTable->moveGroup(group, newTable);
+			oldTable->moved.fetch_add(1, memory_order_release);
+		}
+		// 다른 스레드가 맡은 그룹이 끝나야 새 테이블이 기준이 된다.
+		while (oldTable->moved.load(memory_order_acquire) < oldTable->numGroups) this_thread::yield();
+
+		Table* expected{ oldTable };
+		if (table.compare_exchange_strong(expected, newTable, memory_order_acq_rel, memory_order_relaxed))
+			ebr.retireNow(THREAD_ID, oldTable);		// 다른 스레드가 아직 이전 테이블을 읽고 있을 수 있다.
+	}
+};
+
+constexpr int NUM_TEST{ 4000000 };
+constexpr int KEY_RANGE{ 1000 };
+
+HashSet set;
+
+void ThreadFunc(int numOfThread, int threadID)
+{
+	int key{};
+
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		switch (rand() % 3) {
+		case 0:
+			key = rand() % KEY_RANGE;
+			set.add(key);
+			break;
+		case 1:
+			key = rand() % KEY_RANGE;
+			set.remove(key);
+			break;
+		case 2:
+			key = rand() % KEY_RANGE;
+			set.contain(key);
+			break;
+		default: cout << "Error\n";
+			exit(-1);
+		}
+	}
+}
+
+int main()
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	stressSet(MAX_THREADS, STRESS_OPS, STRESS_KEY_RANGE,
+		[](int threadID, int key) { THREAD_ID = threadID; return set.add(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return set.remove(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return set.contain(key); });
+
+	for (int i = 1; i <= MAX_THREADS; i *= 2)
+	{
+		threads.clear();
+		set.clear();
+
+		sampler.start();
+		auto start{ high_resolution_clock::now() };
+
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
+		for (auto& thread : threads) thread.join();
+		sampler.stop();
+
+		set.printElement(20);
+
+		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << "Throughput = " << static_cast<long long>(NUM_TEST / seconds) << " ops/sec\n";
+		set.printSlots();
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+	}
+}
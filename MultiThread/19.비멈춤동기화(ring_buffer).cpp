@@ -0,0 +1,172 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include "memory_usage.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	비멈춤동기화(ring buffer)
+
+	1. 생성할 때 정한 크기(2의 거듭제곱)의 배열을 원형으로 사용한다. -> 생성 이후에는 할당이 없다.
+	2. 칸마다 sequence를 둔다. push 위치가 pos일 때 sequence == pos면 비어있고, pos + 1이면 값이 들어있다.
+	3. push는 tail을, pop은 head를 CAS로 한칸 차지한 뒤 그 칸에 쓰고 읽는다. sequence는 release로 넘겨준다.
+	   -> pop한 칸의 sequence는 pos + 크기가 되어 한바퀴 뒤의 push를 기다린다.
+	4. head, tail은 서로 다른 캐시라인에 둔다. -> push와 pop이 서로의 캐시라인을 무효화하지 않는다.
+
+	※ 칸을 차지하는 위치(pos)는 계속 증가하므로 ABA가 없다. (스탬프가 필요없다.)
+	※ 가득 차면 try_push, 비어있으면 try_pop이 false를 반환한다.
+*/
+
+constexpr int MAX_THREADS{ 8 };
+constexpr size_t CAPACITY{ 1 << 16 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+class Queue
+{
+private:
+	struct Cell
+	{
+		atomic<size_t> sequence{};
+		int data{};
+	};
+private:
+	alignas(64) atomic<size_t> tail{};		// 다음 push 위치
+	alignas(64) atomic<size_t> head{};		// 다음 pop 위치
+	alignas(64) Cell* buffer{};
+	size_t mask{};
+public:
+	explicit Queue(size_t capacity)
+	{
+		size_t size{ 2 };
+		while (size < capacity) size *= 2;
+		buffer = new Cell[size];
+		mask = size - 1;
+		for (size_t i = 0; i < size; ++i) buffer[i].sequence.store(i, memory_order_relaxed);
+	}
+	~Queue() { delete[] buffer; }
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void init()
+	{
+		int value{};
+		while (try_pop(&value));
+	}
+	bool try_push(int value)
+	{
+		size_t pos{ tail.load(memory_order_relaxed) };
+		while (true)
+		{
+			Cell& cell{ buffer[pos & mask] };
+			size_t sequence{ cell.sequence.load(memory_order_acquire) };
+			intptr_t diff{ static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos) };
+
+			if (0 == diff)
+			{
+				if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+				{
+					cell.data = value;
+					cell.sequence.store(pos + 1, memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) return false;		// 한바퀴 전의 값이 아직 pop되지 않았다. -> 가득 참
+			else pos = tail.load(memory_order_relaxed);
+		}
+	}
+	bool try_pop(int* value)
+	{
+		size_t pos{ head.load(memory_order_relaxed) };
+		while (true)
+		{
+			Cell& cell{ buffer[pos & mask] };
+			size_t sequence{ cell.sequence.load(memory_order_acquire) };
+			intptr_t diff{ static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1) };
+
+			if (0 == diff)
+			{
+				if (head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+				{
+					*value = cell.data;
+					cell.sequence.store(pos + mask + 1, memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0) return false;		// 아직 push되지 않았다. -> 비어있음
+			else pos = head.load(memory_order_relaxed);
+		}
+	}
+	size_t capacity() { return mask + 1; }
+	void printElement(int count)
+	{
+		for (size_t pos = head; pos != tail && count; ++pos, --count) cout << buffer[pos & mask].data << ", ";
+		cout << endl;
+	}
+};
+
+constexpr int NUM_TEST{ 10000000 };
+
+Queue que{ CAPACITY };
+
+void ThreadFunc(int numOfThread, int threadID)
+{
+	int value{};
+
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		switch (rand() % 2)
+		{
+		case 0: que.try_push(i); break;
+		case 1: que.try_pop(&value); break;
+		default: cout << "Error\n"; exit(-1);
+		}
+	}
+}
+
+int main()
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	// 스트레스 테스트의 push는 항상 성공해야 하므로 전체 push 수보다 큰 큐를 따로 쓴다.
+	// -> 가득 찬 큐에 모든 스레드가 push를 재시도하면 pop할 스레드가 없어 멈춘다.
+	{
+		Queue stressQue{ static_cast<size_t>(MAX_THREADS) * STRESS_OPS };
+		stressQueue(MAX_THREADS, STRESS_OPS, true,
+			[&](int threadID, int value) { THREAD_ID = threadID; if (!stressQue.try_push(value)) exit(-1); },
+			[&](int threadID) { THREAD_ID = threadID; int value{}; return stressQue.try_pop(&value) ? value : -1; });
+	}
+
+	cout << "Capacity = " << que.capacity() << "\n";
+	for (int i = 1; i <= MAX_THREADS; i *= 2)
+	{
+		threads.clear();
+		que.init();
+
+		size_t startMemory{ getResidentMemory() };
+		sampler.start();
+		auto start{ high_resolution_clock::now() };
+
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
+		for (auto& thread : threads) thread.join();
+		sampler.stop();
+
+		que.printElement(20);
+
+		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		size_t endMemory{ getResidentMemory() };
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << duration_cast<nanoseconds>(duration).count() / NUM_TEST << " ns/op, ";
+		cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB)\n";
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+	}
+}
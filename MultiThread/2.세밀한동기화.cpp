@@ -1,7 +1,11 @@
 ﻿#include <iostream>
+#include <thread>
 #include <mutex>
 #include <chrono>
 #include <vector>
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "node_pool.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -11,15 +15,20 @@ using namespace std::chrono;
 
 	1. 노드 객체가 mutex 객체를 가지고 있다.
 	2. 각각의 노드를 개별적으로 락킹한다.
+	3. 노드는 NodePool에서 할당하고, next는 포인터 대신 32비트 인덱스로 가리킨다.
+	   -> 노드를 64바이트로 정렬해서 인덱스를 주소로 바꿀 때 곱셈 대신 시프트를 쓰고, 이웃 노드의 락과 캐시라인을 공유하지 않는다.
 */
 
-class Node
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+class alignas(64) Node
 {
 private:
 	mutex mtx{};
 public:
 	int key{};
-	Node* next{};
+	uint32_t next{};
 	Node() = default;
 	Node(int key_value) { key = key_value; }
 	~Node() = default;
@@ -28,36 +37,55 @@ public:
 	void unlock() { mtx.unlock(); }
 };
 
+NodePool<Node, MAX_THREADS> pool{};
+NodeStats<MAX_THREADS> stats{};
+
 class List
 {
-	Node head{ 0x80000000 }, tail{ 0x7FFFFFFF };
+	Node* head{}, * tail{};
+	uint32_t tailIndex{};
 public:
-	List() { head.next = &tail; }
+	List()
+	{
+		head = pool.get(newNode(0x80000000));
+		tailIndex = newNode(0x7FFFFFFF);
+		tail = pool.get(tailIndex);
+		head->next = tailIndex;
+	}
 	~List() {}
 
 	void init()
 	{
-		Node* ptr{};
-		while (head.next != &tail)
+		uint32_t ptr{};
+		while (head->next != tailIndex)
 		{
-			ptr = head.next;
-			head.next = head.next->next;
-			delete ptr;
+			ptr = head->next;
+			head->next = pool.get(ptr)->next;
+			pool.free(THREAD_ID, ptr);
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
 		}
 	}
+	uint32_t newNode(int key)
+	{
+		uint32_t index{ pool.alloc(THREAD_ID) };
+		stats.onAlloc(THREAD_ID);
+		pool.get(index)->key = key;
+		return index;
+	}
 	bool add(int key)
 	{
 		Node* pred{}, * curr{};
 
-		head.lock();
-		pred = &head;
-		curr = pred->next;
+		head->lock();
+		pred = head;
+		curr = pool.get(pred->next);
 		curr->lock();
 		while (curr->key < key)
 		{
 			pred->unlock();
 			pred = curr;
-			curr = curr->next;
+			curr = pool.get(curr->next);
 			curr->lock();
 		}
 		if (key == curr->key)
@@ -68,8 +96,8 @@ public:
 		}
 		else
 		{
-			Node* node{ new Node(key) };
-			node->next = curr;
+			uint32_t node{ newNode(key) };
+			pool.get(node)->next = pred->next;
 			pred->next = node;
 
 			curr->unlock();
@@ -81,23 +109,26 @@ public:
 	{
 		Node* pred{}, * curr{};
 
-		head.lock();
-		pred = &head;
-		curr = pred->next;
+		head->lock();
+		pred = head;
+		curr = pool.get(pred->next);
 		curr->lock();
 		while (curr->key < key)
 		{
 			pred->unlock();
 			pred = curr;
-			curr = curr->next;
+			curr = pool.get(curr->next);
 			curr->lock();
 		}
 		if (key == curr->key)
 		{
+			uint32_t target{ pred->next };
 			pred->next = curr->next;
 			curr->unlock();
 			pred->unlock();
-			delete curr;
+			stats.onRemove(THREAD_ID);
+			pool.free(THREAD_ID, target);
+			stats.onFree(THREAD_ID);
 			return true;
 		}
 		else
@@ -111,15 +142,15 @@ public:
 	{
 		Node* pred{}, * curr{};
 
-		head.lock();
-		pred = &head;
-		curr = pred->next;
+		head->lock();
+		pred = head;
+		curr = pool.get(pred->next);
 		curr->lock();
 		while (curr->key < key)
 		{
 			pred->unlock();
 			pred = curr;
-			curr = curr->next;
+			curr = pool.get(curr->next);
 			curr->lock();
 		}
 		if (key == curr->key)
@@ -137,13 +168,13 @@ public:
 	}
 	void printElement(int count)
 	{
-		Node* cur{ head.next };
+		Node* cur{ pool.get(head->next) };
 		for (int i = 0; i < count; ++i)
 		{
-			if (&tail == cur)
+			if (tail == cur)
 				break;
 			cout << cur->key << " ";
-			cur = cur->next;
+			cur = pool.get(cur->next);
 		}
 		cout << endl;
 	}
@@ -151,14 +182,15 @@ public:
 
 constexpr int NUM_TEST{ 4000000 };
 constexpr int KEY_RANGE{ 1000 };
-constexpr int MAX_THREADS{ 8 };
 
 List fList;
 
-void ThreadFunc(int numOfThread)
+void ThreadFunc(int numOfThread, int threadID)
 {
 	int key{};
 
+	THREAD_ID = threadID;
+
 	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
 	{
 		switch (rand() % 3) {
@@ -183,18 +215,25 @@ void ThreadFunc(int numOfThread)
 int main()
 {
 	vector<thread> threads{};
+	RssSampler sampler{};
 
 	for (int i = 1; i <= MAX_THREADS; i *= 2)
 	{
 		threads.clear();
+		sampler.start();
 		auto start{ high_resolution_clock::now() };
 
-		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i);
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
 		for (auto& thread : threads) thread.join();
+		sampler.stop();
 
 		fList.printElement(20);
 
 		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
 		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds\n";
+		stats.print();
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
 	}
 }
\ No newline at end of file
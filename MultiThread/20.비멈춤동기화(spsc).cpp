@@ -0,0 +1,160 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include "memory_usage.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	비멈춤동기화(spsc)
+
+	1. 생산자 하나, 소비자 하나 전용의 원형 큐. 생성할 때 정한 크기(2의 거듭제곱)의 배열을 사용한다.
+	2. tail은 생산자만, head는 소비자만 쓴다. -> CAS, exchange 같은 RMW 연산 없이 load, store만으로 충분하다. (wait-free)
+	3. 값을 쓰고 나서 tail을 release로 올리고, 소비자는 tail을 acquire로 읽은 뒤 값을 읽는다. head는 반대로.
+	4. 상대방의 위치는 캐시해두고, 캐시로 보아 가득 찼거나(생산자) 비었을(소비자) 때만 다시 읽는다.
+	   -> 상대방의 캐시라인을 읽는 횟수가 줄어든다. 캐시는 자기 위치와 같은 캐시라인에 둔다.
+
+	※ 위치는 계속 증가하고 배열 인덱스는 (위치 & mask)로 구한다. -> tail - head가 들어있는 개수
+	※ 생산자, 소비자가 둘 이상이면 안된다. 여러 생산자는 21.비멈춤동기화(mpsc).cpp, 여러 소비자는 19.비멈춤동기화(ring_buffer).cpp
+*/
+
+constexpr int MAX_THREADS{ 8 };
+constexpr size_t CAPACITY{ 1 << 10 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+class Queue
+{
+private:
+	// 생산자가 쓰는 캐시라인
+	alignas(64) atomic<size_t> tail{};		// 다음 push 위치
+	size_t cachedHead{};
+	// 소비자가 쓰는 캐시라인
+	alignas(64) atomic<size_t> head{};		// 다음 pop 위치
+	size_t cachedTail{};
+	// 읽기만 하는 캐시라인
+	alignas(64) int* buffer{};
+	size_t mask{};
+	bool cached{ true };
+public:
+	explicit Queue(size_t capacity)
+	{
+		size_t size{ 2 };
+		while (size < capacity) size *= 2;
+		buffer = new int[size] {};
+		mask = size - 1;
+	}
+	~Queue() { delete[] buffer; }
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void init()
+	{
+		head.store(tail.load(memory_order_relaxed), memory_order_relaxed);
+		cachedHead = cachedTail = head.load(memory_order_relaxed);
+	}
+	// false라면 상대방의 위치를 캐시하지 않고 매번 읽는다. (비교용)
+	void setCached(bool flag) { cached = flag; }
+
+	// 생산자 스레드만 호출해야 한다.
+	bool try_push(int value)
+	{
+		size_t pos{ tail.load(memory_order_relaxed) };
+		if (!cached || pos - cachedHead > mask)
+		{
+			cachedHead = head.load(memory_order_acquire);		// 소비자가 다 읽은 칸만 덮어쓴다.
+			if (pos - cachedHead > mask) return false;		// 가득 참
+		}
+		buffer[pos & mask] = value;
+		tail.store(pos + 1, memory_order_release);
+		return true;
+	}
+	// 소비자 스레드만 호출해야 한다.
+	bool try_pop(int* value)
+	{
+		size_t pos{ head.load(memory_order_relaxed) };
+		if (!cached || pos == cachedTail)
+		{
+			cachedTail = tail.load(memory_order_acquire);
+			if (pos == cachedTail) return false;		// 비어있음
+		}
+		*value = buffer[pos & mask];
+		head.store(pos + 1, memory_order_release);
+		return true;
+	}
+	size_t capacity() { return mask + 1; }
+	void printElement(int count)
+	{
+		for (size_t pos = head; pos != tail && count; ++pos, --count) cout << buffer[pos & mask] << ", ";
+		cout << endl;
+	}
+};
+
+constexpr int NUM_TEST{ 10000000 };
+
+Queue que{ CAPACITY };
+
+// 가득 차면 소비자가 비울 때까지 양보한다.
+void Producer(int threadID)
+{
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST; ++i)
+		while (!que.try_push(i)) this_thread::yield();
+}
+
+void Consumer(int threadID)
+{
+	int value{};
+
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST; ++i)
+	{
+		while (!que.try_pop(&value)) this_thread::yield();
+		if (value != i) { cout << "Error\n"; exit(-1); }
+	}
+}
+
+int main()
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	stressProducerConsumer(1, STRESS_OPS,
+		[](int threadID, int value) { THREAD_ID = threadID; while (!que.try_push(value)) this_thread::yield(); },
+		[](int threadID) { THREAD_ID = threadID; int value{}; return que.try_pop(&value) ? value : -1; });
+
+	cout << "Capacity = " << que.capacity() << "\n";
+
+	// 상대방의 위치를 캐시하는 버전과 매번 읽는 버전을 비교
+	for (bool cached : { true, false })
+	{
+		threads.clear();
+		que.init();
+		que.setCached(cached);
+		cout << (cached ? "[Cached Index]\n" : "[Uncached Index]\n");
+
+		size_t startMemory{ getResidentMemory() };
+		sampler.start();
+		auto start{ high_resolution_clock::now() };
+
+		threads.emplace_back(Producer, 0);
+		threads.emplace_back(Consumer, 1);
+		for (auto& thread : threads) thread.join();
+		sampler.stop();
+
+		que.printElement(20);
+
+		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		size_t endMemory{ getResidentMemory() };
+		cout << "1 Producer + 1 Consumer Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << duration_cast<nanoseconds>(duration).count() / NUM_TEST << " ns/op, ";
+		cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB)\n";
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+	}
+}
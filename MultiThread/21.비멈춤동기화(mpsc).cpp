@@ -0,0 +1,176 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include "magazine.h"
+#include "memory_usage.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	비멈춤동기화(mpsc)
+
+	1. 생산자 여럿, 소비자 하나 전용의 연결리스트 큐. 노드는 큐가 아니라 사용하는 쪽이 할당해서 넘긴다. (intrusive)
+	2. push는 tail을 exchange로 새 노드로 바꾸고, 이전 tail의 next에 새 노드를 연결한다. -> CAS 루프가 없다. (wait-free)
+	3. head는 소비자만 쓰므로 atomic이 아니다. 소비자는 next를 acquire로 읽기만 한다.
+	   -> 마지막 노드를 꺼낼 때 stub을 push하는 exchange 한번 외에는 RMW 연산이 없다.
+	4. 보초노드(stub)는 큐 안에 두고, 마지막 노드를 꺼낼 때 stub을 다시 push해서 마지막 노드의 next를 채운다.
+	5. pop은 next가 연결된 노드만 반환한다. -> 반환된 노드에 생산자가 더 이상 쓰지 않으므로, 해저드 포인터 없이 바로 재사용할 수 있다.
+
+	※ exchange와 next 연결 사이에 생산자가 멈추면, 소비자는 그 뒤의 노드를 볼 수 없어 비어있다고 판단한다. (소비자는 lock-free가 아니다.)
+	※ pop은 소비자 스레드 하나만 호출해야 한다. 소비자가 여럿이면 19.비멈춤동기화(ring_buffer).cpp
+*/
+
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+class Node
+{
+public:
+	int key{};
+	atomic<Node*> next{};
+	Node() = default;
+	Node(int newKey) { key = newKey; }
+	~Node() = default;
+};
+
+Magazine<Node, MAX_THREADS> magazine{};
+
+class Queue
+{
+private:
+	alignas(64) atomic<Node*> tail{};		// 생산자가 exchange하는 마지막 노드
+	alignas(64) Node* head{};				// 소비자만 쓰는 첫 노드
+	Node stub{};
+public:
+	Queue() { head = &stub; tail.store(&stub, memory_order_relaxed); }
+	~Queue() { init(); }
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void init()
+	{
+		for (Node* node = pop(); node; node = pop()) magazine.free(THREAD_ID, node);
+	}
+
+	// 생산자 스레드는 여럿이어도 된다.
+	void push(Node* node)
+	{
+		node->next.store(nullptr, memory_order_relaxed);
+		Node* prev{ tail.exchange(node, memory_order_acq_rel) };
+		prev->next.store(node, memory_order_release);		// 소비자는 이 store를 읽어야 node를 볼 수 있다.
+	}
+	// 소비자 스레드만 호출해야 한다. 비어있으면 nullptr
+	Node* pop()
+	{
+		Node* cur{ head };
+		Node* next{ cur->next.load(memory_order_acquire) };
+
+		if (&stub == cur)		// stub은 건너뛴다.
+		{
+			if (!next) return nullptr;
+			head = cur = next;
+			next = next->next.load(memory_order_acquire);
+		}
+		if (next) { head = next; return cur; }
+
+		// cur이 마지막 노드처럼 보인다.
+		if (cur != tail.load(memory_order_acquire)) return nullptr;		// 생산자가 exchange 후 아직 연결하지 못했다.
+		push(&stub);
+		next = cur->next.load(memory_order_acquire);
+		if (next) { head = next; return cur; }
+		return nullptr;
+	}
+	void printElement(int count)
+	{
+		for (Node* cur = head; cur && count; cur = cur->next.load())
+		{
+			if (&stub == cur) continue;
+			cout << cur->key << ", ";
+			--count;
+		}
+		cout << endl;
+	}
+};
+
+constexpr int NUM_TEST{ 10000000 };
+
+Queue que;
+
+void Producer(int numOfProducer, int threadID)
+{
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfProducer; ++i)
+	{
+		Node* node{ magazine.alloc(THREAD_ID) };
+		node->key = i;
+		que.push(node);
+	}
+}
+
+// 소비한 노드는 소비자의 매거진에 반환한다. -> 생산자의 매거진으로는 창고를 통해 돌아간다.
+void Consumer(int numOfProducer, int threadID)
+{
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfProducer * numOfProducer; ++i)
+	{
+		Node* node{ que.pop() };
+		while (!node)
+		{
+			this_thread::yield();
+			node = que.pop();
+		}
+		magazine.free(THREAD_ID, node);
+	}
+}
+
+int main()
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	stressProducerConsumer(MAX_THREADS - 1, STRESS_OPS,
+		[](int threadID, int value) { THREAD_ID = threadID; Node* node{ magazine.alloc(THREAD_ID) }; node->key = value; que.push(node); },
+		[](int threadID)
+		{
+			THREAD_ID = threadID;
+			Node* node{ que.pop() };
+			if (!node) return -1;
+			int key{ node->key };
+			magazine.free(THREAD_ID, node);
+			return key;
+		});
+
+	// 생산자 i개, 소비자 1개. 소비자의 스레드 번호는 i
+	for (int i = 1; i < MAX_THREADS; i *= 2)
+	{
+		threads.clear();
+		que.init();
+		magazine.resetCount();
+
+		size_t startMemory{ getResidentMemory() };
+		sampler.start();
+		auto start{ high_resolution_clock::now() };
+
+		for (int j = 0; j < i; ++j) threads.emplace_back(Producer, i, j);
+		threads.emplace_back(Consumer, i, i);
+		for (auto& thread : threads) thread.join();
+		sampler.stop();
+
+		que.printElement(20);
+
+		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		size_t endMemory{ getResidentMemory() };
+		cout << i << " Producers + 1 Consumer Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << duration_cast<nanoseconds>(duration).count() / NUM_TEST << " ns/op, ";
+		cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB), ";
+		cout << "Allocator Calls = " << magazine.getAllocatorCalls() << " (new/delete = " << magazine.getRequests() << ")\n";
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+	}
+}
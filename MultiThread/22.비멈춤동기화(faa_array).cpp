@@ -0,0 +1,221 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <climits>
+#include "hazard_pointer.h"
+#include "memory_usage.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	비멈춤동기화(faa array)
+
+	1. 노드 하나가 값 BUFFER_SIZE개를 담는 배열(세그먼트)이고, 세그먼트를 연결리스트로 잇는다.
+	2. push는 tail 세그먼트의 enqIdx를, pop은 head 세그먼트의 deqIdx를 fetch_add로 올려서 칸을 차지한다.
+	   -> 경합해도 실패하고 재시도하는 CAS 대신, 스레드마다 한번의 RMW로 서로 다른 칸을 얻는다.
+	3. push는 차지한 칸에 EMPTY -> 값을 CAS하고, pop은 칸을 TAKEN으로 exchange해서 값을 가져온다.
+	   -> pop이 먼저 칸을 TAKEN으로 바꿨다면 push의 CAS가 실패하고, push는 다음 칸을 다시 차지한다.
+	4. 세그먼트가 가득 차면 새 세그먼트를 CAS로 연결하고 tail을 옮긴다. 다 읽은 세그먼트는 head를 옮기고 해저드 포인터로 retire한다.
+
+	※ CAS 루프는 세그먼트를 연결할 때(BUFFER_SIZE번에 한번)만 경합한다.
+	※ 값으로 EMPTY(INT_MIN), TAKEN(INT_MIN + 1)은 넣을 수 없다.
+	※ 8.비멈춤동기화.cpp와 같은 부하로 MAX_THREADS(32)까지 측정한다.
+*/
+
+constexpr int MAX_THREADS{ 32 };
+constexpr int BUFFER_SIZE{ 1024 };		// 세그먼트 하나의 칸 수
+constexpr int EMPTY{ INT_MIN };
+constexpr int TAKEN{ INT_MIN + 1 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+class Node
+{
+public:
+	alignas(64) atomic<int> enqIdx{};
+	alignas(64) atomic<int> deqIdx{};
+	alignas(64) atomic<Node*> next{};
+	atomic<int> items[BUFFER_SIZE];
+	// 첫 칸에 값을 넣은 채로 만든다. -> 연결하는 CAS 한번으로 push가 끝난다.
+	Node(int value)
+	{
+		for (auto& item : items) item.store(EMPTY, memory_order_relaxed);
+		items[0].store(value, memory_order_relaxed);
+		enqIdx.store(1, memory_order_relaxed);
+	}
+	Node() : Node(EMPTY) { enqIdx.store(0, memory_order_relaxed); }
+	~Node() = default;
+};
+
+class Queue
+{
+	alignas(64) atomic<Node*> head{};
+	alignas(64) atomic<Node*> tail{};
+	HazardPointer<Node, MAX_THREADS, 1> hp{};
+	atomic<size_t> segments{};		// 만든 세그먼트 수
+public:
+	Queue() { head = tail = new Node{}; }
+	~Queue() { init(); delete head.load(); }
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void init()
+	{
+		Node* ptr{ head.load(memory_order_relaxed) };
+		while (ptr)
+		{
+			Node* next{ ptr->next.load(memory_order_relaxed) };
+			delete ptr;
+			ptr = next;
+		}
+		head = tail = new Node{};
+		hp.clear();
+		segments = 0;
+	}
+	size_t getSegments() { return segments; }
+
+	bool CAS(atomic<Node*>& addr, Node* oldNode, Node* newNode)
+	{
+		return addr.compare_exchange_strong(oldNode, newNode, memory_order_release, memory_order_relaxed);
+	}
+	void push(int value)
+	{
+		while (true)
+		{
+			Node* last{ hp.protect(THREAD_ID, 0, tail) };
+			int idx{ last->enqIdx.fetch_add(1, memory_order_relaxed) };
+
+			if (idx < BUFFER_SIZE)
+			{
+				int expected{ EMPTY };
+				if (last->items[idx].compare_exchange_strong(expected, value, memory_order_release, memory_order_relaxed))
+				{
+					hp.release(THREAD_ID);
+					return;
+				}
+				continue;		// pop이 먼저 칸을 가져갔다.
+			}
+
+			// 세그먼트가 가득 찼다.
+			if (last != tail.load(memory_order_acquire)) continue;
+			Node* next{ last->next.load(memory_order_acquire) };
+			if (!next)
+			{
+				Node* node{ new Node{ value } };
+				if (CAS(last->next, nullptr, node))
+				{
+					CAS(tail, last, node);
+					segments.fetch_add(1, memory_order_relaxed);
+					hp.release(THREAD_ID);
+					return;
+				}
+				delete node;		// 아직 아무도 보지 못한 노드
+			}
+			else CAS(tail, last, next);
+		}
+	}
+	int pop()
+	{
+		while (true)
+		{
+			Node* first{ hp.protect(THREAD_ID, 0, head) };
+
+			// 차지할 칸이 남아있지 않다면 fetch_add로 deqIdx를 올리지 않는다.
+			if (first->deqIdx.load(memory_order_relaxed) >= first->enqIdx.load(memory_order_relaxed)
+				&& !first->next.load(memory_order_acquire)) break;
+
+			int idx{ first->deqIdx.fetch_add(1, memory_order_relaxed) };
+			if (idx >= BUFFER_SIZE)
+			{
+				// 다 읽은 세그먼트
+				Node* next{ first->next.load(memory_order_acquire) };
+				if (!next) break;
+				if (CAS(head, first, next))
+				{
+					hp.release(THREAD_ID);
+					hp.retire(THREAD_ID, first);
+				}
+				continue;
+			}
+
+			int value{ first->items[idx].exchange(TAKEN, memory_order_acquire) };
+			if (EMPTY == value) continue;		// push가 아직 쓰지 않은 칸 -> push는 다른 칸을 차지한다.
+			hp.release(THREAD_ID);
+			return value;
+		}
+		hp.release(THREAD_ID);
+		return -1;
+	}
+	void printElement(int count)
+	{
+		for (Node* cur = head.load(); cur && count; cur = cur->next.load())
+		{
+			int end{ min(cur->enqIdx.load(), BUFFER_SIZE) };
+			for (int i = min(cur->deqIdx.load(), end); i < end && count; ++i)
+			{
+				int value{ cur->items[i].load() };
+				if (EMPTY == value || TAKEN == value) continue;
+				cout << value << ", ";
+				--count;
+			}
+		}
+		cout << endl;
+	}
+};
+
+constexpr int NUM_TEST{ 10000000 };
+
+Queue que;
+
+void ThreadFunc(int numOfThread, int threadID)
+{
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		switch (rand() % 2)
+		{
+		case 0: que.push(i); break;
+		case 1: que.pop(); break;
+		default: cout << "Error\n"; exit(-1);
+		}
+	}
+}
+
+int main()
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	stressQueue(MAX_THREADS, STRESS_OPS, true,
+		[](int threadID, int value) { THREAD_ID = threadID; que.push(value); },
+		[](int threadID) { THREAD_ID = threadID; return que.pop(); });
+
+	for (int i = 1; i <= MAX_THREADS; i *= 2)
+	{
+		threads.clear();
+		que.init();
+
+		size_t startMemory{ getResidentMemory() };
+		sampler.start();
+		auto start{ high_resolution_clock::now() };
+
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
+		for (auto& thread : threads) thread.join();
+		sampler.stop();
+
+		que.printElement(20);
+
+		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		size_t endMemory{ getResidentMemory() };
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << duration_cast<nanoseconds>(duration).count() / NUM_TEST << " ns/op, ";
+		cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB), ";
+		cout << "Segments = " << que.getSegments() << "\n";
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+	}
+}
@@ -0,0 +1,357 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include "memory_usage.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	비멈춤동기화(work stealing)
+
+	1. Chase-Lev 덱: 주인 스레드는 bottom 쪽에서 push, pop하고, 다른 스레드는 top 쪽에서 steal한다.
+	   -> 주인의 push, pop은 CAS 없이 bottom을 load, store한다. 마지막 하나를 두고 경쟁할 때만 top을 CAS한다.
+	2. pop은 bottom을 먼저 줄이고 full fence 후에 top을 읽는다. steal은 top을 읽고 full fence 후에 bottom을 읽는다.
+	   -> 주인과 도둑이 같은 칸을 동시에 가져가지 않는다. (StoreLoad)
+	3. 배열이 가득 차면 주인이 두배 크기의 배열로 복사하고 교체한다. 이전 배열은 도둑이 읽고 있을 수 있으므로 덱이 사라질 때 해제한다.
+	4. 스레드 풀: 워커마다 덱을 하나씩 가진다. 워커가 만든 작업은 자기 덱에 넣고 꺼낸다. (LIFO -> 캐시에 남아있는 작업부터)
+	5. 자기 덱이 비면 무작위로 고른 다른 워커의 덱에서 훔친다. 그래도 없으면 잠시 양보하다가 condition_variable에서 잠든다. (parking)
+	6. 작업 그룹(TaskGroup)은 남은 작업 수를 센다. 워커는 wait하는 동안 다른 작업을 실행한다. -> 재귀적인 fork-join
+
+	※ 워커가 아닌 스레드가 만든 작업은 mutex로 보호되는 주입 큐(injection queue)에 넣는다.
+	※ 잠들기 전에 sleepers를 올리고 pending을 확인하고, 작업을 넣는 쪽은 pending을 올리고 sleepers를 확인한다. -> 깨우기를 놓치지 않는다.
+	※ 이전 파일들처럼 라운드마다 스레드를 새로 만드는 방식(Thread per Job)과 작업당 비용을 비교한다.
+*/
+
+constexpr int MAX_THREADS{ 8 };
+constexpr int SPIN_BEFORE_PARK{ 64 };		// 잠들기 전에 작업을 찾아보는 횟수
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+thread_local bool IS_WORKER{};		// 스레드 풀의 워커라면 true
+
+template <class T>
+class Deque
+{
+private:
+	class Array
+	{
+	private:
+		int64_t size{};
+		unique_ptr<atomic<T>[]> items{};
+	public:
+		explicit Array(int64_t newSize) : size{ newSize }, items{ new atomic<T>[newSize] } {}
+		int64_t getSize() { return size; }
+		T get(int64_t index) { return items[index & (size - 1)].load(memory_order_relaxed); }
+		void put(int64_t index, T item) { items[index & (size - 1)].store(item, memory_order_relaxed); }
+		// [top, bottom) 구간을 두배 크기의 배열로 복사한다.
+		Array* grow(int64_t top, int64_t bottom)
+		{
+			Array* array{ new Array{ size * 2 } };
+			for (int64_t i = top; i < bottom; ++i) array->put(i, get(i));
+			return array;
+		}
+	};
+private:
+	alignas(64) atomic<int64_t> top{};			// 도둑이 CAS로 올린다.
+	alignas(64) atomic<int64_t> bottom{};		// 주인만 쓴다.
+	atomic<Array*> array{};
+	vector<unique_ptr<Array>> arrays{};			// 지금까지 만든 배열. 주인만 쓴다.
+public:
+	Deque() : Deque{ 64 } {}
+	explicit Deque(int64_t capacity)
+	{
+		int64_t size{ 2 };
+		while (size < capacity) size *= 2;
+		arrays.emplace_back(new Array{ size });
+		array.store(arrays.back().get(), memory_order_relaxed);
+	}
+
+	// 주인 스레드만 호출해야 한다.
+	void push(T item)
+	{
+		int64_t b{ bottom.load(memory_order_relaxed) };
+		int64_t t{ top.load(memory_order_acquire) };
+		Array* a{ array.load(memory_order_relaxed) };
+		if (b - t > a->getSize() - 1)
+		{
+			a = a->grow(t, b);
+			arrays.emplace_back(a);
+			array.store(a, memory_order_release);
+		}
+		a->put(b, item);
+		atomic_thread_fence(memory_order_release);		// 칸에 쓴 값이 bottom보다 먼저 보여야 한다.
+		bottom.store(b + 1, memory_order_relaxed);
+	}
+	// 주인 스레드만 호출해야 한다. 비어있으면 false
+	bool pop(T* item)
+	{
+		int64_t b{ bottom.load(memory_order_relaxed) - 1 };
+		Array* a{ array.load(memory_order_relaxed) };
+		bottom.store(b, memory_order_relaxed);
+		atomic_thread_fence(memory_order_seq_cst);		// bottom을 줄인 것이 top을 읽기 전에 보여야 한다.
+		int64_t t{ top.load(memory_order_relaxed) };
+
+		bool result{ true };
+		if (t <= b)
+		{
+			*item = a->get(b);
+			if (t == b)		// 마지막 하나 -> 도둑과 top을 두고 경쟁한다.
+			{
+				if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) result = false;
+				bottom.store(b + 1, memory_order_relaxed);
+			}
+		}
+		else
+		{
+			result = false;
+			bottom.store(b + 1, memory_order_relaxed);
+		}
+		return result;
+	}
+	// 아무 스레드나 호출할 수 있다. 비어있거나 경쟁에서 졌으면 false
+	bool steal(T* item)
+	{
+		int64_t t{ top.load(memory_order_acquire) };
+		atomic_thread_fence(memory_order_seq_cst);
+		int64_t b{ bottom.load(memory_order_acquire) };
+		if (t >= b) return false;
+
+		Array* a{ array.load(memory_order_acquire) };
+		T result{ a->get(t) };
+		if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) return false;
+		*item = result;
+		return true;
+	}
+	int64_t size() { return bottom.load(memory_order_relaxed) - top.load(memory_order_relaxed); }
+};
+
+// 남은 작업 수
+struct TaskGroup
+{
+	atomic<int> count{};
+};
+
+class ThreadPool
+{
+private:
+	struct Task
+	{
+		function<void()> func{};
+		TaskGroup* group{};
+	};
+private:
+	int numWorkers{};
+	vector<thread> workers{};
+	Deque<Task*> deques[MAX_THREADS]{};
+	mutex injectMtx{};
+	queue<Task*> injected{};
+
+	alignas(64) atomic<int> pending{};		// 넣었지만 아직 꺼내지 않은 작업 수
+	alignas(64) atomic<int> sleepers{};
+	atomic<bool> stop{};
+	mutex parkMtx{};
+	condition_variable parkCv{};
+
+	atomic<size_t> steals{}, parks{};
+public:
+	explicit ThreadPool(int numThreads)
+	{
+		numWorkers = numThreads;
+		for (int i = 0; i < numWorkers; ++i) workers.emplace_back(&ThreadPool::worker, this, i);
+	}
+	~ThreadPool()
+	{
+		{
+			lock_guard<mutex> lock{ parkMtx };
+			stop = true;
+		}
+		parkCv.notify_all();
+		for (auto& worker : workers) worker.join();
+	}
+
+	void spawn(TaskGroup& group, function<void()> func)
+	{
+		Task* task{ new Task{ move(func), &group } };
+		group.count.fetch_add(1, memory_order_relaxed);
+		pending.fetch_add(1, memory_order_seq_cst);
+
+		if (IS_WORKER) deques[THREAD_ID].push(task);
+		else
+		{
+			lock_guard<mutex> lock{ injectMtx };
+			injected.push(task);
+		}
+
+		if (sleepers.load(memory_order_seq_cst))
+		{
+			lock_guard<mutex> lock{ parkMtx };
+			parkCv.notify_one();
+		}
+	}
+	// 워커는 기다리는 동안 다른 작업을 실행한다. 워커가 아닌 스레드는 양보하며 기다린다.
+	void wait(TaskGroup& group)
+	{
+		while (group.count.load(memory_order_acquire))
+		{
+			Task* task{ IS_WORKER ? findTask() : nullptr };
+			if (task) run(task);
+			else this_thread::yield();
+		}
+	}
+	size_t getSteals() { return steals; }
+	size_t getParks() { return parks; }
+private:
+	void worker(int threadID)
+	{
+		THREAD_ID = threadID;
+		IS_WORKER = true;
+
+		int idle{};
+		while (!stop.load(memory_order_relaxed))
+		{
+			Task* task{ findTask() };
+			if (task) { run(task); idle = 0; continue; }
+			if (++idle < SPIN_BEFORE_PARK) { this_thread::yield(); continue; }
+
+			idle = 0;
+			unique_lock<mutex> lock{ parkMtx };
+			sleepers.fetch_add(1, memory_order_seq_cst);
+			parks.fetch_add(1, memory_order_relaxed);
+			parkCv.wait(lock, [this] { return pending.load(memory_order_seq_cst) > 0 || stop; });
+			sleepers.fetch_sub(1, memory_order_relaxed);
+		}
+	}
+	Task* findTask()
+	{
+		Task* task{};
+		if (deques[THREAD_ID].pop(&task)) return task;
+
+		// 무작위로 고른 워커부터 한바퀴 훔쳐본다.
+		thread_local XorShift rng{ static_cast<unsigned>(THREAD_ID + 1) };
+		int start{ static_cast<int>(rng.next() % numWorkers) };
+		for (int i = 0; i < numWorkers; ++i)
+		{
+			int victim{ (start + i) % numWorkers };
+			if (victim == THREAD_ID) continue;
+			if (deques[victim].steal(&task))
+			{
+				steals.fetch_add(1, memory_order_relaxed);
+				return task;
+			}
+		}
+
+		lock_guard<mutex> lock{ injectMtx };
+		if (injected.empty()) return nullptr;
+		task = injected.front();
+		injected.pop();
+		return task;
+	}
+	void run(Task* task)
+	{
+		pending.fetch_sub(1, memory_order_relaxed);
+		task->func();
+		task->group->count.fetch_sub(1, memory_order_release);
+		delete task;
+	}
+};
+
+constexpr int NUM_TEST{ 1 << 24 };		// 더할 원소 수
+constexpr int GRAIN{ 16 };				// 작업 하나가 더하는 원소 수
+constexpr int NUM_THREAD_JOBS{ 1 << 12 };	// Thread per Job으로 실행할 작업 수
+
+vector<int> inputs(NUM_TEST);
+
+long long sumLeaf(int begin, int end)
+{
+	long long sum{};
+	for (int i = begin; i < end; ++i) sum += inputs[i];
+	return sum;
+}
+
+// 구간을 반으로 나눠 절반은 작업으로 넘기고 절반은 직접 더한다.
+void sumRange(ThreadPool& pool, int begin, int end, long long* result)
+{
+	if (end - begin <= GRAIN) { *result = sumLeaf(begin, end); return; }
+
+	int mid{ begin + (end - begin) / 2 };
+	long long left{}, right{};
+	TaskGroup group{};
+	pool.spawn(group, [&] { sumRange(pool, begin, mid, &left); });
+	sumRange(pool, mid, end, &right);
+	pool.wait(group);
+	*result = left + right;
+}
+
+int main()
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	{
+		Deque<int> deque{ 16 };		// 작게 시작해서 grow도 검사한다.
+		stressDeque(MAX_THREADS, STRESS_OPS,
+			[&](int threadID, int value) { THREAD_ID = threadID; deque.push(value); },
+			[&](int threadID) { THREAD_ID = threadID; int value{}; return deque.pop(&value) ? value : -1; },
+			[&](int threadID) { THREAD_ID = threadID; int value{}; return deque.steal(&value) ? value : -1; });
+	}
+
+	long long expected{};
+	for (int i = 0; i < NUM_TEST; ++i) expected += inputs[i] = i % 7;
+
+	cout << "[Work Stealing]\n";
+	for (int i = 1; i <= MAX_THREADS; i *= 2)
+	{
+		ThreadPool pool{ i };
+		long long result{};
+
+		size_t startMemory{ getResidentMemory() };
+		sampler.start();
+		auto start{ high_resolution_clock::now() };
+
+		TaskGroup group{};
+		pool.spawn(group, [&] { sumRange(pool, 0, NUM_TEST, &result); });
+		pool.wait(group);
+		sampler.stop();
+
+		if (result != expected) { cout << "Error\n"; exit(-1); }
+
+		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		size_t endMemory{ getResidentMemory() };
+		size_t numTasks{ NUM_TEST / GRAIN };
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << duration_cast<nanoseconds>(duration).count() / numTasks << " ns/task, ";
+		cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB), ";
+		cout << "Steals = " << pool.getSteals() << ", Parks = " << pool.getParks() << "\n";
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(numTasks / seconds / (sampler.getPeak() / MEGABYTE)) << " tasks/sec/MB\n";
+	}
+
+	// 같은 크기의 작업을 작업마다 스레드를 만들어 실행한다. (i개씩 동시에)
+	cout << "[Thread per Job]\n";
+	for (int i = 1; i <= MAX_THREADS; i *= 2)
+	{
+		vector<long long> results(i);
+
+		auto start{ high_resolution_clock::now() };
+		for (int job = 0; job < NUM_THREAD_JOBS; job += i)
+		{
+			threads.clear();
+			for (int j = 0; j < i; ++j)
+				threads.emplace_back([&, j, job] { results[j] += sumLeaf((job + j) * GRAIN, (job + j + 1) * GRAIN); });
+			for (auto& thread : threads) thread.join();
+		}
+		auto duration{ high_resolution_clock::now() - start };
+
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << duration_cast<nanoseconds>(duration).count() / NUM_THREAD_JOBS << " ns/task\n";
+	}
+}
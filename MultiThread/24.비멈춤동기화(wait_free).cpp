@@ -0,0 +1,426 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include "ebr.h"
+#include "memory_usage.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	비멈춤동기화(wait free) - Kogan-Petrank 큐
+
+	1. fast path: 8.비멈춤동기화.cpp와 같은 CAS 루프를 MAX_FAILURES번까지만 시도한다.
+	2. slow path: 실패하면 연산(OpDesc: phase, pending, enqueue, node)을 state[스레드 번호]에 알리고,
+	   자신보다 phase가 작거나 같은 연산이 끝날 때까지 다른 스레드와 함께 진행한다. (helping)
+	3. push를 돕는 스레드는 알린 노드를 tail 뒤에 연결하고, state를 완료(pending = false)로 바꾼 뒤 tail을 옮긴다.
+	4. pop을 돕는 스레드는 head 노드를 state에 기록하고, 노드의 deqTid를 CAS로 차지한 뒤 state를 완료로 바꾸고 head를 옮긴다.
+	   -> 누가 어느 단계에서 멈추더라도 다른 스레드가 같은 순서로 이어서 진행할 수 있다.
+	5. 스레드는 HELPING_DELAY번의 연산마다 다른 스레드 하나의 state를 확인하고 진행중이면 돕는다.
+	   -> slow path에 들어간 연산은 유한한 단계 안에 모든 스레드의 도움을 받는다. (wait-free)
+	6. 노드와 OpDesc는 EBR로 해제한다. state는 CAS로 새 OpDesc로 바꾸고, 바뀐 이전 OpDesc를 retire한다.
+
+	※ fast path로 차지한 노드의 deqTid는 FAST로 표시한다. -> 돕는 스레드는 head만 옮기고 state는 건드리지 않는다.
+	※ fast path로 넣은 노드의 enqTid는 -1이다. -> 돕는 스레드는 tail만 옮긴다.
+	※ 메모리 해제(EBR)는 wait-free가 아니다. 멈춘 스레드가 있으면 노드가 해제되지 않을 뿐 연산은 진행된다.
+	※ MAX_FAILURES를 INT_MAX로 하면 slow path가 없는 lock-free 큐(8.비멈춤동기화.cpp와 같은 알고리즘)가 된다. -> 지연시간 꼬리 비교
+*/
+
+constexpr int MAX_THREADS{ 8 };
+constexpr int MAX_FAILURES{ 8 };		// fast path 시도 횟수
+constexpr int HELPING_DELAY{ 16 };		// 이만큼 연산할 때마다 다른 스레드 하나를 확인해서 돕는다.
+constexpr int FAST{ MAX_THREADS };		// fast path로 pop한 노드의 deqTid
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+class Node
+{
+public:
+	int key{};
+	atomic<Node*> next{};
+	int enqTid{ -1 };
+	atomic<int> deqTid{ -1 };
+	Node() = default;
+	Node(int newKey, int tid) { key = newKey; enqTid = tid; }
+	~Node() = default;
+};
+
+class OpDesc
+{
+public:
+	long long phase{};
+	bool pending{};
+	bool enqueue{};
+	Node* node{};
+	OpDesc() = default;
+	OpDesc(long long newPhase, bool isPending, bool isEnqueue, Node* newNode) { phase = newPhase; pending = isPending; enqueue = isEnqueue; node = newNode; }
+	~OpDesc() = default;
+};
+
+class Queue
+{
+private:
+	struct alignas(64) Helper
+	{
+		int counter{};
+		int nextTid{};
+	};
+private:
+	alignas(64) atomic<Node*> head{};
+	alignas(64) atomic<Node*> tail{};
+	alignas(64) atomic<OpDesc*> state[MAX_THREADS]{};
+	Helper helpers[MAX_THREADS]{};
+	EBR<Node, MAX_THREADS> nodeEbr{};
+	EBR<OpDesc, MAX_THREADS> descEbr{};
+	int maxFailures{ MAX_FAILURES };
+	atomic<size_t> slowPaths{};
+public:
+	Queue()
+	{
+		head = tail = new Node{};
+		for (auto& desc : state) desc = new OpDesc{ -1, false, true, nullptr };
+	}
+	~Queue()
+	{
+		init();
+		delete head.load();
+		for (auto& desc : state) delete desc.load();
+	}
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void init()
+	{
+		Node* ptr{ head.load(memory_order_relaxed) };
+		while (ptr != tail.load(memory_order_relaxed))
+		{
+			Node* next{ ptr->next.load(memory_order_relaxed) };
+			delete ptr;
+			ptr = next;
+		}
+		head.store(ptr, memory_order_relaxed);
+		nodeEbr.clear();
+		descEbr.clear();
+		slowPaths = 0;
+	}
+	// fast path 시도 횟수. INT_MAX면 lock-free, 0이면 모든 연산이 slow path
+	void setMaxFailures(int failures) { maxFailures = failures; }
+	size_t getSlowPaths() { return slowPaths; }
+
+	bool CAS(atomic<Node*>& addr, Node* oldNode, Node* newNode)
+	{
+		return addr.compare_exchange_strong(oldNode, newNode, memory_order_release, memory_order_relaxed);
+	}
+	void push(int key)
+	{
+		nodeEbr.start(THREAD_ID);
+		descEbr.start(THREAD_ID);
+		helpIfNeeded();
+
+		Node* node{ new Node{ key, -1 } };
+		for (int i = 0; i < maxFailures; ++i)
+		{
+			Node* last{ tail.load(memory_order_acquire) };
+			Node* next{ last->next.load(memory_order_acquire) };
+
+			if (last != tail.load(memory_order_acquire)) continue;
+			if (!next)
+			{
+				if (CAS(last->next, nullptr, node))
+				{
+					CAS(tail, last, node);
+					descEbr.end(THREAD_ID);
+					nodeEbr.end(THREAD_ID);
+					return;
+				}
+			}
+			else helpFinishEnq();
+		}
+
+		slowPaths.fetch_add(1, memory_order_relaxed);
+		node->enqTid = THREAD_ID;
+		long long phase{ maxPhase() + 1 };
+		announce(new OpDesc{ phase, true, true, node });
+		helpEnq(THREAD_ID, phase);
+		helpFinishEnq();		// 반환하기 전에 tail이 노드를 지나가게 한다.
+
+		descEbr.end(THREAD_ID);
+		nodeEbr.end(THREAD_ID);
+	}
+	int pop()
+	{
+		nodeEbr.start(THREAD_ID);
+		descEbr.start(THREAD_ID);
+		helpIfNeeded();
+
+		int result{ -1 };
+		bool done{};
+		for (int i = 0; i < maxFailures && !done; ++i)
+		{
+			Node* first{ head.load(memory_order_acquire) };
+			Node* last{ tail.load(memory_order_acquire) };
+			Node* next{ first->next.load(memory_order_acquire) };
+
+			if (first != head.load(memory_order_acquire)) continue;
+			if (first == last)
+			{
+				if (!next) done = true;		// 비어있음
+				else helpFinishEnq();
+				continue;
+			}
+
+			int expected{ -1 };
+			if (first->deqTid.compare_exchange_strong(expected, FAST, memory_order_acq_rel, memory_order_relaxed))
+			{
+				result = next->key;		// first는 보초노드이므로 next를 반환
+				if (CAS(head, first, next)) nodeEbr.retire(THREAD_ID, first);
+				done = true;
+			}
+			else helpFinishDeq();		// 다른 스레드가 차지한 노드 -> head를 옮겨주고 다시 시도
+		}
+
+		if (!done)
+		{
+			slowPaths.fetch_add(1, memory_order_relaxed);
+			long long phase{ maxPhase() + 1 };
+			announce(new OpDesc{ phase, true, false, nullptr });
+			helpDeq(THREAD_ID, phase);
+			helpFinishDeq();		// 반환하기 전에 head가 노드를 지나가게 한다.
+
+			Node* node{ state[THREAD_ID].load(memory_order_acquire)->node };
+			if (node) result = node->next.load(memory_order_acquire)->key;
+		}
+
+		descEbr.end(THREAD_ID);
+		nodeEbr.end(THREAD_ID);
+		return result;
+	}
+	void printElement(int count)
+	{
+		Node* cur{ head.load()->next };
+		while (cur)
+		{
+			cout << cur->key << ", ";
+			cur = cur->next.load();
+			if (!(--count)) break;
+		}
+		cout << endl;
+	}
+private:
+	long long maxPhase()
+	{
+		long long result{ -1 };
+		for (auto& desc : state) result = max(result, desc.load(memory_order_acquire)->phase);
+		return result;
+	}
+	static bool isPending(OpDesc* desc, long long phase) { return desc->pending && desc->phase <= phase; }
+	bool isStillPending(int tid, long long phase) { return isPending(state[tid].load(memory_order_acquire), phase); }
+	// 자기 state는 자기만 새 연산으로 바꾼다. 이전 연산은 이미 완료되었으므로 돕는 스레드의 CAS는 실패한다.
+	void announce(OpDesc* desc)
+	{
+		OpDesc* old{ state[THREAD_ID].exchange(desc, memory_order_acq_rel) };
+		descEbr.retire(THREAD_ID, old);
+	}
+	bool replaceState(int tid, OpDesc* oldDesc, OpDesc* newDesc)
+	{
+		if (state[tid].compare_exchange_strong(oldDesc, newDesc, memory_order_acq_rel, memory_order_acquire))
+		{
+			descEbr.retire(THREAD_ID, oldDesc);
+			return true;
+		}
+		delete newDesc;		// 아무도 보지 못한 OpDesc
+		return false;
+	}
+	void helpIfNeeded()
+	{
+		Helper& helper{ helpers[THREAD_ID] };
+		if (++helper.counter < HELPING_DELAY) return;
+		helper.counter = 0;
+
+		int tid{ helper.nextTid };
+		helper.nextTid = (tid + 1) % MAX_THREADS;
+		OpDesc* desc{ state[tid].load(memory_order_acquire) };
+		if (!desc->pending) return;
+		if (desc->enqueue) helpEnq(tid, desc->phase);
+		else helpDeq(tid, desc->phase);
+	}
+	void helpEnq(int tid, long long phase)
+	{
+		while (isStillPending(tid, phase))
+		{
+			Node* last{ tail.load(memory_order_acquire) };
+			Node* next{ last->next.load(memory_order_acquire) };
+
+			if (last != tail.load(memory_order_acquire)) continue;
+			if (next) { helpFinishEnq(); continue; }
+
+			// tail을 읽은 뒤에 다시 확인한다. -> 이미 연결되어 tail이 된 노드를 또 연결하지 않는다.
+			OpDesc* desc{ state[tid].load(memory_order_acquire) };
+			if (!isPending(desc, phase)) return;
+			if (CAS(last->next, nullptr, desc->node))
+			{
+				helpFinishEnq();
+				return;
+			}
+		}
+	}
+	void helpFinishEnq()
+	{
+		Node* last{ tail.load(memory_order_acquire) };
+		Node* next{ last->next.load(memory_order_acquire) };
+		if (!next) return;
+
+		int tid{ next->enqTid };
+		if (-1 != tid)
+		{
+			OpDesc* desc{ state[tid].load(memory_order_acquire) };
+			if (last == tail.load(memory_order_acquire) && desc->pending && desc->node == next)
+				replaceState(tid, desc, new OpDesc{ desc->phase, false, true, next });
+		}
+		CAS(tail, last, next);		// state를 완료로 바꾼 뒤에 tail을 옮긴다.
+	}
+	void helpDeq(int tid, long long phase)
+	{
+		while (isStillPending(tid, phase))
+		{
+			Node* first{ head.load(memory_order_acquire) };
+			Node* last{ tail.load(memory_order_acquire) };
+			Node* next{ first->next.load(memory_order_acquire) };
+
+			if (first != head.load(memory_order_acquire)) continue;
+			if (first == last)
+			{
+				if (next) { helpFinishEnq(); continue; }
+
+				// 비어있음 -> 노드 없이 완료
+				OpDesc* desc{ state[tid].load(memory_order_acquire) };
+				if (last == tail.load(memory_order_acquire) && isPending(desc, phase))
+					replaceState(tid, desc, new OpDesc{ desc->phase, false, false, nullptr });
+				continue;
+			}
+
+			OpDesc* desc{ state[tid].load(memory_order_acquire) };
+			if (!isPending(desc, phase)) return;
+			if (first == head.load(memory_order_acquire) && desc->node != first)
+				if (!replaceState(tid, desc, new OpDesc{ desc->phase, true, false, first })) continue;
+
+			int expected{ -1 };
+			first->deqTid.compare_exchange_strong(expected, tid, memory_order_acq_rel, memory_order_relaxed);
+			helpFinishDeq();
+		}
+	}
+	void helpFinishDeq()
+	{
+		Node* first{ head.load(memory_order_acquire) };
+		Node* next{ first->next.load(memory_order_acquire) };
+		int tid{ first->deqTid.load(memory_order_acquire) };
+		if (-1 == tid || !next) return;
+
+		if (FAST != tid)
+		{
+			OpDesc* desc{ state[tid].load(memory_order_acquire) };
+			if (first == head.load(memory_order_acquire) && desc->pending)
+				replaceState(tid, desc, new OpDesc{ desc->phase, false, false, desc->node });
+		}
+		if (CAS(head, first, next)) nodeEbr.retire(THREAD_ID, first);		// state를 완료로 바꾼 뒤에 head를 옮긴다.
+	}
+};
+
+constexpr int NUM_TEST{ 4000000 };
+
+Queue que;
+vector<uint32_t> latencies[MAX_THREADS]{};		// 연산마다 걸린 시간 (ns)
+
+void ThreadFunc(int numOfThread, int threadID)
+{
+	XorShift rng{ static_cast<unsigned>(threadID + 1) };
+
+	THREAD_ID = threadID;
+	vector<uint32_t>& samples{ latencies[threadID] };
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		// 연산은 재기 전에 고른다. -> 난수 생성은 지연시간에 넣지 않는다.
+		unsigned op{ rng.next() % 2 };
+		auto start{ high_resolution_clock::now() };
+		switch (op)
+		{
+		case 0: que.push(i); break;
+		case 1: que.pop(); break;
+		default: cout << "Error\n"; exit(-1);
+		}
+		long long elapsed{ duration_cast<nanoseconds>(high_resolution_clock::now() - start).count() };
+		samples.push_back(static_cast<uint32_t>(min<long long>(elapsed, UINT32_MAX)));
+	}
+}
+
+// 모든 스레드의 연산 지연시간 중 상위 percent% 위치의 값
+uint32_t percentile(vector<uint32_t>& samples, double percent)
+{
+	size_t index{ min(samples.size() - 1, static_cast<size_t>(samples.size() * percent / 100.0)) };
+	nth_element(samples.begin(), samples.begin() + index, samples.end());
+	return samples[index];
+}
+
+int main()
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	// 모든 연산을 slow path로 보내서 helping도 검사한다.
+	for (int failures : { MAX_FAILURES, 0 })
+	{
+		que.setMaxFailures(failures);
+		stressQueue(MAX_THREADS, STRESS_OPS, true,
+			[](int threadID, int value) { THREAD_ID = threadID; que.push(value); },
+			[](int threadID) { THREAD_ID = threadID; return que.pop(); });
+	}
+
+	// fast path만 쓰는 lock-free 버전과 wait-free 버전의 지연시간 꼬리를 비교
+	for (int failures : { INT_MAX, MAX_FAILURES })
+	{
+		que.setMaxFailures(failures);
+		cout << (INT_MAX == failures ? "[Lock Free]\n" : "[Wait Free]\n");
+
+		for (int i = 1; i <= MAX_THREADS; i *= 2)
+		{
+			threads.clear();
+			que.init();
+			for (auto& samples : latencies)
+			{
+				samples.clear();
+				samples.reserve(NUM_TEST / i);
+			}
+
+			size_t startMemory{ getResidentMemory() };
+			sampler.start();
+			auto start{ high_resolution_clock::now() };
+
+			for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
+			for (auto& thread : threads) thread.join();
+			sampler.stop();
+
+			que.printElement(20);
+
+			auto duration{ high_resolution_clock::now() - start };
+			double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+			size_t endMemory{ getResidentMemory() };
+			cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+			cout << duration_cast<nanoseconds>(duration).count() / NUM_TEST << " ns/op, ";
+			cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB), ";
+			cout << "Slow Path = " << que.getSlowPaths() << "\n";
+
+			vector<uint32_t> samples{};
+			for (auto& threadSamples : latencies) samples.insert(samples.end(), threadSamples.begin(), threadSamples.end());
+			cout << "\tLatency: p50 = " << percentile(samples, 50) << " ns, p99 = " << percentile(samples, 99) << " ns, ";
+			cout << "p99.9 = " << percentile(samples, 99.9) << " ns, p99.99 = " << percentile(samples, 99.99) << " ns, ";
+			cout << "max = " << *max_element(samples.begin(), samples.end()) << " ns\n";
+			cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+			cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+		}
+	}
+}
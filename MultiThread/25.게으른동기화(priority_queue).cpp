@@ -0,0 +1,373 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include "ebr.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	게으른동기화(priority queue)
+
+	1. 14.게으른동기화.cpp의 스킵리스트를 우선순위 큐로 사용한다. insert는 add와 같다. (find 재사용)
+	2. removeMin은 0레벨을 head부터 순회하면서 차지되지 않은 첫 노드의 isClaimed를 CAS로 false -> true로 바꾼다. (논리적 삭제)
+	   -> 락 없이 CAS 한번으로 최솟값을 가져간다. 실패하면 다음 노드를 시도한다.
+	3. 차지된 노드는 바로 떼어내지 않는다. removeMin이 건너뛴 차지된 노드가 BOUND개 이상이면 한 스레드가 앞쪽의 차지된 노드를 한꺼번에 떼어낸다.
+	   -> 앞쪽에 이어진 차지된 노드들과 head를 잠그고 모두 마킹한 뒤, 레벨마다 head의 next를 그 뒤의 노드로 한번씩 바꾼다. (Linden-Jonsson)
+	   -> head 근처의 락 경합과 연결 변경이 removeMin마다가 아니라 BOUND번에 한번으로 줄어든다.
+	4. 떼어내는 스레드는 하나만 있으면 되므로 try_lock으로 정한다. 실패한 스레드는 기다리지 않고 돌아간다.
+	5. 떼어낸 노드는 EBR로 retire한다.
+
+	※ 같은 키는 한번만 들어간다. (집합) 차지되었지만 아직 떼어내지 않은 노드와 같은 키를 insert하면
+	   그 노드를 14.게으른동기화.cpp의 remove와 같은 방법으로 먼저 떼어낸다.
+	※ 연결이 끝나지 않은 노드(isLinkFinished == false)는 건너뛴다. -> insert는 isLinkFinished를 쓸 때 완료된다.
+	※ BOUND = 1이면 removeMin마다 떼어낸다. (비교용)
+*/
+
+constexpr int MAX_LEVEL{ 8 };
+constexpr int MAX_THREADS{ 8 };
+constexpr int BOUND{ 32 };		// 앞쪽에 차지된 노드가 이만큼 쌓이면 한꺼번에 떼어낸다.
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+class Node
+{
+private:
+	recursive_mutex mtx{};
+public:
+	int key{};
+	int topLevel{ MAX_LEVEL };
+	atomic<Node*> next[MAX_LEVEL + 1]{};
+	atomic<bool> isRemoved{}, isLinkFinished{};
+	atomic<bool> isClaimed{};		// removeMin이 가져간 노드
+public:
+	Node() = default;
+	Node(int value, int top)
+	{
+		topLevel = top;
+		key = value;
+	}
+	~Node() = default;
+
+	void lock() { mtx.lock(); }
+	void unlock() { mtx.unlock(); }
+};
+
+NodeStats<MAX_THREADS> stats{};
+
+// EBR이 노드를 delete할 때 해제 수를 센다.
+struct NodeDeleter
+{
+	void operator()(Node* node) const
+	{
+		delete node;
+		stats.onFree(THREAD_ID);
+	}
+};
+
+class PriorityQueue
+{
+private:
+	struct alignas(64) Prefix
+	{
+		vector<Node*> nodes{};
+	};
+private:
+	Node head{}, tail{};
+	EBR<Node, MAX_THREADS, NodeDeleter> ebr{};
+	mutex cleanupMtx{};
+	Prefix prefixes[MAX_THREADS]{};		// cleanup이 모은 노드. 스레드마다 재사용한다.
+	int bound{ BOUND };
+public:
+	PriorityQueue()
+	{
+		head.key = 0x80000000;
+		tail.key = 0x7FFFFFFF;
+		for (auto& i : head.next) i.store(&tail, memory_order_relaxed);
+		head.isLinkFinished.store(true, memory_order_relaxed);
+		tail.isLinkFinished.store(true, memory_order_relaxed);
+	};
+	~PriorityQueue()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		Node* node{ head.next[0].load(memory_order_relaxed) };
+		while (&tail != node)
+		{
+			Node* target{ node };
+			node = node->next[0].load(memory_order_relaxed);
+			delete target;
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
+		}
+		for (auto& i : head.next) i.store(&tail, memory_order_relaxed);
+		ebr.clear();
+	}
+	void setBound(int newBound) { bound = newBound; }
+
+	int find(int value, Node* pred[], Node* curr[])
+	{
+		int foundLevel{ -1 };
+
+		pred[MAX_LEVEL] = &head;
+		for (int curLevel = MAX_LEVEL; curLevel >= 0; --curLevel)
+		{
+			if (curLevel != MAX_LEVEL) pred[curLevel] = pred[curLevel + 1];
+			curr[curLevel] = pred[curLevel]->next[curLevel].load(memory_order_acquire);
+
+			while (curr[curLevel]->key < value)
+			{
+				pred[curLevel] = curr[curLevel];
+				curr[curLevel] = curr[curLevel]->next[curLevel].load(memory_order_acquire);
+			}
+
+			if (foundLevel == -1 && curr[curLevel]->key == value) foundLevel = curLevel;
+		}
+
+		return foundLevel;
+	}
+	bool insert(int value)
+	{
+		Node* pred[MAX_LEVEL + 1]{};
+		Node* curr[MAX_LEVEL + 1]{};
+
+		ebr.start(THREAD_ID);
+		while (true)
+		{
+			int foundLevel{ find(value, pred, curr) };
+			if (foundLevel != -1)
+			{
+				Node* found{ curr[foundLevel] };
+				if (found->isRemoved.load(memory_order_relaxed)) continue;
+				while (!found->isLinkFinished.load(memory_order_acquire));
+				if (found->isClaimed.load(memory_order_acquire)) { unlink(found); continue; }		// 이미 꺼낸 키
+				ebr.end(THREAD_ID);
+				return false;
+			}
+
+			int curLevel{};
+			bool isValid{ true };
+			for (curLevel = 0; curLevel <= MAX_LEVEL; ++curLevel)
+			{
+				pred[curLevel]->lock();
+				isValid = !pred[curLevel]->isRemoved.load(memory_order_relaxed) && !curr[curLevel]->isRemoved.load(memory_order_relaxed) &&
+					curr[curLevel] == pred[curLevel]->next[curLevel].load(memory_order_relaxed);
+				if (!isValid) break;
+			}
+
+			if (!isValid)
+			{
+				for (int i = 0; i <= curLevel; ++i) pred[i]->unlock();
+				continue;
+			}
+			else
+			{
+				int topLevel{};
+				while (rand() % 2 == 1) if (++topLevel == MAX_LEVEL) break;
+
+				Node* newNode{ new Node{value, topLevel} };
+				stats.onAlloc(THREAD_ID);
+				for (int i = 0; i <= topLevel; ++i) newNode->next[i].store(curr[i], memory_order_relaxed);
+				for (int i = 0; i <= topLevel; ++i) pred[i]->next[i].store(newNode, memory_order_release);
+
+				newNode->isLinkFinished.store(true, memory_order_release);
+				for (int i = 0; i <= MAX_LEVEL; ++i) pred[i]->unlock();
+				ebr.end(THREAD_ID);
+				return true;
+			}
+		}
+	}
+	// 비어있으면 -1
+	int removeMin()
+	{
+		int result{ -1 };
+		int skipped{};		// 건너뛴 차지된 노드 수
+
+		ebr.start(THREAD_ID);
+		for (Node* cur = head.next[0].load(memory_order_acquire); &tail != cur; cur = cur->next[0].load(memory_order_acquire))
+		{
+			if (cur->isClaimed.load(memory_order_relaxed) || cur->isRemoved.load(memory_order_relaxed)) { ++skipped; continue; }
+			if (!cur->isLinkFinished.load(memory_order_acquire)) continue;
+
+			bool expected{};
+			if (cur->isClaimed.compare_exchange_strong(expected, true, memory_order_acq_rel, memory_order_relaxed))
+			{
+				result = cur->key;
+				break;
+			}
+			++skipped;
+		}
+		if (-1 != result) ++skipped;		// 방금 차지한 노드도 떼어낼 대상
+		if (skipped >= bound) cleanup();		// 비어있는 경우도 정리한다. -> 안그러면 빈 큐에서 차지된 노드만 계속 쌓인다.
+		ebr.end(THREAD_ID);
+		return result;
+	}
+	void printElement(int count)
+	{
+		Node* cur{ head.next[0].load() };
+		for (int i = 0; i < count; ++i)
+		{
+			if (&tail == cur)
+				break;
+			if (!cur->isClaimed.load()) cout << cur->key << " ";
+			cur = cur->next[0].load();
+		}
+		cout << endl;
+	}
+private:
+	// 앞쪽에 이어진 차지된 노드들을 한꺼번에 떼어낸다. 다른 스레드가 하고 있으면 돌아간다.
+	void cleanup()
+	{
+		unique_lock<mutex> lock{ cleanupMtx, try_to_lock };
+		if (!lock.owns_lock()) return;
+
+		vector<Node*>& prefix{ prefixes[THREAD_ID].nodes };
+		prefix.clear();
+		for (Node* cur = head.next[0].load(memory_order_acquire); &tail != cur; cur = cur->next[0].load(memory_order_acquire))
+		{
+			if (!cur->isClaimed.load(memory_order_acquire) || cur->isRemoved.load(memory_order_relaxed)) break;
+			prefix.push_back(cur);
+		}
+		if (prefix.empty()) return;
+
+		// add와 같이 키가 큰 노드부터 잠근다. -> 교착상태가 없다.
+		for (auto it = prefix.rbegin(); it != prefix.rend(); ++it) (*it)->lock();
+		head.lock();
+
+		// 잠그기 전에 사이에 들어온 노드가 있거나 다른 스레드가 떼어냈다면, 앞쪽의 이어진 부분만 떼어낸다.
+		size_t count{};
+		for (Node* expected = head.next[0].load(memory_order_relaxed); count < prefix.size(); ++count)
+		{
+			if (prefix[count] != expected || prefix[count]->isRemoved.load(memory_order_relaxed)) break;
+			expected = prefix[count]->next[0].load(memory_order_relaxed);
+		}
+		for (size_t i = 0; i < count; ++i) prefix[i]->isRemoved.store(true, memory_order_relaxed);
+
+		// 레벨마다 head를 떼어낸 노드들 뒤의 첫 노드로 바꾼다. -> 레벨마다 store 한번
+		// 떼어낸 노드들은 0레벨에서 head 바로 뒤에 이어져 있으므로, 다른 레벨에서도 키가 lastKey 이하인 노드는 모두 떼어낸 노드다.
+		int lastKey{ count ? prefix[count - 1]->key : head.key };
+		for (int i = 0; i <= MAX_LEVEL && count; ++i)
+		{
+			Node* next{ head.next[i].load(memory_order_relaxed) };
+			while (next->key <= lastKey) next = next->next[i].load(memory_order_relaxed);
+			head.next[i].store(next, memory_order_release);
+		}
+
+		head.unlock();
+		for (auto it = prefix.rbegin(); it != prefix.rend(); ++it) (*it)->unlock();
+		for (size_t i = 0; i < count; ++i)
+		{
+			stats.onRemove(THREAD_ID);
+			ebr.retire(THREAD_ID, prefix[i]);
+		}
+	}
+	// 차지된 노드 target을 떼어낸다. (14.게으른동기화.cpp의 remove) EBR 구간 안에서 호출해야 한다.
+	void unlink(Node* target)
+	{
+		Node* pred[MAX_LEVEL + 1]{};
+		Node* curr[MAX_LEVEL + 1]{};
+
+		target->lock();
+		if (target->isRemoved.load(memory_order_relaxed)) { target->unlock(); return; }
+		target->isRemoved.store(true, memory_order_relaxed);
+
+		while (true)
+		{
+			find(target->key, pred, curr);
+
+			int curLevel{};
+			bool isValid{ true };
+			for (curLevel = 0; curLevel <= MAX_LEVEL; ++curLevel)
+			{
+				pred[curLevel]->lock();
+				isValid = !pred[curLevel]->isRemoved.load(memory_order_relaxed) && curr[curLevel] == pred[curLevel]->next[curLevel].load(memory_order_relaxed);
+				if (!isValid) break;
+			}
+
+			if (!isValid)
+			{
+				for (int i = 0; i <= curLevel; ++i) pred[i]->unlock();
+				continue;
+			}
+
+			for (int i = target->topLevel; i >= 0; --i) pred[i]->next[i].store(target->next[i].load(memory_order_relaxed), memory_order_release);
+
+			for (int i = 0; i <= MAX_LEVEL; ++i) pred[i]->unlock();
+			target->unlock();
+			stats.onRemove(THREAD_ID);
+			ebr.retire(THREAD_ID, target);
+			return;
+		}
+	}
+};
+
+constexpr int NUM_TEST{ 4000000 };
+constexpr int KEY_RANGE{ 1 << 15 };		// MSVC의 RAND_MAX + 1
+
+PriorityQueue pq;
+
+void ThreadFunc(int numOfThread, int threadID)
+{
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		switch (rand() % 2)
+		{
+		case 0: pq.insert(rand() % KEY_RANGE); break;
+		case 1: pq.removeMin(); break;
+		default: cout << "Error\n"; exit(-1);
+		}
+	}
+}
+
+int main()
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	stressPriorityQueue(MAX_THREADS, STRESS_OPS,
+		[](int threadID, int key) { THREAD_ID = threadID; return pq.insert(key); },
+		[](int threadID) { THREAD_ID = threadID; return pq.removeMin(); });
+
+	// 차지된 노드를 BOUND개씩 모아서 떼어내는 버전과 removeMin마다 떼어내는 버전을 비교
+	for (int bound : { BOUND, 1 })
+	{
+		pq.setBound(bound);
+		cout << (1 == bound ? "[Unlink Each]\n" : "[Batch Unlink]\n");
+
+		for (int i = 1; i <= MAX_THREADS; i *= 2)
+		{
+			threads.clear();
+			pq.clear();
+
+			size_t startMemory{ getResidentMemory() };
+			sampler.start();
+			auto start{ high_resolution_clock::now() };
+
+			for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
+			for (auto& thread : threads) thread.join();
+			sampler.stop();
+
+			pq.printElement(20);
+
+			auto duration{ high_resolution_clock::now() - start };
+			double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+			size_t endMemory{ getResidentMemory() };
+			cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+			cout << "Throughput = " << static_cast<long long>(NUM_TEST / seconds) << " ops/sec, ";
+			cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB)\n";
+			stats.print();
+			cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+			cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+		}
+	}
+}
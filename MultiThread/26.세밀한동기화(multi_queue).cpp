@@ -0,0 +1,297 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <climits>
+#include <algorithm>
+#include "memory_usage.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	세밀한동기화(multi queue)
+
+	1. 순차 힙(Heap)을 C * 스레드 수개 두고, 힙마다 mutex를 하나씩 둔다.
+	2. insert는 무작위로 고른 힙을 try_lock한다. 실패하면 다른 힙을 고른다. -> 잠긴 힙을 기다리지 않는다.
+	3. deleteMin은 무작위로 두 힙을 골라 최솟값(top)이 작은 쪽을 try_lock하고 꺼낸다.
+	   -> 정확한 최솟값이 아니라 최솟값 근처의 값을 꺼낸다. (rank error: 꺼낸 값보다 작은 값의 수)
+	4. 힙마다 최솟값을 atomic으로 복사해두고, 두 힙을 비교할 때는 락 없이 그 값을 읽는다.
+	5. 비교용으로 10.성긴동기화.cpp의 Stack처럼 mutex 하나로 보호하는 힙(LockedHeap)을 같은 부하로 측정한다.
+
+	※ 두 힙이 모두 비어있으면 몇번 더 고르고, 그래도 없으면 모든 힙을 차례로 잠가서 확인한다. -> 비어있을 때만 -1
+	※ rank error는 RANK_SAMPLE번의 deleteMin마다 한번, 모든 힙을 잠그고 꺼낸 값보다 작은 값을 센다.
+	   -> 세는 동안 다른 스레드가 모두 멈추므로, 처리량을 잰 뒤 같은 부하를 시간을 재지 않고 한번 더 돌려서 센다.
+	   -> 꺼낸 뒤 세기 전까지 다른 스레드가 넣은 값도 세므로 LockedHeap도 0이 아닐 수 있다.
+*/
+
+constexpr int MAX_THREADS{ 8 };
+constexpr int C{ 2 };				// 스레드당 힙 수
+constexpr int MAX_HEAPS{ C * MAX_THREADS };
+constexpr int EMPTY_RETRIES{ 4 };	// 고른 두 힙이 비어있을 때 다시 고르는 횟수
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+// 순차 최소 힙
+class Heap
+{
+private:
+	vector<int> keys{};
+public:
+	bool empty() { return keys.empty(); }
+	size_t size() { return keys.size(); }
+	int top() { return keys.front(); }
+	void clear() { keys.clear(); }
+	void push(int key)
+	{
+		keys.push_back(key);
+		push_heap(keys.begin(), keys.end(), greater<int>{});
+	}
+	int pop()
+	{
+		pop_heap(keys.begin(), keys.end(), greater<int>{});
+		int key{ keys.back() };
+		keys.pop_back();
+		return key;
+	}
+	// key보다 작은 값의 수
+	long long countLess(int key) { return count_if(keys.begin(), keys.end(), [key](int k) { return k < key; }); }
+};
+
+class LockedHeap
+{
+	Heap heap{};
+	mutex mtx{};
+public:
+	LockedHeap() = default;
+	~LockedHeap() = default;
+
+	void init(int /*numOfThread*/) { heap.clear(); }
+	bool insert(int key)
+	{
+		mtx.lock();
+		heap.push(key);
+		mtx.unlock();
+		return true;
+	}
+	int deleteMin()
+	{
+		mtx.lock();
+		if (heap.empty()) { mtx.unlock(); return -1; }
+		int key{ heap.pop() };
+		mtx.unlock();
+		return key;
+	}
+	long long rankOf(int key)
+	{
+		mtx.lock();
+		long long rank{ heap.countLess(key) };
+		mtx.unlock();
+		return rank;
+	}
+	size_t size() { return heap.size(); }
+};
+
+class MultiQueue
+{
+private:
+	struct alignas(64) Slot
+	{
+		mutex mtx{};
+		Heap heap{};
+		atomic<int> top{ INT_MAX };		// 힙의 최솟값. 비어있으면 INT_MAX
+	};
+private:
+	Slot slots[MAX_HEAPS]{};
+	int numHeaps{ MAX_HEAPS };		// 사용하는 힙 수 = C * 스레드 수
+public:
+	MultiQueue() = default;
+	~MultiQueue() = default;
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다. 스레드 수에 맞춰 앞쪽 C * numOfThread개의 힙만 사용한다.
+	void init(int numOfThread)
+	{
+		numHeaps = C * numOfThread;
+		for (auto& slot : slots)
+		{
+			slot.heap.clear();
+			slot.top.store(INT_MAX, memory_order_relaxed);
+		}
+	}
+	bool insert(int key)
+	{
+		while (true)
+		{
+			Slot& slot{ slots[random() % numHeaps] };
+			if (!slot.mtx.try_lock()) continue;
+			slot.heap.push(key);
+			slot.top.store(slot.heap.top(), memory_order_relaxed);
+			slot.mtx.unlock();
+			return true;
+		}
+	}
+	int deleteMin()
+	{
+		for (int retries = 0; retries < EMPTY_RETRIES;)
+		{
+			Slot& first{ slots[random() % numHeaps] };
+			Slot& second{ slots[random() % numHeaps] };
+			Slot& slot{ first.top.load(memory_order_relaxed) <= second.top.load(memory_order_relaxed) ? first : second };
+			if (INT_MAX == slot.top.load(memory_order_relaxed)) { ++retries; continue; }
+			if (!slot.mtx.try_lock()) continue;
+
+			int key{ -1 };
+			if (!slot.heap.empty())
+			{
+				key = slot.heap.pop();
+				slot.top.store(slot.heap.empty() ? INT_MAX : slot.heap.top(), memory_order_relaxed);
+			}
+			slot.mtx.unlock();
+			if (-1 != key) return key;
+		}
+
+		// 거의 비어있다. -> 모든 힙을 차례로 확인
+		for (int i = 0; i < numHeaps; ++i)
+		{
+			Slot& slot{ slots[i] };
+			lock_guard<mutex> lock{ slot.mtx };
+			if (slot.heap.empty()) continue;
+			int key{ slot.heap.pop() };
+			slot.top.store(slot.heap.empty() ? INT_MAX : slot.heap.top(), memory_order_relaxed);
+			return key;
+		}
+		return -1;
+	}
+	// 모든 힙을 순서대로 잠그고 key보다 작은 값을 센다. -> try_lock만 하는 insert, deleteMin과 교착상태가 없다.
+	long long rankOf(int key)
+	{
+		long long rank{};
+		for (int i = 0; i < numHeaps; ++i) slots[i].mtx.lock();
+		for (int i = 0; i < numHeaps; ++i) rank += slots[i].heap.countLess(key);
+		for (int i = 0; i < numHeaps; ++i) slots[i].mtx.unlock();
+		return rank;
+	}
+	size_t size()
+	{
+		size_t result{};
+		for (auto& slot : slots) result += slot.heap.size();
+		return result;
+	}
+private:
+	static unsigned random()
+	{
+		thread_local XorShift rng{ static_cast<unsigned>(THREAD_ID + 1) };
+		return rng.next();
+	}
+};
+
+constexpr int NUM_TEST{ 4000000 };
+constexpr int KEY_RANGE{ 1 << 15 };		// MSVC의 RAND_MAX + 1
+constexpr int PREFILL{ 1 << 16 };		// 측정 전에 넣어두는 값의 수
+constexpr int RANK_SAMPLE{ 1024 };		// 이만큼 deleteMin할 때마다 rank error를 한번 잰다.
+
+struct alignas(64) RankStat
+{
+	long long sum{}, max{}, count{};
+};
+
+LockedHeap lockedHeap;
+MultiQueue multiQueue;
+RankStat rankStats[MAX_THREADS]{};
+
+// isSampling이면 rank error를 잰다. (시간을 재지 않는 실행에서만)
+template <class PriorityQueue>
+void ThreadFunc(PriorityQueue* pq, int numOfThread, int threadID, bool isSampling)
+{
+	int deleted{};
+	RankStat& stat{ rankStats[threadID] };
+
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		switch (rand() % 2)
+		{
+		case 0: pq->insert(rand() % KEY_RANGE); break;
+		case 1:
+		{
+			int key{ pq->deleteMin() };
+			if (!isSampling || -1 == key || ++deleted % RANK_SAMPLE) break;
+			long long rank{ pq->rankOf(key) };
+			stat.sum += rank;
+			stat.max = max(stat.max, rank);
+			++stat.count;
+			break;
+		}
+		default: cout << "Error\n"; exit(-1);
+		}
+	}
+}
+
+// 측정 전 상태(C * numOfThread개의 힙, PREFILL개의 값)로 되돌리고 스레드를 돌린다.
+template <class PriorityQueue>
+void run(PriorityQueue* pq, int numOfThread, bool isSampling)
+{
+	vector<thread> threads{};
+
+	pq->init(numOfThread);
+	for (int j = 0; j < PREFILL; ++j) pq->insert(rand() % KEY_RANGE);
+
+	for (int j = 0; j < numOfThread; ++j) threads.emplace_back(ThreadFunc<PriorityQueue>, pq, numOfThread, j, isSampling);
+	for (auto& thread : threads) thread.join();
+}
+
+template <class PriorityQueue>
+void benchmark(PriorityQueue* pq)
+{
+	RssSampler sampler{};
+
+	for (int i = 1; i <= MAX_THREADS; i *= 2)
+	{
+		// 처리량: rank error를 재지 않는다.
+		size_t startMemory{ getResidentMemory() };
+		sampler.start();
+		auto start{ high_resolution_clock::now() };
+		run(pq, i, false);
+		auto duration{ high_resolution_clock::now() - start };
+		sampler.stop();
+
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		size_t endMemory{ getResidentMemory() };
+		size_t size{ pq->size() };
+
+		// rank error: 같은 부하를 시간을 재지 않고 다시 돌린다.
+		for (auto& stat : rankStats) stat = RankStat{};
+		run(pq, i, true);
+		RankStat total{};
+		for (auto& stat : rankStats)
+		{
+			total.sum += stat.sum;
+			total.max = max(total.max, stat.max);
+			total.count += stat.count;
+		}
+
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << "Throughput = " << static_cast<long long>(NUM_TEST / seconds) << " ops/sec, ";
+		cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB), ";
+		cout << "Size = " << size << "\n";
+		cout << "\tRank Error: avg = " << (total.count ? static_cast<double>(total.sum) / total.count : 0.0) << ", max = " << total.max << " (" << total.count << " samples)\n";
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+	}
+}
+
+int main()
+{
+	// 순서가 느슨하므로 남은 값이 작은 것부터 나오는지는 검사하지 않는다.
+	stressPriorityQueue(MAX_THREADS, STRESS_OPS,
+		[](int threadID, int key) { THREAD_ID = threadID; return multiQueue.insert(key); },
+		[](int threadID) { THREAD_ID = threadID; return multiQueue.deleteMin(); }, false);
+
+	cout << "[Locked Heap]\n";
+	benchmark(&lockedHeap);
+	cout << "[Multi Queue] heaps = " << C << " x threads\n";
+	benchmark(&multiQueue);
+}
@@ -0,0 +1,298 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <climits>
+#include "hazard_pointer.h"
+#include "memory_usage.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	비멈춤동기화(k-fifo)
+
+	1. 노드 하나가 k칸짜리 세그먼트이고, 세그먼트를 연결리스트로 잇는다. k는 생성자에서 정한다.
+	2. push는 tail 세그먼트에서 무작위 칸부터 k칸을 돌며 EMPTY인 칸에 값을 CAS한다.
+	   pop은 head 세그먼트에서 무작위 칸부터 k칸을 돌며 값이 있는 칸을 TAKEN으로 CAS한다.
+	   -> 스레드들이 한 칸(head, tail)이 아니라 k칸에 흩어져서 경합한다.
+	3. 세그먼트 안에서는 순서가 없다. -> 최대 k - 1개 앞선 값보다 먼저 나올 수 있다. (k-FIFO)
+	4. tail 세그먼트에 EMPTY 칸이 없으면 새 세그먼트를 CAS로 연결하고 tail을 옮긴다.
+	   head 세그먼트가 모두 TAKEN이면 head를 옮기고 해저드 포인터로 retire한다.
+	5. 칸은 EMPTY -> 값 -> TAKEN으로 한번만 쓰인다. -> 같은 칸을 다시 쓰지 않으므로 ABA가 없다.
+
+	※ head 세그먼트가 tail이 아닌데 EMPTY 칸이 남아있으면, pop이 그 칸을 TAKEN으로 막는다.
+	   -> 늦게 온 push는 CAS가 실패하고 tail에서 다시 시도한다. 값이 사라지지 않는다.
+	※ k = 1이면 칸 하나짜리 세그먼트의 연결리스트, 즉 엄격한 FIFO 큐다. 비교 기준으로 같이 측정한다.
+	※ 순서 어긋남은 pop한 스레드가 같은 생산자의 값을 순서대로 받았는지로 잰다.
+	   -> 엄격한 FIFO 큐라면 한 소비자는 한 생산자의 값을 넣은 순서대로 받는다. 어긋남은 항상 0이다.
+	※ 값으로 EMPTY(INT_MIN), TAKEN(INT_MIN + 1)은 넣을 수 없다.
+*/
+
+constexpr int MAX_THREADS{ 8 };
+constexpr int EMPTY{ INT_MIN };
+constexpr int TAKEN{ INT_MIN + 1 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+class Node
+{
+public:
+	atomic<int>* items{};
+	atomic<Node*> next{};
+	// 첫 칸에 값을 넣은 채로 만든다. -> 연결하는 CAS 한번으로 push가 끝난다.
+	Node(int k, int value) : items{ new atomic<int>[k] }
+	{
+		for (int i = 0; i < k; ++i) items[i].store(EMPTY, memory_order_relaxed);
+		items[0].store(value, memory_order_relaxed);
+	}
+	explicit Node(int k) : Node(k, EMPTY) {}
+	~Node() { delete[] items; }
+};
+
+class Queue
+{
+	const int k{};
+	alignas(64) atomic<Node*> head{};
+	alignas(64) atomic<Node*> tail{};
+	HazardPointer<Node, MAX_THREADS, 1> hp{};
+	atomic<size_t> segments{};		// 만든 세그먼트 수
+public:
+	explicit Queue(int k) : k{ k } { head = tail = new Node{ k }; }
+	~Queue() { init(); delete head.load(); }
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void init()
+	{
+		Node* ptr{ head.load(memory_order_relaxed) };
+		while (ptr)
+		{
+			Node* next{ ptr->next.load(memory_order_relaxed) };
+			delete ptr;
+			ptr = next;
+		}
+		head = tail = new Node{ k };
+		hp.clear();
+		segments = 0;
+	}
+	int getK() { return k; }
+	size_t getSegments() { return segments; }
+
+	bool CAS(atomic<Node*>& addr, Node* oldNode, Node* newNode)
+	{
+		return addr.compare_exchange_strong(oldNode, newNode, memory_order_release, memory_order_relaxed);
+	}
+	void push(int value)
+	{
+		while (true)
+		{
+			Node* last{ hp.protect(THREAD_ID, 0, tail) };
+			int start{ static_cast<int>(random() % k) };
+
+			for (int i = 0; i < k; ++i)
+			{
+				atomic<int>& item{ last->items[(start + i) % k] };
+				int expected{ EMPTY };
+				if (EMPTY != item.load(memory_order_relaxed)) continue;
+				if (item.compare_exchange_strong(expected, value, memory_order_release, memory_order_relaxed))
+				{
+					hp.release(THREAD_ID);
+					return;
+				}
+			}
+
+			// 세그먼트에 EMPTY 칸이 없다.
+			if (last != tail.load(memory_order_acquire)) continue;
+			Node* next{ last->next.load(memory_order_acquire) };
+			if (!next)
+			{
+				Node* node{ new Node{ k, value } };
+				if (CAS(last->next, nullptr, node))
+				{
+					CAS(tail, last, node);
+					segments.fetch_add(1, memory_order_relaxed);
+					hp.release(THREAD_ID);
+					return;
+				}
+				delete node;		// 아직 아무도 보지 못한 노드
+			}
+			else CAS(tail, last, next);
+		}
+	}
+	int pop()
+	{
+		while (true)
+		{
+			Node* first{ hp.protect(THREAD_ID, 0, head) };
+			int start{ static_cast<int>(random() % k) };
+			bool hasEmpty{};
+			bool retry{};
+
+			for (int i = 0; i < k; ++i)
+			{
+				atomic<int>& item{ first->items[(start + i) % k] };
+				int value{ item.load(memory_order_acquire) };
+				if (TAKEN == value) continue;
+				if (EMPTY == value) { hasEmpty = true; continue; }
+				if (item.compare_exchange_strong(value, TAKEN, memory_order_acquire, memory_order_relaxed))
+				{
+					hp.release(THREAD_ID);
+					return value;
+				}
+				retry = true;		// 다른 pop이 먼저 가져갔다. -> 세그먼트를 다시 본다.
+				break;
+			}
+			if (retry) continue;
+
+			Node* last{ tail.load(memory_order_acquire) };
+			if (first == last)
+			{
+				if (hasEmpty || !first->next.load(memory_order_acquire)) break;		// 비어있다.
+				CAS(tail, last, first->next.load(memory_order_acquire));		// 늦은 tail을 돕는다.
+				continue;
+			}
+
+			if (hasEmpty)
+			{
+				// tail이 아닌 세그먼트의 EMPTY 칸을 막는다. 그 사이 들어온 값은 다시 돌며 가져간다.
+				for (int i = 0; i < k; ++i)
+				{
+					int expected{ EMPTY };
+					first->items[i].compare_exchange_strong(expected, TAKEN, memory_order_acquire, memory_order_relaxed);
+				}
+				continue;
+			}
+
+			// 모든 칸이 TAKEN이다.
+			Node* next{ first->next.load(memory_order_acquire) };
+			if (CAS(head, first, next))
+			{
+				hp.release(THREAD_ID);
+				hp.retire(THREAD_ID, first);
+			}
+		}
+		hp.release(THREAD_ID);
+		return -1;
+	}
+	void printElement(int count)
+	{
+		for (Node* cur = head.load(); cur && count; cur = cur->next.load())
+		{
+			for (int i = 0; i < k && count; ++i)
+			{
+				int value{ cur->items[i].load() };
+				if (EMPTY == value || TAKEN == value) continue;
+				cout << value << ", ";
+				--count;
+			}
+		}
+		cout << endl;
+	}
+private:
+	static unsigned random()
+	{
+		thread_local XorShift rng{ static_cast<unsigned>(THREAD_ID + 1) };
+		return rng.next();
+	}
+};
+
+constexpr int NUM_TEST{ 10000000 };
+constexpr int SEQ_BITS{ 24 };		// 값 = 생산자 THREAD_ID << SEQ_BITS | 생산자의 push 순번
+
+struct alignas(64) OrderStat
+{
+	long long popped{}, inversions{}, sum{}, max{};
+};
+
+OrderStat orderStats[MAX_THREADS]{};
+
+void ThreadFunc(Queue* que, int numOfThread, int threadID)
+{
+	int seq{};
+	int lastSeen[MAX_THREADS]{};		// 생산자별로 받은 가장 큰 순번 + 1
+	OrderStat& stat{ orderStats[threadID] };
+
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		switch (rand() % 2)
+		{
+		case 0: que->push(threadID << SEQ_BITS | seq++); break;
+		case 1:
+		{
+			int value{ que->pop() };
+			if (-1 == value) break;
+			int producer{ value >> SEQ_BITS }, order{ value & ((1 << SEQ_BITS) - 1) };
+			++stat.popped;
+			if (order < lastSeen[producer])
+			{
+				long long distance{ lastSeen[producer] - order };
+				++stat.inversions;
+				stat.sum += distance;
+				stat.max = max(stat.max, distance);
+			}
+			else lastSeen[producer] = order + 1;
+			break;
+		}
+		default: cout << "Error\n"; exit(-1);
+		}
+	}
+}
+
+int main()
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	for (int k : { 1, 16 })
+	{
+		Queue stressQue{ k };
+		// k > 1이면 생산자별 순서는 검사하지 않는다.
+		stressQueue(MAX_THREADS, STRESS_OPS, 1 == k,
+			[&](int threadID, int value) { THREAD_ID = threadID; stressQue.push(value); },
+			[&](int threadID) { THREAD_ID = threadID; return stressQue.pop(); });
+	}
+
+	for (int k : { 1, 4, 16, 64 })
+	{
+		Queue que{ k };
+		cout << "[k = " << que.getK() << "]\n";
+
+		for (int i = 1; i <= MAX_THREADS; i *= 2)
+		{
+			threads.clear();
+			que.init();
+			for (auto& stat : orderStats) stat = OrderStat{};
+
+			size_t startMemory{ getResidentMemory() };
+			sampler.start();
+			auto start{ high_resolution_clock::now() };
+
+			for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, &que, i, j);
+			for (auto& thread : threads) thread.join();
+			sampler.stop();
+
+			auto duration{ high_resolution_clock::now() - start };
+			double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+			size_t endMemory{ getResidentMemory() };
+			OrderStat total{};
+			for (auto& stat : orderStats)
+			{
+				total.popped += stat.popped;
+				total.inversions += stat.inversions;
+				total.sum += stat.sum;
+				total.max = max(total.max, stat.max);
+			}
+			cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+			cout << "Throughput = " << static_cast<long long>(NUM_TEST / seconds) << " ops/sec, ";
+			cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB), ";
+			cout << "Segments = " << que.getSegments() << "\n";
+			cout << "\tOut of Order: " << (total.popped ? 100.0 * total.inversions / total.popped : 0.0) << " % of pops, ";
+			cout << "distance avg = " << (total.inversions ? static_cast<double>(total.sum) / total.inversions : 0.0) << ", max = " << total.max << "\n";
+			cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+			cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+		}
+	}
+}
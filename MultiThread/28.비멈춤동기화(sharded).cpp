@@ -0,0 +1,240 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include "hazard_pointer.h"
+#include "magazine.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	비멈춤동기화(sharded)
+
+	1. 스택 하나가 서브스택(Shard) 여러개를 가진다. 서브스택은 11.비멈춤동기화.cpp와 같은 top 하나짜리 스택이다.
+	2. push는 항상 자기 서브스택(THREAD_ID % 서브스택 수)에 한다.
+	3. pop도 자기 서브스택에서 먼저 꺼내고, 비어있으면 다음 서브스택부터 차례로(round-robin) 훔쳐온다.
+	   -> 흔한 경우에는 다른 코어가 쓰는 top을 건드리지 않는다. (캐시 라인 이동이 거의 없다.)
+	4. 서브스택마다 top을 다른 캐시 라인에 둔다. -> false sharing 방지
+	5. 노드 보호, 해제, 매거진은 11.비멈춤동기화.cpp와 같다. 해저드 포인터 하나를 모든 서브스택이 같이 쓴다.
+
+	※ LIFO 순서는 서브스택 안에서만 지켜진다. -> 객체 재사용처럼 순서가 중요하지 않은 곳에 쓴다.
+	※ 모든 서브스택을 한바퀴 돌아도 비어있으면 -1. 도는 사이 다른 서브스택에 push된 값은 놓칠 수 있다.
+	※ 서브스택이 1개면 11.비멈춤동기화.cpp의 스택과 같다. 비교 기준으로 같이 측정한다.
+*/
+
+constexpr int MAX_THREADS{ 8 };
+constexpr int SCAN_THRESHOLD{ 64 };	// retire 리스트가 이만큼 쌓이면 scan
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+class Node
+{
+public:
+	int key{};
+	Node* next{};
+	Node() = default;
+	Node(int newKey) { key = newKey; }
+	~Node() = default;
+};
+
+Magazine<Node, MAX_THREADS> magazine{};
+NodeStats<MAX_THREADS> stats{};
+
+// 해저드 포인터가 해제할 노드를 delete하는 대신 매거진에 반환
+struct NodeDeleter
+{
+	void operator()(Node* node) const
+	{
+		magazine.free(THREAD_ID, node);
+		stats.onFree(THREAD_ID);
+	}
+};
+
+class Stack
+{
+private:
+	struct alignas(64) Shard
+	{
+		atomic<Node*> top{};
+	};
+	struct alignas(64) Counter
+	{
+		long long steals{};
+	};
+private:
+	int numShards{ MAX_THREADS };
+	Shard shards[MAX_THREADS]{};
+	Counter counters[MAX_THREADS]{};		// 스레드별 훔쳐온 수
+	HazardPointer<Node, MAX_THREADS, 1, NodeDeleter> hp{ SCAN_THRESHOLD };
+public:
+	Stack() = default;
+	~Stack() { init(); }
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void init()
+	{
+		for (auto& shard : shards)
+		{
+			Node* ptr{ shard.top.load(memory_order_relaxed) };
+			while (ptr)
+			{
+				Node* next{ ptr->next };
+				magazine.free(THREAD_ID, ptr);
+				stats.onRemove(THREAD_ID);
+				stats.onFree(THREAD_ID);
+				ptr = next;
+			}
+			shard.top.store(nullptr, memory_order_relaxed);
+		}
+		for (auto& counter : counters) counter = Counter{};
+		hp.clear();
+	}
+	Node* newNode(int key)
+	{
+		Node* node{ magazine.alloc(THREAD_ID) };
+		stats.onAlloc(THREAD_ID);
+		node->key = key;
+		node->next = nullptr;
+		return node;
+	}
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void setShards(int count) { numShards = count; }
+	int getShards() { return numShards; }
+	long long getSteals()
+	{
+		long long total{};
+		for (auto& counter : counters) total += counter.steals;
+		return total;
+	}
+
+	bool CAS(atomic<Node*>& addr, Node* oldNode, Node* newNode)
+	{
+		return addr.compare_exchange_strong(oldNode, newNode, memory_order_release, memory_order_relaxed);
+	}
+
+	void push(int key)
+	{
+		Node* node{ newNode(key) };
+		atomic<Node*>& top{ shards[THREAD_ID % numShards].top };
+
+		while (true)
+		{
+			Node* cur{ top.load(memory_order_relaxed) };
+			node->next = cur;
+			if (CAS(top, cur, node)) return;
+		}
+	}
+	int pop()
+	{
+		int home{ THREAD_ID % numShards };
+		for (int i = 0; i < numShards; ++i)
+		{
+			int val{ popFrom(shards[(home + i) % numShards].top) };
+			if (-1 == val) continue;
+			if (i) ++counters[THREAD_ID].steals;
+			return val;
+		}
+		return -1;
+	}
+	void printElement(int count)
+	{
+		for (int i = 0; i < numShards && count; ++i)
+		{
+			for (Node* cur = shards[i].top.load(); cur && count; cur = cur->next, --count) cout << cur->key << " ";
+		}
+		cout << endl;
+	}
+private:
+	int popFrom(atomic<Node*>& top)
+	{
+		while (true)
+		{
+			Node* cur{ hp.protect(THREAD_ID, 0, top) };
+			if (!cur)
+			{
+				hp.release(THREAD_ID);
+				return -1;
+			}
+
+			int val{ cur->key };
+			if (CAS(top, cur, cur->next))
+			{
+				hp.release(THREAD_ID);
+				stats.onRemove(THREAD_ID);
+				hp.retire(THREAD_ID, cur);
+				return val;
+			}
+		}
+	}
+};
+
+constexpr int NUM_TEST{ 10000000 };
+
+Stack stk;
+
+void ThreadFunc(int numOfThread, int threadID)
+{
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		switch (rand() % 2 || i < 1000 / numOfThread)
+		{
+		case 0: stk.push(i); break;
+		case 1: stk.pop(); break;
+		default: cout << "Error\n"; exit(-1);
+		}
+	}
+}
+
+int main()
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	stressQueue(MAX_THREADS, STRESS_OPS, false,
+		[](int threadID, int value) { THREAD_ID = threadID; stk.push(value); },
+		[](int threadID) { THREAD_ID = threadID; return stk.pop(); });
+
+	// 서브스택 하나(top 하나)와 스레드별 서브스택을 비교
+	for (int shards : { 1, MAX_THREADS })
+	{
+		stk.init();
+		stk.setShards(shards);
+		cout << "[Shards = " << stk.getShards() << "]\n";
+
+		for (int i = 1; i <= MAX_THREADS; i *= 2)
+		{
+			threads.clear();
+			stk.init();
+			magazine.resetCount();
+
+			size_t startMemory{ getResidentMemory() };
+			sampler.start();
+			auto start{ high_resolution_clock::now() };
+
+			for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
+			for (auto& thread : threads) thread.join();
+			sampler.stop();
+
+			stk.printElement(20);
+
+			auto duration{ high_resolution_clock::now() - start };
+			double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+			size_t endMemory{ getResidentMemory() };
+			cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+			cout << duration_cast<nanoseconds>(duration).count() / NUM_TEST << " ns/op, ";
+			cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB), ";
+			cout << "Steals = " << stk.getSteals() << ", ";
+			cout << "Allocator Calls = " << magazine.getAllocatorCalls() << " (new/delete = " << magazine.getRequests() << ")\n";
+			stats.print();
+			cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+			cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+		}
+	}
+}
@@ -0,0 +1,254 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <climits>
+#include "ebr.h"
+#include "memory_usage.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	비멈춤동기화(dual queue)
+
+	1. 큐에는 값을 가진 노드(data)나 값을 기다리는 노드(request, 예약) 중 한 종류만 들어있다.
+	2. take는 큐에 data가 있으면 맨 앞 노드의 값을 CAS로 가져가고, 없으면 request 노드를 tail에 붙이고 그 노드를 기다린다.
+	   put은 큐에 request가 있으면 맨 앞 노드에 값을 CAS로 직접 채워주고, 없으면 data 노드를 tail에 붙인다.
+	   -> 소비자는 pop()이 -1을 반환할 때마다 다시 부르는 대신, 자기 노드의 item이 바뀌기를 기다린다.
+	3. 노드의 item은 12.비멈춤동기화(elimination).cpp의 교환자 슬롯처럼 한번만 바뀐다.
+	   -> request: EMPTY -> 값, data: 값 -> EMPTY. 바꾸는 CAS에 성공한 쪽이 짝이 된다.
+	4. 짝을 찾은 노드는 head를 옮겨서 떼어내고 EBR로 해제한다. 기다리던 스레드도 자기 노드가 head가 되도록 돕는다.
+	5. 연산 방식(How)
+	   - NOW: 짝이 없으면 노드를 붙이지 않고 바로 -1 (poll)
+	   - ASYNC: data 노드를 붙이고 바로 반환 (버퍼가 있는 큐의 push)
+	   - SYNC: 노드를 붙이고 짝이 올 때까지 기다린다. (put, take 모두 SYNC면 랑데부 채널)
+
+	※ 기다릴 때는 SPIN_LIMIT번 읽어보고, 그 뒤로는 yield하며 읽는다.
+	※ 기다리는 동안 EBR 에포크를 잡고 있으므로, 오래 기다리면 그동안 떼어낸 노드의 해제가 늦어진다.
+	※ 값으로 EMPTY(INT_MIN)는 넣을 수 없다.
+*/
+
+constexpr int MAX_THREADS{ 8 };
+constexpr int EMPTY{ INT_MIN };
+constexpr int SPIN_LIMIT{ 256 };	// 기다릴 때 yield하기 전에 읽어보는 횟수
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+enum class How { NOW, ASYNC, SYNC };
+
+class Node
+{
+public:
+	atomic<int> item{ EMPTY };
+	atomic<Node*> next{};
+	bool isData{};
+	Node() = default;
+	Node(int value, bool data) { item.store(value, memory_order_relaxed); isData = data; }
+	~Node() = default;
+};
+
+class DualQueue
+{
+private:
+	struct alignas(64) Counter
+	{
+		long long waits{}, yields{};
+	};
+private:
+	alignas(64) atomic<Node*> head{};
+	alignas(64) atomic<Node*> tail{};
+	EBR<Node, MAX_THREADS> ebr{};
+	Counter counters[MAX_THREADS]{};		// 스레드별 노드를 붙이고 기다린 수, 기다리며 yield한 수
+public:
+	DualQueue() { head = tail = new Node{}; }
+	~DualQueue() { init(); delete head.load(); }
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void init()
+	{
+		Node* ptr{ head.load(memory_order_relaxed) };
+		while (ptr)
+		{
+			Node* next{ ptr->next.load(memory_order_relaxed) };
+			delete ptr;
+			ptr = next;
+		}
+		head = tail = new Node{};
+		ebr.clear();
+		for (auto& counter : counters) counter = Counter{};
+	}
+	long long getWaits() { return sum(&Counter::waits); }
+	long long getYields() { return sum(&Counter::yields); }
+
+	bool CAS(atomic<Node*>& addr, Node* oldNode, Node* newNode)
+	{
+		return addr.compare_exchange_strong(oldNode, newNode, memory_order_release, memory_order_relaxed);
+	}
+	int put(int value, How how) { return transfer(value, true, how); }
+	int take(How how) { return transfer(EMPTY, false, how); }
+private:
+	// put이면 value를, take면 가져온 값을 반환한다. NOW에서 짝이 없으면 -1
+	int transfer(int value, bool isData, How how)
+	{
+		Node* node{};
+		ebr.start(THREAD_ID);
+
+		while (true)
+		{
+			Node* first{ head.load(memory_order_acquire) };
+			Node* last{ tail.load(memory_order_acquire) };
+
+			if (first == last || last->isData == isData)
+			{
+				// 비어있거나 같은 종류의 노드만 있다. -> tail에 붙인다.
+				Node* next{ last->next.load(memory_order_acquire) };
+				if (last != tail.load(memory_order_acquire)) continue;
+				if (next) { CAS(tail, last, next); continue; }
+				if (How::NOW == how) break;
+
+				if (!node) node = new Node{ value, isData };
+				if (!CAS(last->next, nullptr, node)) continue;
+				CAS(tail, last, node);
+				if (How::ASYNC == how) { ebr.end(THREAD_ID); return value; }
+
+				int result{ await(node, value) };
+				advanceHead(last, node);		// 짝이 아직 head를 옮기지 않았다면 돕는다.
+				ebr.end(THREAD_ID);
+				return isData ? value : result;
+			}
+
+			// 다른 종류의 노드가 있다. -> 맨 앞 노드와 짝을 짓는다.
+			Node* match{ first->next.load(memory_order_acquire) };
+			if (last != tail.load(memory_order_acquire) || !match || first != head.load(memory_order_acquire)) continue;
+
+			int item{ match->item.load(memory_order_acquire) };
+			bool isMatched{ isData == (EMPTY != item) };		// 이미 다른 스레드가 짝을 지었다.
+			if (isMatched || !match->item.compare_exchange_strong(item, value, memory_order_acq_rel, memory_order_relaxed))
+			{
+				advanceHead(first, match);
+				continue;
+			}
+			advanceHead(first, match);
+			ebr.end(THREAD_ID);
+			delete node;		// 붙이지 못한 노드는 아무도 보지 못했다.
+			return isData ? value : item;
+		}
+
+		ebr.end(THREAD_ID);
+		delete node;
+		return -1;
+	}
+	// 노드의 item이 처음 값에서 바뀔 때까지 기다린다.
+	int await(Node* node, int origin)
+	{
+		Counter& counter{ counters[THREAD_ID] };
+		++counter.waits;
+		for (int spin = 0; ; ++spin)
+		{
+			int item{ node->item.load(memory_order_acquire) };
+			if (item != origin) return item;
+			if (spin >= SPIN_LIMIT)
+			{
+				++counter.yields;
+				this_thread::yield();
+			}
+		}
+	}
+	void advanceHead(Node* first, Node* next)
+	{
+		if (CAS(head, first, next)) ebr.retire(THREAD_ID, first);
+	}
+	long long sum(long long Counter::* field)
+	{
+		long long total{};
+		for (auto& counter : counters) total += counter.*field;
+		return total;
+	}
+};
+
+constexpr int NUM_TEST{ 4000000 };
+
+enum class Mode { POLLING, DUAL, RENDEZVOUS };
+
+DualQueue que;
+struct alignas(64) Counter
+{
+	long long polls{};
+};
+Counter pollCounters[MAX_THREADS]{};		// 소비자가 -1을 받고 다시 부른 수
+
+// 짝수 스레드는 생산자, 홀수 스레드는 소비자
+void ThreadFunc(Mode mode, int numOfThread, int threadID)
+{
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		switch (threadID % 2)
+		{
+		case 0: que.put(i, Mode::RENDEZVOUS == mode ? How::SYNC : How::ASYNC); break;
+		case 1:
+			if (Mode::POLLING != mode) { que.take(How::SYNC); break; }
+			while (-1 == que.take(How::NOW)) ++pollCounters[threadID].polls;
+			break;
+		default: cout << "Error\n"; exit(-1);
+		}
+	}
+}
+
+int main()
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	stressQueue(MAX_THREADS, STRESS_OPS, true,
+		[](int threadID, int value) { THREAD_ID = threadID; que.put(value, How::ASYNC); },
+		[](int threadID) { THREAD_ID = threadID; return que.take(How::NOW); });
+
+	// 생산자와 소비자가 모두 기다리는 랑데부. 다 받은 뒤의 마지막 확인만 NOW로 한다.
+	int received{};
+	que.init();
+	stressProducerConsumer(MAX_THREADS - 1, STRESS_OPS / 10,
+		[](int threadID, int value) { THREAD_ID = threadID; que.put(value, How::SYNC); },
+		[&](int threadID) { THREAD_ID = threadID; return que.take(++received <= (MAX_THREADS - 1) * (STRESS_OPS / 10) ? How::SYNC : How::NOW); });
+
+	// 소비자가 pop을 반복하는 큐, 소비자가 자기 노드에서 기다리는 dual queue, 생산자도 기다리는 랑데부 채널을 비교
+	for (Mode mode : { Mode::POLLING, Mode::DUAL, Mode::RENDEZVOUS })
+	{
+		switch (mode)
+		{
+		case Mode::POLLING: cout << "[Polling]\n"; break;
+		case Mode::DUAL: cout << "[Dual Queue]\n"; break;
+		case Mode::RENDEZVOUS: cout << "[Rendezvous]\n"; break;
+		}
+
+		for (int i = 2; i <= MAX_THREADS; i *= 2)
+		{
+			threads.clear();
+			que.init();
+			for (auto& counter : pollCounters) counter = Counter{};
+
+			size_t startMemory{ getResidentMemory() };
+			sampler.start();
+			auto start{ high_resolution_clock::now() };
+
+			for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, mode, i, j);
+			for (auto& thread : threads) thread.join();
+			sampler.stop();
+
+			auto duration{ high_resolution_clock::now() - start };
+			double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+			size_t endMemory{ getResidentMemory() };
+			long long polls{};
+			for (auto& counter : pollCounters) polls += counter.polls;
+			cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+			cout << duration_cast<nanoseconds>(duration).count() / (NUM_TEST / 2) << " ns/handoff, ";
+			cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB), ";
+			cout << "Failed Polls = " << polls << ", Waits = " << que.getWaits() << ", Yields = " << que.getYields() << "\n";
+			cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+			cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+		}
+	}
+}
@@ -1,30 +1,43 @@
 #include <iostream>
+#include <thread>
 #include <mutex>
 #include <chrono>
 #include <vector>
+#include <atomic>
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
+#include "node_pool.h"
 
 using namespace std;
 using namespace std::chrono;
 
 /*
-	õȭ
+	낙천적동기화
 
-	1. ѵȭ ٸ ȸÿ ŷ ʴ´.
-	2. ȸ  ŵ 带 delete ʴ´.
-	3. Լ   pred curr ŷϿ ȿ ˻ϰ ȿʴٸ ٽ ȸѴ.
-	   -> pred curr ŵ ʾҴ°? & pred curr̿ ٸ 尡  ʾҴ°?
+	1. 세밀한동기화와 다르게 순회시에는 락킹을 하지않는다.
+	2. 순회를 위해 제거된 노드를 delete하지 않는다.
+	3. 함수 실행을 위해 pred와 curr을 락킹하였을때 유효성을 검사하고 유효하지않다면 다시 순회한다.
+	   -> pred와 curr가 제거되지 않았는가? & pred와 curr사이에 다른 노드가 끼어들지 않았는가?
 
-	 ȿ ˻翡  ϴ 尡   ִ. ->  
-	 ȿ ˻ Ʈ ó ȸѴ. -> 
-	 ŵ 带 delete ʴ´. -> ޸ 
+	※ 유효성 검사에 계속 실패하는 스레드가 있을 수 있다. -> 기아 유발
+	※ 유효성 검사는 리스트를 처음부터 순회한다. -> 성능저하
+	※ 제거된 노드를 delete하지 않는다. -> 메모리 릭
+
+	4. 노드는 NodePool에서 할당하고, next는 포인터 대신 32비트 인덱스로 가리킨다.
+	   -> 노드를 64바이트로 정렬해서 인덱스를 주소로 바꿀 때 곱셈 대신 시프트를 쓰고, 이웃 노드의 락과 캐시라인을 공유하지 않는다.
+	5. 락 없이 읽는 next는 atomic으로 선언하고 필요한 만큼만 순서를 지정한다. (순회는 acquire, 연결은 release)
 */
 
-class Node
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+class alignas(64) Node
 {
 	mutex mtx{};
 public:
 	int key{};
-	Node* next{};
+	atomic<uint32_t> next{};
 	Node() = default;
 	Node(int value) { key = value; }
 	~Node() = default;
@@ -33,34 +46,54 @@ public:
 	void unlock() { mtx.unlock(); }
 };
 
+NodePool<Node, MAX_THREADS> pool{};
+NodeStats<MAX_THREADS> stats{};
+
 class List
 {
-	Node head{ 0x80000000 }, tail{ 0x7FFFFFFF };
+	Node* head{}, * tail{};
+	uint32_t tailIndex{};
 public:
-	List() { head.next = &tail; }
+	List()
+	{
+		head = pool.get(newNode(0x80000000));
+		tailIndex = newNode(0x7FFFFFFF);
+		tail = pool.get(tailIndex);
+		head->next.store(tailIndex, memory_order_relaxed);
+	}
 	~List() {}
 
 	void init()
 	{
-		Node* ptr{};
-		while (head.next != &tail)
+		uint32_t ptr{};
+		while (head->next.load(memory_order_relaxed) != tailIndex)
 		{
-			ptr = head.next;
-			head.next = head.next->next;
-			delete ptr;
+			ptr = head->next.load(memory_order_relaxed);
+			head->next.store(pool.get(ptr)->next.load(memory_order_relaxed), memory_order_relaxed);
+			pool.free(THREAD_ID, ptr);
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
 		}
 	}
+	uint32_t newNode(int key)
+	{
+		uint32_t index{ pool.alloc(THREAD_ID) };
+		stats.onAlloc(THREAD_ID);
+		Node* node{ pool.get(index) };
+		node->key = key;
+		return index;
+	}
 	bool add(int key)
 	{
 		while (true)
 		{
-			Node* pred{ &head };
-			Node* curr{ pred->next };
+			Node* pred{ head };
+			Node* curr{ nextOf(pred) };
 
 			while (curr->key < key)
 			{
 				pred = curr;
-				curr = curr->next;
+				curr = nextOf(curr);
 			}
 
 			pred->lock();
@@ -76,9 +109,9 @@ public:
 				}
 				else
 				{
-					Node* node{ new Node{key} };
-					node->next = curr;
-					pred->next = node;
+					uint32_t node{ newNode(key) };
+					pool.get(node)->next.store(pred->next.load(memory_order_relaxed), memory_order_relaxed);
+					pred->next.store(node, memory_order_release);		// 락 없이 순회하는 스레드도 초기화된 노드를 보도록
 
 					pred->unlock();
 					curr->unlock();
@@ -96,13 +129,13 @@ public:
 	{
 		while (true)
 		{
-			Node* pred{ &head };
-			Node* curr{ pred->next };
+			Node* pred{ head };
+			Node* curr{ nextOf(pred) };
 
 			while (curr->key < key)
 			{
 				pred = curr;
-				curr = curr->next;
+				curr = nextOf(curr);
 			}
 
 			pred->lock();
@@ -112,10 +145,11 @@ public:
 			{
 				if (key == curr->key)
 				{
-					pred->next = curr->next;
+					pred->next.store(curr->next.load(memory_order_relaxed), memory_order_release);
 					pred->unlock();
 					curr->unlock();
-					//delete curr;
+					stats.onRemove(THREAD_ID);
+					//pool.free(THREAD_ID, pool.indexOf(curr));
 					return true;
 				}
 				else
@@ -136,13 +170,13 @@ public:
 	{
 		while (true)
 		{
-			Node* pred{ &head };
-			Node* curr{ pred->next };
+			Node* pred{ head };
+			Node* curr{ nextOf(pred) };
 
 			while (curr->key < key)
 			{
 				pred = curr;
-				curr = curr->next;
+				curr = nextOf(curr);
 			}
 
 			pred->lock();
@@ -161,26 +195,28 @@ public:
 			}
 		}
 	}
+	// 락 없이 순회하므로 next는 acquire로 읽는다.
+	Node* nextOf(Node* node) { return pool.get(node->next.load(memory_order_acquire)); }
 	bool valid(Node* pred, Node* curr)
 	{
-		Node* node{ &head };
+		Node* node{ head };
 
 		while (node->key <= pred->key)
 		{
-			if (node == pred) return pred->next == curr;
-			node = node->next;
+			if (node == pred) return nextOf(pred) == curr;
+			node = nextOf(node);
 		}
 
 		return false;
 	}
 	void printElement(int count)
 	{
-		Node* node{ head.next };
+		Node* node{ nextOf(head) };
 		for (int i = 0; i < count; ++i)
 		{
-			if (&tail == node) break;
+			if (tail == node) break;
 			cout << node->key << " ";
-			node = node->next;
+			node = nextOf(node);
 		}
 		cout << "\n";
 	}
@@ -188,14 +224,15 @@ public:
 
 constexpr int NUM_TEST{ 4000000 };
 constexpr int KEY_RANGE{ 1000 };
-constexpr int MAX_THREADS{ 8 };
 
 List lst;
 
-void ThreadFunc(int numOfThread)
+void ThreadFunc(int numOfThread, int threadID)
 {
 	int key{};
 
+	THREAD_ID = threadID;
+
 	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
 	{
 		switch (rand() % 3) {
@@ -220,18 +257,31 @@ void ThreadFunc(int numOfThread)
 int main()
 {
 	vector<thread> threads{};
+	RssSampler sampler{};
+
+	stressSet(MAX_THREADS, STRESS_OPS, STRESS_KEY_RANGE,
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.add(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.remove(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.contains(key); });
+	lst.init();
 
 	for (int i = 1; i <= MAX_THREADS; i *= 2)
 	{
 		threads.clear();
+		sampler.start();
 		auto start{ high_resolution_clock::now() };
 
-		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i);
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
 		for (auto& thread : threads) thread.join();
+		sampler.stop();
 
 		lst.printElement(20);
 
 		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
 		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds\n";
+		stats.print();
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
 	}
 }
\ No newline at end of file
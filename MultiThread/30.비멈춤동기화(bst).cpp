@@ -0,0 +1,616 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <climits>
+#include <cstdint>
+#include "ebr.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	비멈춤동기화(bst)
+
+	1. 외부 이진 탐색 트리(external BST): 키는 leaf에만 있고, 내부 노드는 길을 안내하는 키와 자식 두개만 가진다.
+	2. 자식 간선(Edge)의 하위 2비트에 flag, tag를 둔다. (Natarajan-Mittal의 간선 마킹)
+	   - flag: 간선이 가리키는 leaf를 지우는 중이다.
+	   - tag: 간선의 주인(부모)을 트리에서 떼어내는 중이다. -> 이 간선은 더 이상 바뀌지 않는다.
+	3. add는 찾은 leaf 자리를 (내부 노드 + 새 leaf + 원래 leaf)로 바꾸는 CAS 한번이다.
+	4. remove는 leaf를 가리키는 간선을 flag하고(삽입 단계), 형제 간선을 tag한 뒤,
+	   tag되지 않은 마지막 간선(ancestor -> successor)을 형제로 바꾸는 CAS 한번으로 떼어낸다(정리 단계).
+	   -> 그 사이 같은 경로에서 지워지던 노드들도 한번에 떨어진다.
+	5. 탐색 중에 flag나 tag된 간선 때문에 CAS가 실패하면, 그 remove의 정리 단계를 돕는다.
+	6. contain은 락, CAS 없이 leaf까지 내려가서 키를 비교한다.
+	7. 떼어낸 노드는 EBR로 해제한다. 떼어낸 경로의 노드는 간선이 모두 마킹되어 있으므로 더 바뀌지 않는다.
+
+	※ 키 하나가 노드 두개(leaf, 내부 노드)를 쓰지만, 노드가 작다. (키 + 포인터 2개)
+	   -> 14.게으른동기화.cpp의 스킵리스트는 노드마다 포인터 MAX_LEVEL + 1개와 락을 가진다.
+	※ 같은 부하로 스킵리스트와 트리를 키 범위를 바꿔가며 비교한다.
+	※ 키로 INF0(INT_MAX - 2) 이상은 넣을 수 없다. (보초 노드의 키)
+*/
+
+constexpr int MAX_LEVEL{ 8 };
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+class SkipNode
+{
+private:
+	recursive_mutex mtx{};
+public:
+	int key{};
+	int topLevel{ MAX_LEVEL };
+	atomic<SkipNode*> next[MAX_LEVEL + 1]{};
+	atomic<bool> isRemoved{}, isLinkFinished{};
+public:
+	SkipNode() = default;
+	SkipNode(int value, int top)
+	{
+		topLevel = top;
+		key = value;
+	}
+	~SkipNode() = default;
+
+	void lock() { mtx.lock(); }
+	void unlock() { mtx.unlock(); }
+};
+
+NodeStats<MAX_THREADS> skipStats{};
+
+// EBR이 노드를 delete할 때 해제 수를 센다.
+struct SkipNodeDeleter
+{
+	void operator()(SkipNode* node) const
+	{
+		delete node;
+		skipStats.onFree(THREAD_ID);
+	}
+};
+
+class SkipList
+{
+private:
+	SkipNode head{}, tail{};
+	EBR<SkipNode, MAX_THREADS, SkipNodeDeleter> ebr{};
+public:
+	SkipList()
+	{
+		head.key = 0x80000000;
+		tail.key = 0x7FFFFFFF;
+		for (auto& i : head.next) i.store(&tail, memory_order_relaxed);
+		head.isLinkFinished.store(true, memory_order_relaxed);
+		tail.isLinkFinished.store(true, memory_order_relaxed);
+	};
+	~SkipList()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		SkipNode* node{ head.next[0].load(memory_order_relaxed) };
+		while (&tail != node)
+		{
+			SkipNode* target{ node };
+			node = node->next[0].load(memory_order_relaxed);
+			delete target;
+			skipStats.onRemove(THREAD_ID);
+			skipStats.onFree(THREAD_ID);
+		}
+		for (auto& i : head.next) i.store(&tail, memory_order_relaxed);
+		ebr.clear();
+	}
+	void setReclaim(bool reclaim) { ebr.setEnabled(reclaim); }
+
+	int find(int value, SkipNode* pred[], SkipNode* curr[])
+	{
+		int foundLevel{ -1 };
+
+		pred[MAX_LEVEL] = &head;
+		for (int curLevel = MAX_LEVEL; curLevel >= 0; --curLevel)
+		{
+			if (curLevel != MAX_LEVEL) pred[curLevel] = pred[curLevel + 1];
+			curr[curLevel] = pred[curLevel]->next[curLevel].load(memory_order_acquire);
+
+			while (curr[curLevel]->key < value)
+			{
+				pred[curLevel] = curr[curLevel];
+				curr[curLevel] = curr[curLevel]->next[curLevel].load(memory_order_acquire);
+			}
+
+			if (foundLevel == -1 && curr[curLevel]->key == value) foundLevel = curLevel;
+		}
+
+		return foundLevel;
+	}
+	bool add(int value)
+	{
+		SkipNode* pred[MAX_LEVEL + 1]{};
+		SkipNode* curr[MAX_LEVEL + 1]{};
+
+		ebr.start(THREAD_ID);
+		while (true)
+		{
+			int foundLevel{ find(value, pred, curr) };
+			if (foundLevel != -1)
+			{
+				if (curr[0]->isRemoved.load(memory_order_relaxed)) continue;
+				while (!curr[0]->isLinkFinished.load(memory_order_acquire));
+				ebr.end(THREAD_ID);
+				return false;
+			}
+
+			int curLevel{};
+			bool isValid{ true };
+			for (curLevel = 0; curLevel <= MAX_LEVEL; ++curLevel)
+			{
+				pred[curLevel]->lock();
+				isValid = !pred[curLevel]->isRemoved.load(memory_order_relaxed) && !curr[curLevel]->isRemoved.load(memory_order_relaxed) &&
+					curr[curLevel] == pred[curLevel]->next[curLevel].load(memory_order_relaxed);
+				if (!isValid) break;
+			}
+
+			if (!isValid)
+			{
+				for (int i = 0; i <= curLevel; ++i) pred[i]->unlock();
+				continue;
+			}
+			else
+			{
+				int topLevel{};
+				while (rand() % 2 == 1) if (++topLevel == MAX_LEVEL) break;
+
+				SkipNode* newNode{ new SkipNode{value, topLevel} };
+				skipStats.onAlloc(THREAD_ID);
+				for (int i = 0; i <= topLevel; ++i) newNode->next[i].store(curr[i], memory_order_relaxed);
+				for (int i = 0; i <= topLevel; ++i) pred[i]->next[i].store(newNode, memory_order_release);
+
+				newNode->isLinkFinished.store(true, memory_order_release);
+				for (int i = 0; i <= MAX_LEVEL; ++i) pred[i]->unlock();
+				ebr.end(THREAD_ID);
+				return true;
+			}
+		}
+	}
+	bool remove(int value)
+	{
+		SkipNode* pred[MAX_LEVEL + 1]{};
+		SkipNode* curr[MAX_LEVEL + 1]{};
+
+		ebr.start(THREAD_ID);
+		int foundLevel{ find(value, pred, curr) };
+		if (foundLevel == -1) { ebr.end(THREAD_ID); return false; }
+
+		SkipNode* target{ curr[foundLevel] };
+		if (target->isRemoved.load(memory_order_relaxed) || !target->isLinkFinished.load(memory_order_acquire) || target->topLevel != foundLevel)
+		{
+			ebr.end(THREAD_ID);
+			return false;
+		}
+
+		target->lock();
+		if (target->isRemoved.load(memory_order_relaxed)) { target->unlock(); ebr.end(THREAD_ID); return false; }
+		target->isRemoved.store(true, memory_order_relaxed);
+
+		while (true)
+		{
+			int curLevel{};
+			bool isValid{ true };
+			for (curLevel = 0; curLevel <= MAX_LEVEL; ++curLevel)
+			{
+				pred[curLevel]->lock();
+				isValid = !pred[curLevel]->isRemoved.load(memory_order_relaxed) && curr[curLevel] == pred[curLevel]->next[curLevel].load(memory_order_relaxed);
+				if (!isValid) break;
+			}
+
+			if (!isValid)
+			{
+				for (int i = 0; i <= curLevel; ++i) pred[i]->unlock();
+				find(value, pred, curr);
+				continue;
+			}
+
+			for (int i = curr[0]->topLevel; i >= 0; --i) pred[i]->next[i].store(curr[0]->next[i].load(memory_order_relaxed), memory_order_release);
+
+			for (int i = 0; i <= MAX_LEVEL; ++i) pred[i]->unlock();
+			target->unlock();
+			skipStats.onRemove(THREAD_ID);
+			ebr.retire(THREAD_ID, target);
+			ebr.end(THREAD_ID);
+			return true;
+		}
+	}
+	bool contain(int value)
+	{
+		SkipNode* pred[MAX_LEVEL + 1]{};
+		SkipNode* curr[MAX_LEVEL + 1]{};
+
+		ebr.start(THREAD_ID);
+		int foundLevel{ find(value, pred, curr) };
+		bool result{ foundLevel != -1 && curr[foundLevel]->isLinkFinished.load(memory_order_acquire) && !curr[foundLevel]->isRemoved.load(memory_order_relaxed) };
+		ebr.end(THREAD_ID);
+		return result;
+	}
+	void printElement(int count)
+	{
+		SkipNode* cur{ head.next[0].load() };
+		for (int i = 0; i < count; ++i)
+		{
+			if (&tail == cur)
+				break;
+			cout << cur->key << " ";
+			cur = cur->next[0].load();
+		}
+		cout << endl;
+	}
+};
+
+
+constexpr int INF0{ INT_MAX - 2 }, INF1{ INT_MAX - 1 }, INF2{ INT_MAX };
+
+class TreeNode;
+
+// | address | flag(1) | tag(1) |
+class Edge
+{
+private:
+	static constexpr uintptr_t FLAG{ 0x2 };
+	static constexpr uintptr_t TAG{ 0x1 };
+private:
+	atomic<uintptr_t> value{};
+public:
+	static uintptr_t pack(TreeNode* node, bool flag, bool tag)
+	{
+		return reinterpret_cast<uintptr_t>(node) | (flag ? FLAG : 0) | (tag ? TAG : 0);
+	}
+	static TreeNode* address(uintptr_t edge) { return reinterpret_cast<TreeNode*>(edge & ~(FLAG | TAG)); }
+	static bool isFlagged(uintptr_t edge) { return edge & FLAG; }
+	static bool isTagged(uintptr_t edge) { return edge & TAG; }
+
+	// 아직 공개되지 않은 노드나 혼자 쓰는 트리에만 사용
+	void set(TreeNode* node) { value.store(pack(node, false, false), memory_order_relaxed); }
+	uintptr_t load() { return value.load(memory_order_acquire); }
+	TreeNode* get() { return address(load()); }
+	bool CAS(uintptr_t oldEdge, uintptr_t newEdge)
+	{
+		return value.compare_exchange_strong(oldEdge, newEdge, memory_order_acq_rel, memory_order_acquire);
+	}
+	// tag를 켜고 켠 뒤의 값을 반환한다. 이미 켜져 있어도 된다.
+	uintptr_t setTag() { return value.fetch_or(TAG, memory_order_acq_rel) | TAG; }
+};
+
+class TreeNode
+{
+public:
+	int key{};
+	Edge left{}, right{};		// leaf라면 둘 다 nullptr
+public:
+	TreeNode() = default;
+	TreeNode(int value) { key = value; }
+	~TreeNode() = default;
+
+	Edge& child(int value) { return value < key ? left : right; }
+};
+
+NodeStats<MAX_THREADS> treeStats{};
+
+// EBR이 노드를 delete할 때 해제 수를 센다.
+struct TreeNodeDeleter
+{
+	void operator()(TreeNode* node) const
+	{
+		delete node;
+		treeStats.onFree(THREAD_ID);
+	}
+};
+
+class Tree
+{
+private:
+	// 탐색 경로 위의 노드. ancestor -> successor는 tag되지 않은 마지막 간선이다.
+	struct SeekRecord
+	{
+		TreeNode* ancestor{}, * successor{}, * parent{}, * leaf{};
+	};
+private:
+	// 보초 노드: root(INF2) -> left: s(INF1) -> left: leaf(INF0), right: leaf(INF1) / root -> right: leaf(INF2)
+	// 실제 키는 모두 s의 왼쪽 아래에 들어간다.
+	TreeNode root{ INF2 }, s{ INF1 };
+	TreeNode leaf0{ INF0 }, leaf1{ INF1 }, leaf2{ INF2 };
+	EBR<TreeNode, MAX_THREADS, TreeNodeDeleter> ebr{};
+public:
+	Tree()
+	{
+		root.left.set(&s);
+		root.right.set(&leaf2);
+		s.left.set(&leaf0);
+		s.right.set(&leaf1);
+	}
+	~Tree() { clear(); }
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void clear()
+	{
+		vector<TreeNode*> nodes{ s.left.get() };
+		while (!nodes.empty())
+		{
+			TreeNode* node{ nodes.back() };
+			nodes.pop_back();
+			if (node->left.get()) nodes.push_back(node->left.get());
+			if (node->right.get()) nodes.push_back(node->right.get());
+			if (&leaf0 == node) continue;
+			delete node;
+			treeStats.onRemove(THREAD_ID);
+			treeStats.onFree(THREAD_ID);
+		}
+		s.left.set(&leaf0);
+		ebr.clear();
+	}
+	void setReclaim(bool reclaim) { ebr.setEnabled(reclaim); }
+
+	void seek(int key, SeekRecord* record)
+	{
+		record->ancestor = &root;
+		record->successor = &s;
+		record->parent = &s;
+
+		uintptr_t parentEdge{ s.left.load() };
+		record->leaf = Edge::address(parentEdge);
+		uintptr_t currentEdge{ record->leaf->child(key).load() };
+		TreeNode* current{ Edge::address(currentEdge) };
+
+		while (current)
+		{
+			if (!Edge::isTagged(parentEdge))
+			{
+				record->ancestor = record->parent;
+				record->successor = record->leaf;
+			}
+			record->parent = record->leaf;
+			record->leaf = current;
+
+			parentEdge = currentEdge;
+			currentEdge = current->child(key).load();
+			current = Edge::address(currentEdge);
+		}
+	}
+	bool add(int key)
+	{
+		SeekRecord record{};
+		TreeNode* newLeaf{};
+		TreeNode* newInternal{};
+
+		ebr.start(THREAD_ID);
+		while (true)
+		{
+			seek(key, &record);
+			TreeNode* leaf{ record.leaf };
+			if (leaf->key == key)
+			{
+				ebr.end(THREAD_ID);
+				delete newLeaf;		// 아직 아무도 보지 못한 노드
+				delete newInternal;
+				return false;
+			}
+
+			if (!newLeaf)
+			{
+				newLeaf = new TreeNode{ key };
+				newInternal = new TreeNode{};
+			}
+			newInternal->key = max(key, leaf->key);
+			newInternal->left.set(key < leaf->key ? newLeaf : leaf);
+			newInternal->right.set(key < leaf->key ? leaf : newLeaf);
+
+			Edge& childEdge{ record.parent->child(key) };
+			if (childEdge.CAS(Edge::pack(leaf, false, false), Edge::pack(newInternal, false, false)))
+			{
+				treeStats.onAlloc(THREAD_ID);
+				treeStats.onAlloc(THREAD_ID);
+				ebr.end(THREAD_ID);
+				return true;
+			}
+
+			// leaf를 지우는 중이라면 돕고 다시 시도한다.
+			uintptr_t edge{ childEdge.load() };
+			if (Edge::address(edge) == leaf && (Edge::isFlagged(edge) || Edge::isTagged(edge))) cleanup(key, record);
+		}
+	}
+	bool remove(int key)
+	{
+		SeekRecord record{};
+		TreeNode* leaf{};
+		bool isInjected{};		// leaf를 가리키는 간선을 flag했다. -> 정리 단계
+
+		ebr.start(THREAD_ID);
+		while (true)
+		{
+			seek(key, &record);
+			Edge& childEdge{ record.parent->child(key) };
+
+			if (!isInjected)
+			{
+				leaf = record.leaf;
+				if (leaf->key != key) { ebr.end(THREAD_ID); return false; }
+
+				if (childEdge.CAS(Edge::pack(leaf, false, false), Edge::pack(leaf, true, false)))
+				{
+					isInjected = true;
+					if (cleanup(key, record)) { ebr.end(THREAD_ID); return true; }
+				}
+				else
+				{
+					uintptr_t edge{ childEdge.load() };
+					if (Edge::address(edge) == leaf && (Edge::isFlagged(edge) || Edge::isTagged(edge))) cleanup(key, record);
+				}
+			}
+			else
+			{
+				// 다른 스레드가 정리 단계를 대신 끝냈다.
+				if (record.leaf != leaf || cleanup(key, record)) { ebr.end(THREAD_ID); return true; }
+			}
+		}
+	}
+	bool contain(int key)
+	{
+		SeekRecord record{};
+
+		ebr.start(THREAD_ID);
+		seek(key, &record);
+		bool result{ record.leaf->key == key };
+		ebr.end(THREAD_ID);
+		return result;
+	}
+	void printElement(int count)
+	{
+		vector<TreeNode*> nodes{ s.left.get() };
+		while (!nodes.empty() && count)
+		{
+			TreeNode* node{ nodes.back() };
+			nodes.pop_back();
+			if (node->left.get())
+			{
+				nodes.push_back(node->right.get());
+				nodes.push_back(node->left.get());
+				continue;
+			}
+			if (INF0 == node->key) continue;
+			cout << node->key << " ";
+			--count;
+		}
+		cout << endl;
+	}
+private:
+	bool cleanup(int key, const SeekRecord& record)
+	{
+		TreeNode* parent{ record.parent };
+		Edge& successorEdge{ record.ancestor->child(key) };
+		Edge* childEdge{ &parent->child(key) };
+		Edge* siblingEdge{ childEdge == &parent->left ? &parent->right : &parent->left };
+
+		// key 쪽 간선이 flag되지 않았다면, 반대쪽 leaf를 지우는 다른 스레드를 돕는 중이다.
+		if (!Edge::isFlagged(childEdge->load())) siblingEdge = childEdge;
+
+		uintptr_t sibling{ siblingEdge->setTag() };
+		if (!successorEdge.CAS(Edge::pack(record.successor, false, false), Edge::pack(Edge::address(sibling), Edge::isFlagged(sibling), false)))
+			return false;
+
+		retirePath(key, record.successor, parent, Edge::address(sibling));
+		return true;
+	}
+	// successor부터 parent까지 떼어낸 경로의 내부 노드와, 그 노드들이 가리키던 지울 leaf를 retire한다.
+	void retirePath(int key, TreeNode* successor, TreeNode* parent, TreeNode* sibling)
+	{
+		TreeNode* node{ successor };
+		while (true)
+		{
+			TreeNode* next{ node->child(key).get() };
+			TreeNode* other{ (&node->child(key) == &node->left ? node->right : node->left).get() };
+
+			if (node == parent)
+			{
+				// parent에서는 남기는 형제(sibling)가 아닌 쪽이 지울 leaf
+				retireNode(next == sibling ? other : next);
+				retireNode(node);
+				return;
+			}
+			retireNode(other);
+			retireNode(node);
+			node = next;
+		}
+	}
+	void retireNode(TreeNode* node)
+	{
+		treeStats.onRemove(THREAD_ID);
+		ebr.retire(THREAD_ID, node);
+	}
+};
+
+constexpr int NUM_TEST{ 4000000 };
+
+SkipList lst;
+Tree tree;
+
+template <class Set>
+void ThreadFunc(Set* set, int keyRange, int numOfThread, int threadID)
+{
+	int key{};
+
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		switch (rand() % 3) {
+		case 0:
+			key = rand() % keyRange;
+			set->add(key);
+			break;
+		case 1:
+			key = rand() % keyRange;
+			set->remove(key);
+			break;
+		case 2:
+			key = rand() % keyRange;
+			set->contain(key);
+			break;
+		default: cout << "Error\n";
+			exit(-1);
+		}
+	}
+}
+
+template <class Set, int MAX_THREADS>
+void benchmark(Set* set, NodeStats<MAX_THREADS>* stats, int keyRange)
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	for (int i = 1; i <= MAX_THREADS; i *= 2)
+	{
+		threads.clear();
+		set->clear();
+
+		size_t startMemory{ getResidentMemory() };
+		sampler.start();
+		auto start{ high_resolution_clock::now() };
+
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc<Set>, set, keyRange, i, j);
+		for (auto& thread : threads) thread.join();
+		sampler.stop();
+
+		set->printElement(20);
+
+		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		size_t endMemory{ getResidentMemory() };
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << "Throughput = " << static_cast<long long>(NUM_TEST / seconds) << " ops/sec, ";
+		cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB)\n";
+		stats->print();
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+	}
+}
+
+int main()
+{
+	stressSet(MAX_THREADS, STRESS_OPS, STRESS_KEY_RANGE,
+		[](int threadID, int key) { THREAD_ID = threadID; return tree.add(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return tree.remove(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return tree.contain(key); });
+
+	// 14.게으른동기화.cpp의 키 범위(1000)와 MSVC rand의 최대 범위에서 스킵리스트와 트리를 비교
+	for (int keyRange : { 1000, 1 << 15 })
+	{
+		cout << "[SkipList] keys = " << keyRange << ", node = " << sizeof(SkipNode) << " bytes\n";
+		benchmark(&lst, &skipStats, keyRange);
+		cout << "[Tree] keys = " << keyRange << ", node = " << sizeof(TreeNode) << " bytes x 2\n";
+		benchmark(&tree, &treeStats, keyRange);
+	}
+}
@@ -0,0 +1,778 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <climits>
+#include <cstdint>
+#include <algorithm>
+#include "ebr.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	낙천적동기화(b-link tree)
+
+	1. 노드 하나가 NODE_SIZE(512바이트, 캐시 라인 8개)이고 키를 여러개 담는다. -> 한번 내려갈 때마다 캐시 미스 한번에 키 수십개를 본다.
+	   - 내부 노드: 키 INNER_CAPACITY개, 자식 INNER_CAPACITY + 1개. 자식 i에는 keys[i] 이하의 키가 있다.
+	   - leaf: 정렬된 키 LEAF_CAPACITY개. -> 범위 검색은 leaf만 따라간다.
+	2. 모든 노드가 highKey와, 같은 높이의 오른쪽 노드를 가리키는 next를 가진다. (B-link, Lehman & Yao)
+	   -> 노드를 나누면 오른쪽 절반을 새 노드로 옮기고 next로 잇는다. 나뉜 노드의 highKey는 separator가 된다.
+	   -> 찾는 키가 highKey보다 크면, 부모를 거치지 않고 next로 오른쪽으로 간다. (move right)
+	3. 노드마다 버전(OptLock)을 둔다. 쓰는 스레드는 버전을 홀수로 만들어 잠그고, 풀면서 짝수로 올린다.
+	   읽는 스레드는 락을 잡지 않는다. 버전을 읽고, 노드를 읽고, 버전이 그대로인지 확인한다. 다르면 그 노드부터 다시 읽는다.
+	   -> 내려가는 도중에 노드가 나뉘어도 move right로 따라가므로, root부터 다시 내려가지 않는다.
+	4. add, remove는 바꿀 leaf 하나만 잠근다. 가득 찬 leaf는 그 leaf만 잠근 채로 나누고, 푼 뒤에 부모 하나만 잠가 separator를 끼운다.
+	   -> 락을 두개 이상 함께 잡지 않는다. 부모에 separator가 들어가기 전에도 next로 새 노드에 갈 수 있다.
+	   -> 부모가 가득 찼으면 부모도 같은 방법으로 나누고 한 층 위로 올린다. 부모는 내려올 때 적어둔 노드에서 오른쪽으로 찾는다.
+	5. 노드의 키와 자식은 락 없이 읽으므로 atomic이고 relaxed로 읽고 쓴다.
+	   버전 확인 전의 acquire fence와 잠근 뒤의 release fence가 순서를 보장한다. (seqlock)
+
+	※ remove는 leaf에서 키만 지우고 노드를 합치지 않는다. -> 노드를 해제하지 않으므로 EBR이 필요 없다.
+	※ scan은 스냅샷이 아니다. leaf 하나 단위로만 일관되고, 도중에 들어오거나 빠진 키는 보일 수도, 안 보일 수도 있다.
+	※ 14.게으른동기화.cpp의 스킵리스트와 키 범위 10^6 ~ 10^8에서 비교한다. 키는 32비트 범위가 필요하므로 rand 대신 XorShift로 만든다.
+	※ 스킵리스트는 키 수에 맞게 MAX_LEVEL을 20으로 올린다. 노드 하나가 포인터 21개를 가진다.
+	※ 미리 넣는 키는 범위의 절반이지만 2^22개를 넘지 않는다. 10^8 범위는 키가 성기게 들어간 상태에서 재므로, 출력에 실제 키 수를 함께 적는다.
+*/
+
+constexpr int MAX_LEVEL{ 20 };		// 14.게으른동기화.cpp는 8 -> 키 10^6 이상에서는 맨 위 레벨도 수천 칸을 지나간다.
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+class SkipNode
+{
+private:
+	recursive_mutex mtx{};
+public:
+	int key{};
+	int topLevel{ MAX_LEVEL };
+	atomic<SkipNode*> next[MAX_LEVEL + 1]{};
+	atomic<bool> isRemoved{}, isLinkFinished{};
+public:
+	SkipNode() = default;
+	SkipNode(int value, int top)
+	{
+		topLevel = top;
+		key = value;
+	}
+	~SkipNode() = default;
+
+	void lock() { mtx.lock(); }
+	void unlock() { mtx.unlock(); }
+};
+
+NodeStats<MAX_THREADS> skipStats{};
+
+// EBR이 노드를 delete할 때 해제 수를 센다.
+struct SkipNodeDeleter
+{
+	void operator()(SkipNode* node) const
+	{
+		delete node;
+		skipStats.onFree(THREAD_ID);
+	}
+};
+
+class SkipList
+{
+private:
+	SkipNode head{}, tail{};
+	EBR<SkipNode, MAX_THREADS, SkipNodeDeleter> ebr{};
+public:
+	SkipList()
+	{
+		head.key = 0x80000000;
+		tail.key = 0x7FFFFFFF;
+		for (auto& i : head.next) i.store(&tail, memory_order_relaxed);
+		head.isLinkFinished.store(true, memory_order_relaxed);
+		tail.isLinkFinished.store(true, memory_order_relaxed);
+	};
+	~SkipList()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		SkipNode* node{ head.next[0].load(memory_order_relaxed) };
+		while (&tail != node)
+		{
+			SkipNode* target{ node };
+			node = node->next[0].load(memory_order_relaxed);
+			delete target;
+			skipStats.onRemove(THREAD_ID);
+			skipStats.onFree(THREAD_ID);
+		}
+		for (auto& i : head.next) i.store(&tail, memory_order_relaxed);
+		ebr.clear();
+	}
+	void setReclaim(bool reclaim) { ebr.setEnabled(reclaim); }
+
+	int find(int value, SkipNode* pred[], SkipNode* curr[])
+	{
+		int foundLevel{ -1 };
+
+		pred[MAX_LEVEL] = &head;
+		for (int curLevel = MAX_LEVEL; curLevel >= 0; --curLevel)
+		{
+			if (curLevel != MAX_LEVEL) pred[curLevel] = pred[curLevel + 1];
+			curr[curLevel] = pred[curLevel]->next[curLevel].load(memory_order_acquire);
+
+			while (curr[curLevel]->key < value)
+			{
+				pred[curLevel] = curr[curLevel];
+				curr[curLevel] = curr[curLevel]->next[curLevel].load(memory_order_acquire);
+			}
+
+			if (foundLevel == -1 && curr[curLevel]->key == value) foundLevel = curLevel;
+		}
+
+		return foundLevel;
+	}
+	bool add(int value)
+	{
+		SkipNode* pred[MAX_LEVEL + 1]{};
+		SkipNode* curr[MAX_LEVEL + 1]{};
+
+		ebr.start(THREAD_ID);
+		while (true)
+		{
+			int foundLevel{ find(value, pred, curr) };
+			if (foundLevel != -1)
+			{
+				if (curr[0]->isRemoved.load(memory_order_relaxed)) continue;
+				while (!curr[0]->isLinkFinished.load(memory_order_acquire));
+				ebr.end(THREAD_ID);
+				return false;
+			}
+
+			int curLevel{};
+			bool isValid{ true };
+			for (curLevel = 0; curLevel <= MAX_LEVEL; ++curLevel)
+			{
+				pred[curLevel]->lock();
+				isValid = !pred[curLevel]->isRemoved.load(memory_order_relaxed) && !curr[curLevel]->isRemoved.load(memory_order_relaxed) &&
+					curr[curLevel] == pred[curLevel]->next[curLevel].load(memory_order_relaxed);
+				if (!isValid) break;
+			}
+
+			if (!isValid)
+			{
+				for (int i = 0; i <= curLevel; ++i) pred[i]->unlock();
+				continue;
+			}
+			else
+			{
+				int topLevel{};
+				while (rand() % 2 == 1) if (++topLevel == MAX_LEVEL) break;
+
+				SkipNode* newNode{ new SkipNode{value, topLevel} };
+				skipStats.onAlloc(THREAD_ID);
+				for (int i = 0; i <= topLevel; ++i) newNode->next[i].store(curr[i], memory_order_relaxed);
+				for (int i = 0; i <= topLevel; ++i) pred[i]->next[i].store(newNode, memory_order_release);
+
+				newNode->isLinkFinished.store(true, memory_order_release);
+				for (int i = 0; i <= MAX_LEVEL; ++i) pred[i]->unlock();
+				ebr.end(THREAD_ID);
+				return true;
+			}
+		}
+	}
+	bool remove(int value)
+	{
+		SkipNode* pred[MAX_LEVEL + 1]{};
+		SkipNode* curr[MAX_LEVEL + 1]{};
+
+		ebr.start(THREAD_ID);
+		int foundLevel{ find(value, pred, curr) };
+		if (foundLevel == -1) { ebr.end(THREAD_ID); return false; }
+
+		SkipNode* target{ curr[foundLevel] };
+		if (target->isRemoved.load(memory_order_relaxed) || !target->isLinkFinished.load(memory_order_acquire) || target->topLevel != foundLevel)
+		{
+			ebr.end(THREAD_ID);
+			return false;
+		}
+
+		target->lock();
+		if (target->isRemoved.load(memory_order_relaxed)) { target->unlock(); ebr.end(THREAD_ID); return false; }
+		target->isRemoved.store(true, memory_order_relaxed);
+
+		while (true)
+		{
+			int curLevel{};
+			bool isValid{ true };
+			for (curLevel = 0; curLevel <= MAX_LEVEL; ++curLevel)
+			{
+				pred[curLevel]->lock();
+				isValid = !pred[curLevel]->isRemoved.load(memory_order_relaxed) && curr[curLevel] == pred[curLevel]->next[curLevel].load(memory_order_relaxed);
+				if (!isValid) break;
+			}
+
+			if (!isValid)
+			{
+				for (int i = 0; i <= curLevel; ++i) pred[i]->unlock();
+				find(value, pred, curr);
+				continue;
+			}
+
+			for (int i = curr[0]->topLevel; i >= 0; --i) pred[i]->next[i].store(curr[0]->next[i].load(memory_order_relaxed), memory_order_release);
+
+			for (int i = 0; i <= MAX_LEVEL; ++i) pred[i]->unlock();
+			target->unlock();
+			skipStats.onRemove(THREAD_ID);
+			ebr.retire(THREAD_ID, target);
+			ebr.end(THREAD_ID);
+			return true;
+		}
+	}
+	bool contain(int value)
+	{
+		SkipNode* pred[MAX_LEVEL + 1]{};
+		SkipNode* curr[MAX_LEVEL + 1]{};
+
+		ebr.start(THREAD_ID);
+		int foundLevel{ find(value, pred, curr) };
+		bool result{ foundLevel != -1 && curr[foundLevel]->isLinkFinished.load(memory_order_acquire) && !curr[foundLevel]->isRemoved.load(memory_order_relaxed) };
+		ebr.end(THREAD_ID);
+		return result;
+	}
+	void printElement(int count)
+	{
+		SkipNode* cur{ head.next[0].load() };
+		for (int i = 0; i < count; ++i)
+		{
+			if (&tail == cur)
+				break;
+			cout << cur->key << " ";
+			cur = cur->next[0].load();
+		}
+		cout << endl;
+	}
+};
+
+
+constexpr int NODE_SIZE{ 512 };		// 노드 크기(바이트). 캐시 라인의 배수
+
+// | version(63) | locked(1) |
+class OptLock
+{
+private:
+	atomic<uint64_t> version{};
+public:
+	// 잠겨있지 않은 버전을 읽는다. 잠겨있으면 false -> 같은 노드를 다시 읽는다.
+	bool readLock(uint64_t* readVersion)
+	{
+		*readVersion = version.load(memory_order_acquire);
+		if (!(*readVersion & 1)) return true;
+		this_thread::yield();
+		return false;
+	}
+	// readVersion을 읽은 뒤로 아무도 노드를 바꾸지 않았는가?
+	bool validate(uint64_t readVersion)
+	{
+		atomic_thread_fence(memory_order_acquire);		// 노드를 읽은 것이 버전을 다시 읽기 전에 끝나야 한다.
+		return version.load(memory_order_relaxed) == readVersion;
+	}
+	// readVersion 그대로라면 잠근다. 성공하면 readVersion은 잠근 버전이 된다.
+	bool upgrade(uint64_t* readVersion)
+	{
+		uint64_t expected{ *readVersion };
+		if (!version.compare_exchange_strong(expected, expected + 1, memory_order_acquire, memory_order_relaxed))
+		{
+			this_thread::yield();
+			return false;
+		}
+		atomic_thread_fence(memory_order_release);		// 잠근 것이 노드를 고치기 전에 보여야 한다.
+		++*readVersion;
+		return true;
+	}
+	void unlock() { version.fetch_add(1, memory_order_release); }
+};
+
+class BNode
+{
+public:
+	OptLock lock{};
+	atomic<BNode*> next{};				// 같은 높이의 오른쪽 노드 (B-link)
+	atomic<int> count{};				// 키 수
+	atomic<int> highKey{ INT_MAX };		// 이 노드가 담는 키의 상한. 이보다 큰 키는 next 쪽에 있다.
+	int level{};						// leaf는 0. 만든 뒤로 바뀌지 않는다.
+public:
+	BNode() = default;
+	BNode(int height) { level = height; }
+	~BNode() = default;
+
+	bool isLeaf() const { return 0 == level; }
+};
+
+class alignas(64) Leaf : public BNode
+{
+public:
+	static constexpr int CAPACITY{ static_cast<int>((NODE_SIZE - sizeof(BNode)) / sizeof(int)) };
+public:
+	atomic<int> keys[CAPACITY]{};
+public:
+	Leaf() : BNode{ 0 } {}
+	~Leaf() = default;
+
+	bool isFull() { return CAPACITY == count.load(memory_order_relaxed); }
+	// key 이상인 첫 키의 위치
+	int lowerBound(int key)
+	{
+		int low{}, high{ count.load(memory_order_relaxed) };
+		while (low < high)
+		{
+			int mid{ (low + high) / 2 };
+			if (keys[mid].load(memory_order_relaxed) < key) low = mid + 1;
+			else high = mid;
+		}
+		return low;
+	}
+	bool find(int key)
+	{
+		int pos{ lowerBound(key) };
+		return pos < count.load(memory_order_relaxed) && keys[pos].load(memory_order_relaxed) == key;
+	}
+	// 아래 함수는 잠근 뒤에만 호출한다.
+	bool insert(int key)
+	{
+		int pos{ lowerBound(key) }, cnt{ count.load(memory_order_relaxed) };
+		if (pos < cnt && keys[pos].load(memory_order_relaxed) == key) return false;
+		for (int i = cnt; i > pos; --i) keys[i].store(keys[i - 1].load(memory_order_relaxed), memory_order_relaxed);
+		keys[pos].store(key, memory_order_relaxed);
+		count.store(cnt + 1, memory_order_relaxed);
+		return true;
+	}
+	bool remove(int key)
+	{
+		int pos{ lowerBound(key) }, cnt{ count.load(memory_order_relaxed) };
+		if (pos == cnt || keys[pos].load(memory_order_relaxed) != key) return false;
+		for (int i = pos; i < cnt - 1; ++i) keys[i].store(keys[i + 1].load(memory_order_relaxed), memory_order_relaxed);
+		count.store(cnt - 1, memory_order_relaxed);
+		return true;
+	}
+	// 뒤쪽 절반을 새 오른쪽 leaf로 옮기고, 이 leaf의 마지막 키(separator)를 새 highKey로 삼아 반환한다.
+	Leaf* split(int* separator)
+	{
+		Leaf* right{ new Leaf{} };
+		int cnt{ count.load(memory_order_relaxed) }, half{ cnt / 2 };
+		for (int i = half; i < cnt; ++i) right->keys[i - half].store(keys[i].load(memory_order_relaxed), memory_order_relaxed);
+		right->count.store(cnt - half, memory_order_relaxed);
+		right->highKey.store(highKey.load(memory_order_relaxed), memory_order_relaxed);
+		right->next.store(next.load(memory_order_relaxed), memory_order_relaxed);
+		*separator = keys[half - 1].load(memory_order_relaxed);
+		next.store(right, memory_order_relaxed);
+		highKey.store(*separator, memory_order_relaxed);
+		count.store(half, memory_order_relaxed);
+		return right;
+	}
+};
+
+class alignas(64) Inner : public BNode
+{
+public:
+	static constexpr int CAPACITY{ static_cast<int>((NODE_SIZE - sizeof(BNode) - sizeof(void*)) / (sizeof(int) + sizeof(void*))) };
+public:
+	atomic<int> keys[CAPACITY]{};
+	atomic<BNode*> children[CAPACITY + 1]{};
+public:
+	Inner(int height) : BNode{ height } {}
+	~Inner() = default;
+
+	bool isFull() { return CAPACITY == count.load(memory_order_relaxed); }
+	int lowerBound(int key)
+	{
+		int low{}, high{ count.load(memory_order_relaxed) };
+		while (low < high)
+		{
+			int mid{ (low + high) / 2 };
+			if (keys[mid].load(memory_order_relaxed) < key) low = mid + 1;
+			else high = mid;
+		}
+		return low;
+	}
+	BNode* child(int key) { return children[lowerBound(key)].load(memory_order_relaxed); }
+	// 아래 함수는 잠근 뒤에만 호출한다.
+	// 나뉜 자식의 오른쪽 노드(right)를 separator 오른쪽에 끼운다.
+	void insert(int separator, BNode* right)
+	{
+		int pos{ lowerBound(separator) }, cnt{ count.load(memory_order_relaxed) };
+		for (int i = cnt; i > pos; --i)
+		{
+			keys[i].store(keys[i - 1].load(memory_order_relaxed), memory_order_relaxed);
+			children[i + 1].store(children[i].load(memory_order_relaxed), memory_order_relaxed);
+		}
+		keys[pos].store(separator, memory_order_relaxed);
+		children[pos + 1].store(right, memory_order_relaxed);
+		count.store(cnt + 1, memory_order_relaxed);
+	}
+	// 가운데 키를 separator로 올려 새 highKey로 삼고, 그 오른쪽 키와 자식을 새 노드로 옮긴다.
+	Inner* split(int* separator)
+	{
+		Inner* right{ new Inner{ level } };
+		int cnt{ count.load(memory_order_relaxed) }, half{ cnt / 2 };
+		for (int i = half + 1; i < cnt; ++i) right->keys[i - half - 1].store(keys[i].load(memory_order_relaxed), memory_order_relaxed);
+		for (int i = half + 1; i <= cnt; ++i) right->children[i - half - 1].store(children[i].load(memory_order_relaxed), memory_order_relaxed);
+		right->count.store(cnt - half - 1, memory_order_relaxed);
+		right->highKey.store(highKey.load(memory_order_relaxed), memory_order_relaxed);
+		right->next.store(next.load(memory_order_relaxed), memory_order_relaxed);
+		*separator = keys[half].load(memory_order_relaxed);
+		next.store(right, memory_order_relaxed);
+		highKey.store(*separator, memory_order_relaxed);
+		count.store(half, memory_order_relaxed);
+		return right;
+	}
+};
+
+constexpr int MAX_HEIGHT{ 16 };		// 트리 높이의 상한. 내부 노드는 자식이 20개 이상이므로 키 2^31개도 8층이면 담는다.
+
+NodeStats<MAX_THREADS> treeStats{};
+
+class BLinkTree
+{
+private:
+	atomic<BNode*> root{};
+public:
+	BLinkTree() { root = newLeaf(); }
+	~BLinkTree() { clear(); delete static_cast<Leaf*>(root.load()); }
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void clear()
+	{
+		// 높이마다 맨 왼쪽 노드에서 next를 따라가며 지운다.
+		BNode* leftmost{ root.load() };
+		while (leftmost)
+		{
+			BNode* below{ leftmost->isLeaf() ? nullptr : static_cast<Inner*>(leftmost)->children[0].load() };
+			for (BNode* node = leftmost; node;)
+			{
+				BNode* next{ node->next.load() };
+				if (node->isLeaf()) delete static_cast<Leaf*>(node);
+				else delete static_cast<Inner*>(node);
+				treeStats.onRemove(THREAD_ID);
+				treeStats.onFree(THREAD_ID);
+				node = next;
+			}
+			leftmost = below;
+		}
+		root = newLeaf();
+	}
+	Leaf* newLeaf()
+	{
+		treeStats.onAlloc(THREAD_ID);
+		return new Leaf{};
+	}
+
+	bool add(int key)
+	{
+		Inner* path[MAX_HEIGHT]{};		// 높이마다 지나온 내부 노드 -> 나눈 뒤 부모를 찾을 때 여기서부터 오른쪽으로 간다.
+		uint64_t version{};
+		BNode* node{ descend(root.load(memory_order_acquire), key, 0, &version, path) };
+		while (!node->lock.upgrade(&version)) node = descend(node, key, 0, &version, nullptr);
+
+		Leaf* leaf{ static_cast<Leaf*>(node) };
+		if (!leaf->isFull() || leaf->find(key))
+		{
+			bool result{ leaf->insert(key) };
+			leaf->lock.unlock();
+			return result;
+		}
+
+		int separator{};
+		Leaf* right{ leaf->split(&separator) };
+		treeStats.onAlloc(THREAD_ID);
+		if (key > separator) right->insert(key);
+		else leaf->insert(key);
+		// right는 leaf를 풀기 전까지 아무도 볼 수 없으므로, 잠그지 않고 바꿔도 된다.
+		bool isRoot{ leaf == root.load(memory_order_relaxed) };
+		if (isRoot) growRoot(leaf, separator, right);
+		leaf->lock.unlock();
+		if (!isRoot) post(1, separator, right, path);
+		return true;
+	}
+	bool remove(int key)
+	{
+		uint64_t version{};
+		BNode* node{ descend(root.load(memory_order_acquire), key, 0, &version, nullptr) };
+		while (!node->lock.upgrade(&version)) node = descend(node, key, 0, &version, nullptr);
+
+		Leaf* leaf{ static_cast<Leaf*>(node) };
+		bool result{ leaf->remove(key) };
+		leaf->lock.unlock();
+		return result;
+	}
+	bool contain(int key)
+	{
+		uint64_t version{};
+		BNode* node{ descend(root.load(memory_order_acquire), key, 0, &version, nullptr) };
+		while (true)
+		{
+			bool result{ static_cast<Leaf*>(node)->find(key) };
+			if (node->lock.validate(version)) return result;
+			node = descend(node, key, 0, &version, nullptr);		// 처음부터가 아니라 이 leaf에서 다시 찾는다.
+		}
+	}
+	// [low, high) 범위의 키를 작은 것부터 최대 limit개까지 keys에 담고 그 수를 반환한다.
+	int scan(int low, int high, vector<int>* keys, size_t limit = SIZE_MAX)
+	{
+		int buffer[Leaf::CAPACITY]{};
+		keys->clear();
+		if (low >= high) return 0;
+
+		uint64_t version{};
+		BNode* node{ descend(root.load(memory_order_acquire), low, 0, &version, nullptr) };
+		while (true)
+		{
+			// leaf 하나를 읽고 확인한 뒤에만 결과에 넣는다. 실패하면 이 leaf에서 low를 다시 찾는다.
+			Leaf* leaf{ static_cast<Leaf*>(node) };
+			int cnt{ leaf->count.load(memory_order_relaxed) }, num{};
+			for (int i = leaf->lowerBound(low); i < cnt; ++i)
+			{
+				int key{ leaf->keys[i].load(memory_order_relaxed) };
+				if (key >= high) break;
+				buffer[num++] = key;
+			}
+			int highKey{ leaf->highKey.load(memory_order_relaxed) };
+			BNode* next{ leaf->next.load(memory_order_relaxed) };
+			if (!leaf->lock.validate(version))
+			{
+				node = descend(leaf, low, 0, &version, nullptr);
+				continue;
+			}
+
+			keys->insert(keys->end(), buffer, buffer + num);
+			if (keys->size() >= limit)
+			{
+				keys->resize(limit);
+				return static_cast<int>(limit);
+			}
+			// 다음 leaf는 highKey보다 큰 키부터 담는다.
+			if (highKey >= high - 1) return static_cast<int>(keys->size());
+			low = highKey + 1;
+			node = descend(next, low, 0, &version, nullptr);
+		}
+	}
+	void printElement(int count)
+	{
+		vector<int> keys{};
+		scan(INT_MIN, INT_MAX, &keys, count);
+		for (int i = 0; i < count && i < static_cast<int>(keys.size()); ++i) cout << keys[i] << " ";
+		cout << endl;
+	}
+private:
+	// node에서 출발해 key를 담는 level 높이의 노드를 찾고, 그 버전을 version에 담는다. path가 있으면 지나온 내부 노드를 적는다.
+	// key > highKey이면 그 사이에 노드가 나뉜 것이므로 오른쪽으로 간다. (move right) -> 처음부터 다시 내려가지 않는다.
+	// 반환한 노드는 아직 확인하지 않았다. 호출한 쪽이 validate나 upgrade로 확인한다.
+	BNode* descend(BNode* node, int key, int level, uint64_t* version, Inner** path)
+	{
+		while (true)
+		{
+			while (!node->lock.readLock(version));
+			if (key > node->highKey.load(memory_order_relaxed))
+			{
+				BNode* next{ node->next.load(memory_order_relaxed) };
+				if (node->lock.validate(*version)) node = next;
+				continue;
+			}
+			if (node->level == level) return node;
+
+			Inner* inner{ static_cast<Inner*>(node) };
+			BNode* child{ inner->child(key) };
+			if (!inner->lock.validate(*version)) continue;
+			if (path) path[inner->level] = inner;
+			node = child;
+		}
+	}
+	// level - 1 높이에서 나뉜 노드의 separator와 오른쪽 노드(right)를 level 높이의 부모에 끼운다.
+	// 나눈 노드를 푼 뒤에 부모 하나만 잠근다. 부모가 가득 찼으면 부모를 나누고, 그 separator를 한 층 위에 끼운다.
+	void post(int level, int separator, BNode* right, Inner** path)
+	{
+		while (true)
+		{
+			// 지나온 부모가 없으면(내려올 때 root가 더 낮았으면) root에서 찾는다. 부모의 왼쪽 경계는 바뀌지 않으므로 오른쪽으로만 가면 된다.
+			BNode* start{ path[level] ? static_cast<BNode*>(path[level]) : root.load(memory_order_acquire) };
+			uint64_t version{};
+			BNode* node{ descend(start, separator, level, &version, nullptr) };
+			while (!node->lock.upgrade(&version)) node = descend(node, separator, level, &version, nullptr);
+
+			Inner* parent{ static_cast<Inner*>(node) };
+			if (!parent->isFull())
+			{
+				parent->insert(separator, right);
+				parent->lock.unlock();
+				return;
+			}
+
+			int upper{};
+			Inner* sibling{ parent->split(&upper) };
+			treeStats.onAlloc(THREAD_ID);
+			if (separator > upper) sibling->insert(separator, right);
+			else parent->insert(separator, right);
+			bool isRoot{ parent == root.load(memory_order_relaxed) };
+			if (isRoot) growRoot(parent, upper, sibling);
+			parent->lock.unlock();
+			if (isRoot) return;
+
+			separator = upper;
+			right = sibling;
+			++level;
+		}
+	}
+	// 나뉜 root 위에 새 root를 올린다. root를 잠근 채로 호출한다. -> root를 바꿀 수 있는 스레드는 하나뿐이다.
+	void growRoot(BNode* node, int separator, BNode* right)
+	{
+		Inner* newRoot{ new Inner{ node->level + 1 } };
+		treeStats.onAlloc(THREAD_ID);
+		newRoot->keys[0].store(separator, memory_order_relaxed);
+		newRoot->children[0].store(node, memory_order_relaxed);
+		newRoot->children[1].store(right, memory_order_relaxed);
+		newRoot->count.store(1, memory_order_relaxed);
+		root.store(newRoot, memory_order_release);
+	}
+};
+
+static_assert(sizeof(Leaf) % 64 == 0 && sizeof(Inner) % 64 == 0, "node size must be a multiple of the cache line");
+
+constexpr int NUM_TEST{ 4000000 };
+constexpr int PREFILL_LIMIT{ 1 << 22 };		// 미리 넣는 키 수의 상한 -> 10^8의 절반을 넣으면 스킵리스트만 6GB가 넘는다.
+constexpr int SCAN_RANGE{ 1000 };			// scan 한번이 훑는 키 범위
+
+SkipList lst;
+BLinkTree tree;
+
+template <class Set>
+void ThreadFunc(Set* set, int keyRange, int numOfThread, int threadID)
+{
+	XorShift rng{ static_cast<unsigned>(threadID + 1) };
+
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		unsigned r{ rng.next() };
+		int key{ static_cast<int>((r >> 2) % keyRange) };
+		switch (r % 3) {
+		case 0: set->add(key); break;
+		case 1: set->remove(key); break;
+		case 2: set->contain(key); break;
+		default: cout << "Error\n";
+			exit(-1);
+		}
+	}
+}
+
+atomic<long long> scans{}, scannedKeys{};
+
+// contain 대신 SCAN_RANGE 범위의 scan을 한다.
+void ScanThreadFunc(int keyRange, int numOfThread, int threadID)
+{
+	XorShift rng{ static_cast<unsigned>(threadID + 1) };
+	vector<int> keys{};
+	long long count{}, scanned{};
+
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		unsigned r{ rng.next() };
+		int key{ static_cast<int>((r >> 2) % keyRange) };
+		switch (r % 3) {
+		case 0: tree.add(key); break;
+		case 1: tree.remove(key); break;
+		case 2: scanned += tree.scan(key, key + SCAN_RANGE, &keys); ++count; break;
+		default: cout << "Error\n";
+			exit(-1);
+		}
+	}
+	scans += count;
+	scannedKeys += scanned;
+}
+
+// 넣은 키 수를 반환한다. 키 범위의 절반이지만 PREFILL_LIMIT를 넘지 않는다.
+template <class Set>
+int prefill(Set* set, int keyRange)
+{
+	XorShift rng{ static_cast<unsigned>(keyRange) };
+	int target{ min(keyRange / 2, PREFILL_LIMIT) };
+
+	THREAD_ID = 0;
+	set->clear();
+	for (int added = 0; added < target;) if (set->add(static_cast<int>((rng.next() >> 2) % keyRange))) ++added;
+	return target;
+}
+
+template <class Set, class Func, int MAX_THREADS>
+void benchmark(Set* set, Func func, NodeStats<MAX_THREADS>* stats)
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	for (int i = 1; i <= MAX_THREADS; i *= 2)
+	{
+		threads.clear();
+
+		size_t startMemory{ getResidentMemory() };
+		sampler.start();
+		auto start{ high_resolution_clock::now() };
+
+		for (int j = 0; j < i; ++j) threads.emplace_back(func, i, j);
+		for (auto& thread : threads) thread.join();
+		sampler.stop();
+
+		set->printElement(20);
+
+		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		size_t endMemory{ getResidentMemory() };
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << "Throughput = " << static_cast<long long>(NUM_TEST / seconds) << " ops/sec, ";
+		cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB)\n";
+		stats->print();
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+	}
+}
+
+int main()
+{
+	stressSet(MAX_THREADS, STRESS_OPS, STRESS_KEY_RANGE,
+		[](int threadID, int key) { THREAD_ID = threadID; return tree.add(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return tree.remove(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return tree.contain(key); });
+
+	// 스트레스 테스트가 끝난 트리를 scan해서 정렬되어 있고 contain과 일치하는지 확인
+	{
+		vector<int> keys{};
+		int errors{}, expected{};
+		tree.scan(0, STRESS_KEY_RANGE, &keys);
+		for (int key = 0; key < STRESS_KEY_RANGE; ++key) if (tree.contain(key)) ++expected;
+		for (size_t i = 0; i < keys.size(); ++i)
+			if ((i && keys[i - 1] >= keys[i]) || !tree.contain(keys[i])) ++errors;
+		if (static_cast<int>(keys.size()) != expected) ++errors;
+		cout << "[Stress Test] scan: " << (errors ? "FAILED" : "OK") << " (errors = " << errors << ")\n";
+	}
+
+	for (int keyRange : { 1000000, 10000000, 100000000 })
+	{
+		int keys{ prefill(&lst, keyRange) };
+		cout << "[SkipList] keys = " << keys << " (range " << keyRange << "), node = " << sizeof(SkipNode) << " bytes\n";
+		benchmark(&lst, [keyRange](int numOfThread, int threadID) { ThreadFunc(&lst, keyRange, numOfThread, threadID); }, &skipStats);
+		lst.clear();
+
+		prefill(&tree, keyRange);
+		cout << "[BLinkTree] keys = " << keys << " (range " << keyRange << "), node = " << NODE_SIZE << " bytes (leaf " << Leaf::CAPACITY << " keys, inner " << Inner::CAPACITY << " keys)\n";
+		benchmark(&tree, [keyRange](int numOfThread, int threadID) { ThreadFunc(&tree, keyRange, numOfThread, threadID); }, &treeStats);
+
+		scans = scannedKeys = 0;
+		cout << "[BLinkTree + Scan] keys = " << keys << " (range " << keyRange << "), scan range = " << SCAN_RANGE << "\n";
+		benchmark(&tree, [keyRange](int numOfThread, int threadID) { ScanThreadFunc(keyRange, numOfThread, threadID); }, &treeStats);
+		cout << "\tScan: " << scans << " scans, avg = " << static_cast<double>(scannedKeys) / max(scans.load(), 1LL) << " keys\n";
+		tree.clear();
+	}
+}
@@ -0,0 +1,628 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <bitset>
+#include <climits>
+#include <cstdint>
+#include "ebr.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
+#include "node_pool.h"
+
+// x64는 항상 SSE2를 지원한다. 그 밖의 환경에서는 키를 하나씩 비교한다.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	게으른동기화(unrolled list)
+
+	1. 노드 하나(64바이트, 캐시 라인 하나)에 정렬된 키를 CAPACITY(13)개까지 담는다. -> 순회하며 지나가는 노드 수(캐시 미스)가 키 수 / 노드당 키 수로 줄어든다.
+	   - 노드는 (이전 노드의 fence, fence] 범위의 키를 담는다. 마지막 노드의 fence는 INT_MAX
+	   - 빈 칸은 INT_MAX로 채워둔다. -> 키 수를 따로 두지 않아도 되고, 노드 안의 검색은 빈 칸까지 한번에 비교한다.
+	2. 노드 안의 검색은 SSE2로 키 4개씩 비교한다. (작은 키 수 = 들어갈 위치, 같은 키 = 있는지)
+	3. marked 대신 노드마다 버전(OptLock)을 둔다. 쓰는 스레드는 버전을 홀수로 만들어 잠그고, 풀면서 짝수로 올린다.
+	   - contains는 락을 잡지 않는다. 버전을 읽고, 노드를 읽고, 버전이 그대로인지 확인한다. 다르면 처음부터 다시
+	   - 다음 노드로 넘어갈 때는 다음 노드의 버전을 읽은 뒤에 지금 노드를 다시 확인한다. (optimistic lock coupling)
+	4. add, remove는 키가 들어갈 노드 하나만 잠근다.
+	   - 가득 찬 노드에 넣으면 잠근 채로 반을 새 노드로 나눈다. 새 노드는 잠근 노드를 거쳐야만 보이므로 잠글 필요가 없다.
+	   - 지우고 나서 다음 노드와 합쳐도 MERGE_SIZE 이하라면 다음 노드도 잠그고 합친다. (항상 왼쪽에서 오른쪽 순서로 잠근다.)
+	   - 합쳐진 오른쪽 노드는 잠근 채로 둔다. -> 그 노드를 읽던 스레드는 다시 시작하고, EBR이 안전해진 뒤에 풀에 돌려준다.
+	5. 노드에 인덱스를 둘 자리가 없으므로 next는 32비트 인덱스이고 해제할 때는 주소에서 인덱스를 구한다.
+
+	※ SIMD 검색은 atomic 키 배열을 16바이트씩 한번에 읽는다. 도중에 바뀐 값을 읽을 수 있지만 버전 확인에서 버린다. (seqlock)
+	※ 4.게으른동기화.cpp의 리스트(노드당 키 하나)와 순회한 노드 수, 처리량을 비교한다.
+*/
+
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+thread_local long long VISITS{};	// 스레드가 지나간 노드 수
+
+constexpr int CAPACITY{ 13 };				// 노드당 키 수 -> 키 + fence + 버전 + next = 64바이트
+constexpr int MERGE_SIZE{ CAPACITY * 2 / 3 };	// 합친 노드가 이보다 크면 합치지 않는다. -> 합치자마자 다시 나누지 않도록
+constexpr int EMPTY_KEY{ INT_MAX };		// 빈 칸. 실제 키는 INT_MAX보다 작아야 한다.
+
+// 4.게으른동기화.cpp의 리스트 (노드당 키 하나, 순회한 노드 수만 센다.)
+class alignas(64) LazyNode
+{
+private:
+	mutex mtx{};
+public:
+	int key{};
+	atomic<bool> marked{};
+	atomic<uint32_t> next{};
+public:
+	LazyNode() = default;
+	LazyNode(int value) { key = value; }
+	~LazyNode() = default;
+
+	void lock() { mtx.lock(); }
+	void unlock() { mtx.unlock(); }
+};
+
+NodePool<LazyNode, MAX_THREADS> lazyPool{};
+NodeStats<MAX_THREADS> lazyStats{};
+
+class LazyList
+{
+	LazyNode* head{}, * tail{};
+	uint32_t tailIndex{};
+public:
+	LazyList()
+	{
+		head = lazyPool.get(newNode(0x80000000));
+		tailIndex = newNode(0x7FFFFFFF);
+		tail = lazyPool.get(tailIndex);
+		head->next.store(tailIndex, memory_order_relaxed);
+	}
+	~LazyList() {}
+
+	void init()
+	{
+		uint32_t ptr{};
+		while (head->next.load(memory_order_relaxed) != tailIndex)
+		{
+			ptr = head->next.load(memory_order_relaxed);
+			head->next.store(lazyPool.get(ptr)->next.load(memory_order_relaxed), memory_order_relaxed);
+			lazyPool.free(THREAD_ID, ptr);
+			lazyStats.onRemove(THREAD_ID);
+			lazyStats.onFree(THREAD_ID);
+		}
+	}
+	uint32_t newNode(int key)
+	{
+		uint32_t index{ lazyPool.alloc(THREAD_ID) };
+		lazyStats.onAlloc(THREAD_ID);
+		LazyNode* node{ lazyPool.get(index) };
+		node->key = key;
+		node->marked.store(false, memory_order_relaxed);
+		return index;
+	}
+	bool add(int key)
+	{
+		while (true)
+		{
+			LazyNode* pred{ head };
+			LazyNode* curr{ nextOf(pred) };
+
+			while (curr->key < key)
+			{
+				pred = curr;
+				curr = nextOf(curr);
+			}
+
+			pred->lock();
+			curr->lock();
+
+			if (valid(pred, curr))
+			{
+				if (key == curr->key)
+				{
+					pred->unlock();
+					curr->unlock();
+					return false;
+				}
+				else
+				{
+					uint32_t node{ newNode(key) };
+					lazyPool.get(node)->next.store(pred->next.load(memory_order_relaxed), memory_order_relaxed);
+					pred->next.store(node, memory_order_release);
+
+					pred->unlock();
+					curr->unlock();
+					return true;
+				}
+			}
+			else
+			{
+				pred->unlock();
+				curr->unlock();
+			}
+		}
+	}
+	bool remove(int key)
+	{
+		while (true)
+		{
+			LazyNode* pred{ head };
+			LazyNode* curr{ nextOf(pred) };
+
+			while (curr->key < key)
+			{
+				pred = curr;
+				curr = nextOf(curr);
+			}
+
+			pred->lock();
+			curr->lock();
+
+			if (valid(pred, curr))
+			{
+				if (key == curr->key)
+				{
+					curr->marked.store(true, memory_order_relaxed);
+					pred->next.store(curr->next.load(memory_order_relaxed), memory_order_release);
+					pred->unlock();
+					curr->unlock();
+					lazyStats.onRemove(THREAD_ID);
+					return true;
+				}
+				else
+				{
+					pred->unlock();
+					curr->unlock();
+					return false;
+				}
+			}
+			else
+			{
+				pred->unlock();
+				curr->unlock();
+			}
+		}
+	}
+	bool contains(int key)
+	{
+		LazyNode* node{ nextOf(head) };
+		while (node->key < key) node = nextOf(node);
+		return node->key == key && !node->marked.load(memory_order_relaxed);
+	}
+	LazyNode* nextOf(LazyNode* node)
+	{
+		++VISITS;
+		return lazyPool.get(node->next.load(memory_order_acquire));
+	}
+	bool valid(LazyNode* pred, LazyNode* curr)
+	{
+		return !pred->marked.load(memory_order_relaxed) && !curr->marked.load(memory_order_relaxed) && nextOf(pred) == curr;
+	}
+	void printElement(int count)
+	{
+		LazyNode* node{ nextOf(head) };
+		for (int i = 0; i < count; ++i)
+		{
+			if (tail == node) break;
+			cout << node->key << " ";
+			node = nextOf(node);
+		}
+		cout << "\n";
+	}
+};
+
+// 31.낙천적동기화(blink_tree).cpp의 OptLock을 노드 크기에 맞춰 32비트로 줄였다.
+class OptLock
+{
+private:
+	atomic<uint32_t> version{};
+public:
+	// 잠겨있지 않은 버전을 읽는다. 잠겨있으면 false -> 처음부터 다시
+	bool readLock(uint32_t* readVersion)
+	{
+		*readVersion = version.load(memory_order_acquire);
+		if (!(*readVersion & 1)) return true;
+		this_thread::yield();
+		return false;
+	}
+	// readVersion을 읽은 뒤로 아무도 노드를 바꾸지 않았는가?
+	bool validate(uint32_t readVersion)
+	{
+		atomic_thread_fence(memory_order_acquire);		// 노드를 읽은 것이 버전을 다시 읽기 전에 끝나야 한다.
+		return version.load(memory_order_relaxed) == readVersion;
+	}
+	// readVersion 그대로라면 잠근다.
+	bool upgrade(uint32_t readVersion)
+	{
+		if (!version.compare_exchange_strong(readVersion, readVersion + 1, memory_order_acquire, memory_order_relaxed))
+		{
+			this_thread::yield();
+			return false;
+		}
+		atomic_thread_fence(memory_order_release);		// 잠근 것이 노드를 고치기 전에 보여야 한다.
+		return true;
+	}
+	void unlock() { version.fetch_add(1, memory_order_release); }
+	// 합쳐져서 잠긴 채로 풀에 돌아온 노드를 다시 쓸 때 푼다. 버전은 줄어들지 않는다.
+	void reset()
+	{
+		uint32_t current{ version.load(memory_order_relaxed) };
+		if (current & 1) version.store(current + 1, memory_order_relaxed);
+	}
+};
+
+class alignas(64) Node
+{
+public:
+	atomic<int> keys[CAPACITY];		// 정렬된 키, 빈 칸은 EMPTY_KEY
+	atomic<int> fence{};			// 이 노드가 담당하는 키의 상한
+	OptLock lock{};
+	atomic<uint32_t> next{};
+public:
+	Node() { clearKeys(); }
+	~Node() = default;
+
+	void clearKeys() { for (auto& key : keys) key.store(EMPTY_KEY, memory_order_relaxed); }
+	// key보다 작은 키 수(= key가 들어갈 위치)를 *position에 쓰고, key가 있는지 반환한다.
+	bool search(int key, int* position)
+	{
+#ifdef USE_SSE2
+		// keys, fence, 버전, next가 64바이트를 채우므로 16바이트씩 4번 읽고, 키가 아닌 3칸은 마스크로 버린다.
+		const __m128i* lanes{ reinterpret_cast<const __m128i*>(keys) };
+		__m128i target{ _mm_set1_epi32(key) };
+		unsigned less{}, equal{};
+		for (int i = 0; i < 4; ++i)
+		{
+			__m128i lane{ _mm_load_si128(lanes + i) };
+			less |= static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(lane, target)))) << (i * 4);
+			equal |= static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lane, target)))) << (i * 4);
+		}
+		*position = static_cast<int>(bitset<CAPACITY>(less).count());
+		return equal & ((1u << CAPACITY) - 1);
+#else
+		int count{};
+		bool found{};
+		for (auto& slot : keys)
+		{
+			int value{ slot.load(memory_order_relaxed) };
+			if (value < key) ++count;
+			if (value == key) found = true;
+		}
+		*position = count;
+		return found;
+#endif
+	}
+	// 잠근 노드에서만 호출한다.
+	int size()
+	{
+		int count{};
+		while (count < CAPACITY && EMPTY_KEY != keys[count].load(memory_order_relaxed)) ++count;
+		return count;
+	}
+};
+
+static_assert(sizeof(Node) == 64, "node must fit in one cache line");
+
+NodePool<Node, MAX_THREADS> pool{};
+NodeStats<MAX_THREADS> stats{};
+
+// EBR이 해제할 노드를 delete하는 대신 풀에 반환
+struct NodeDeleter
+{
+	void operator()(Node* node) const
+	{
+		pool.free(THREAD_ID, pool.indexOf(node));
+		stats.onFree(THREAD_ID);
+	}
+};
+
+class List
+{
+	Node* head{};		// 첫 노드. 항상 왼쪽 노드로 남으므로 합쳐져서 사라지지 않는다.
+	EBR<Node, MAX_THREADS, NodeDeleter> ebr{};
+public:
+	List()
+	{
+		head = pool.get(newNode());
+		head->fence.store(EMPTY_KEY, memory_order_relaxed);
+		head->next.store(NIL, memory_order_relaxed);
+	}
+	~List() {}
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void init()
+	{
+		uint32_t ptr{};
+		while (NIL != (ptr = head->next.load(memory_order_relaxed)))
+		{
+			head->next.store(pool.get(ptr)->next.load(memory_order_relaxed), memory_order_relaxed);
+			pool.free(THREAD_ID, ptr);
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
+		}
+		head->clearKeys();
+		head->fence.store(EMPTY_KEY, memory_order_relaxed);
+		ebr.clear();
+	}
+	uint32_t newNode()
+	{
+		uint32_t index{ pool.alloc(THREAD_ID) };
+		stats.onAlloc(THREAD_ID);
+		Node* node{ pool.get(index) };
+		node->lock.reset();
+		node->clearKeys();
+		return index;
+	}
+	bool add(int key)
+	{
+		ebr.start(THREAD_ID);
+		while (true)
+		{
+			uint32_t version{};
+			Node* node{ find(key, &version) };
+			if (!node->lock.upgrade(version)) continue;
+
+			int position{};
+			if (node->search(key, &position))
+			{
+				node->lock.unlock();
+				ebr.end(THREAD_ID);
+				return false;
+			}
+
+			Node* target{ node };
+			if (CAPACITY == node->size())
+			{
+				Node* right{ split(node) };
+				if (key > node->fence.load(memory_order_relaxed))
+				{
+					target = right;
+					right->search(key, &position);
+				}
+			}
+			insert(target, key, position);
+
+			node->lock.unlock();
+			ebr.end(THREAD_ID);
+			return true;
+		}
+	}
+	bool remove(int key)
+	{
+		ebr.start(THREAD_ID);
+		while (true)
+		{
+			uint32_t version{};
+			Node* node{ find(key, &version) };
+			if (!node->lock.upgrade(version)) continue;
+
+			int position{};
+			if (!node->search(key, &position))
+			{
+				node->lock.unlock();
+				ebr.end(THREAD_ID);
+				return false;
+			}
+
+			int count{ node->size() };
+			for (int i = position; i < count - 1; ++i)
+				node->keys[i].store(node->keys[i + 1].load(memory_order_relaxed), memory_order_relaxed);
+			node->keys[count - 1].store(EMPTY_KEY, memory_order_relaxed);
+
+			Node* merged{ mergeNext(node, count - 1) };
+			node->lock.unlock();
+			if (merged)
+			{
+				stats.onRemove(THREAD_ID);
+				ebr.retire(THREAD_ID, merged);
+			}
+			ebr.end(THREAD_ID);
+			return true;
+		}
+	}
+	bool contains(int key)
+	{
+		ebr.start(THREAD_ID);
+		while (true)
+		{
+			uint32_t version{};
+			int position{};
+			Node* node{ find(key, &version) };
+			bool result{ node->search(key, &position) };
+			if (!node->lock.validate(version)) continue;
+			ebr.end(THREAD_ID);
+			return result;
+		}
+	}
+	void printElement(int count)
+	{
+		for (Node* node{ head }; count; node = pool.get(node->next.load(memory_order_relaxed)))
+		{
+			for (int i = 0; i < CAPACITY && count; ++i)
+			{
+				int key{ node->keys[i].load(memory_order_relaxed) };
+				if (EMPTY_KEY == key) break;
+				cout << key << " ";
+				--count;
+			}
+			if (NIL == node->next.load(memory_order_relaxed)) break;
+		}
+		cout << "\n";
+	}
+	// 모든 스레드가 종료된 뒤에 키가 정렬되어 있고 각자 노드의 범위 안에 있는지 확인한다. 틀린 수를 반환
+	int check()
+	{
+		int errors{}, prev{ INT_MIN };
+		for (Node* node{ head }; ; node = pool.get(node->next.load(memory_order_relaxed)))
+		{
+			int fence{ node->fence.load(memory_order_relaxed) };
+			for (int i = 0; i < node->size(); ++i)
+			{
+				int key{ node->keys[i].load(memory_order_relaxed) };
+				if (key <= prev || key > fence || !contains(key)) ++errors;
+				prev = key;
+			}
+			if (prev > fence) ++errors;
+			prev = fence;
+			if (NIL == node->next.load(memory_order_relaxed)) return errors + (EMPTY_KEY != fence);
+		}
+	}
+private:
+	// key를 담당하는 노드를 락 없이 찾고 그 노드의 버전을 *readVersion에 쓴다. 노드를 읽은 뒤에 버전을 확인해야 한다.
+	Node* find(int key, uint32_t* readVersion)
+	{
+		while (true)
+		{
+			Node* node{ head };
+			uint32_t version{};
+			if (!node->lock.readLock(&version)) continue;
+			while (true)
+			{
+				++VISITS;
+				if (key <= node->fence.load(memory_order_relaxed))
+				{
+					*readVersion = version;
+					return node;
+				}
+
+				uint32_t next{ node->next.load(memory_order_relaxed) };
+				uint32_t nextVersion{};
+				if (NIL == next || !pool.get(next)->lock.readLock(&nextVersion) || !node->lock.validate(version)) break;
+				node = pool.get(next);
+				version = nextVersion;
+			}
+		}
+	}
+	// node의 위쪽 절반을 새 노드로 옮긴다. 새 노드는 잠근 node를 거쳐야만 보인다.
+	Node* split(Node* node)
+	{
+		constexpr int LEFT{ (CAPACITY + 1) / 2 };
+		uint32_t index{ newNode() };
+		Node* right{ pool.get(index) };
+
+		for (int i = LEFT; i < CAPACITY; ++i)
+		{
+			right->keys[i - LEFT].store(node->keys[i].load(memory_order_relaxed), memory_order_relaxed);
+			node->keys[i].store(EMPTY_KEY, memory_order_relaxed);
+		}
+		right->fence.store(node->fence.load(memory_order_relaxed), memory_order_relaxed);
+		right->next.store(node->next.load(memory_order_relaxed), memory_order_relaxed);
+		node->fence.store(node->keys[LEFT - 1].load(memory_order_relaxed), memory_order_relaxed);
+		node->next.store(index, memory_order_relaxed);
+		return right;
+	}
+	void insert(Node* node, int key, int position)
+	{
+		for (int i = node->size(); i > position; --i)
+			node->keys[i].store(node->keys[i - 1].load(memory_order_relaxed), memory_order_relaxed);
+		node->keys[position].store(key, memory_order_relaxed);
+	}
+	// 잠근 node에 키가 count개 남았을 때 다음 노드와 합친다. 합쳐서 떼어낸 노드를 반환 (잠긴 채로 남는다.)
+	Node* mergeNext(Node* node, int count)
+	{
+		uint32_t next{ node->next.load(memory_order_relaxed) };
+		if (NIL == next || count > MERGE_SIZE / 2) return nullptr;
+
+		// 다음 노드가 잠겨있거나 도중에 바뀌면 합치지 않는다. -> 기다리지 않는다.
+		Node* right{ pool.get(next) };
+		uint32_t version{};
+		if (!right->lock.readLock(&version)) return nullptr;
+		int rightCount{ right->size() };
+		if (count + rightCount > MERGE_SIZE || !right->lock.upgrade(version)) return nullptr;
+
+		for (int i = 0; i < rightCount; ++i)
+			node->keys[count + i].store(right->keys[i].load(memory_order_relaxed), memory_order_relaxed);
+		node->fence.store(right->fence.load(memory_order_relaxed), memory_order_relaxed);
+		node->next.store(right->next.load(memory_order_relaxed), memory_order_relaxed);
+		return right;
+	}
+};
+
+constexpr int NUM_TEST{ 4000000 };
+
+LazyList lazyList;
+List lst;
+
+atomic<long long> visits{};
+
+template <class Set>
+void ThreadFunc(Set* set, int keyRange, int numOfThread, int threadID)
+{
+	XorShift rng{ static_cast<unsigned>(threadID + 1) };
+
+	THREAD_ID = threadID;
+	VISITS = 0;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		unsigned r{ rng.next() };
+		int key{ static_cast<int>((r >> 2) % keyRange) };
+		switch (r % 3) {
+		case 0: set->add(key); break;
+		case 1: set->remove(key); break;
+		case 2: set->contains(key); break;
+		default: cout << "Error\n";
+			exit(-1);
+		}
+	}
+	visits += VISITS;
+}
+
+template <class Set, int MAX_THREADS>
+void benchmark(Set* set, NodeStats<MAX_THREADS>* stats, int keyRange)
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	for (int i = 1; i <= MAX_THREADS; i *= 2)
+	{
+		threads.clear();
+		set->init();
+		visits = 0;
+
+		sampler.start();
+		auto start{ high_resolution_clock::now() };
+
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc<Set>, set, keyRange, i, j);
+		for (auto& thread : threads) thread.join();
+		sampler.stop();
+
+		set->printElement(20);
+
+		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << "Throughput = " << static_cast<long long>(NUM_TEST / seconds) << " ops/sec\n";
+		stats->print();
+		cout << "\tVisits: avg = " << static_cast<double>(visits) / NUM_TEST << " nodes/op\n";
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+	}
+}
+
+int main()
+{
+	stressSet(MAX_THREADS, STRESS_OPS, STRESS_KEY_RANGE,
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.add(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.remove(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.contains(key); });
+
+	// 스트레스 테스트가 끝난 리스트의 키 순서와 노드 범위를 확인
+	int errors{ lst.check() };
+	cout << "[Stress Test] order: " << (errors ? "FAILED" : "OK") << " (errors = " << errors << ")\n";
+
+	// 4.게으른동기화.cpp의 키 범위(1000)와 그 10배에서 비교
+	for (int keyRange : { 1000, 10000 })
+	{
+		cout << "[LazyList] keys = " << keyRange << ", node = " << sizeof(LazyNode) << " bytes, 1 key\n";
+		benchmark(&lazyList, &lazyStats, keyRange);
+		cout << "[UnrolledList] keys = " << keyRange << ", node = " << sizeof(Node) << " bytes, " << CAPACITY << " keys\n";
+		benchmark(&lst, &stats, keyRange);
+	}
+}
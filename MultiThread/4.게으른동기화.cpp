@@ -1,30 +1,42 @@
 #include <iostream>
+#include <thread>
 #include <mutex>
 #include <atomic>
 #include <chrono>
 #include <vector>
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
+#include "node_pool.h"
 
 using namespace std;
 using namespace std::chrono;
 
 /*
-	ȭ
+	게으른동기화
 
-	1. õȭ ٸ ȿ ˻翡 Ʈ ȸ ʴ´.
-	2.  帶 Ʈ ŵǾ Ǻϴ ŷ ߰
+	1. 낙천전동기화와 다르게 유효성 검사에서 리스트를 순회하지 않는다.
+	2. 각 노드마다 리스트에서 제거되었는지 판별하는 마킹변수를 추가
 
-	 ŷ ŵۺ  ǾѴ.
-	  ޸  ߻
+	※ 마킹은 제거동작보다 먼저 실행되야한다.
+	※ 여전히 메모리 릭 발생
+
+	3. 노드는 NodePool에서 할당하고, next는 포인터 대신 32비트 인덱스로 가리킨다.
+	   -> 노드를 64바이트로 정렬해서 인덱스를 주소로 바꿀 때 곱셈 대신 시프트를 쓰고, 이웃 노드의 락과 캐시라인을 공유하지 않는다.
+	4. 락 없이 읽는 next, marked는 atomic으로 선언하고 필요한 만큼만 순서를 지정한다. (순회는 acquire, 연결은 release)
 */
 
-class Node
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+class alignas(64) Node
 {
 private:
 	mutex mtx{};
 public:
 	int key{};
-	bool marked{};
-	Node* next{};
+	atomic<bool> marked{};
+	atomic<uint32_t> next{};
 public:
 	Node() = default;
 	Node(int value) { key = value; }
@@ -34,34 +46,55 @@ public:
 	void unlock() { mtx.unlock(); }
 };
 
+NodePool<Node, MAX_THREADS> pool{};
+NodeStats<MAX_THREADS> stats{};
+
 class List
 {
-	Node head{ 0x80000000 }, tail{ 0x7FFFFFFF };
+	Node* head{}, * tail{};
+	uint32_t tailIndex{};
 public:
-	List() { head.next = &tail; }
+	List()
+	{
+		head = pool.get(newNode(0x80000000));
+		tailIndex = newNode(0x7FFFFFFF);
+		tail = pool.get(tailIndex);
+		head->next.store(tailIndex, memory_order_relaxed);
+	}
 	~List() {}
 
 	void init()
 	{
-		Node* ptr{};
-		while (head.next != &tail)
+		uint32_t ptr{};
+		while (head->next.load(memory_order_relaxed) != tailIndex)
 		{
-			ptr = head.next;
-			head.next = head.next->next;
-			delete ptr;
+			ptr = head->next.load(memory_order_relaxed);
+			head->next.store(pool.get(ptr)->next.load(memory_order_relaxed), memory_order_relaxed);
+			pool.free(THREAD_ID, ptr);
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
 		}
 	}
+	uint32_t newNode(int key)
+	{
+		uint32_t index{ pool.alloc(THREAD_ID) };
+		stats.onAlloc(THREAD_ID);
+		Node* node{ pool.get(index) };
+		node->key = key;
+		node->marked.store(false, memory_order_relaxed);
+		return index;
+	}
 	bool add(int key)
 	{
 		while (true)
 		{
-			Node* pred{ &head };
-			Node* curr{ pred->next };
+			Node* pred{ head };
+			Node* curr{ nextOf(pred) };
 
 			while (curr->key < key)
 			{
 				pred = curr;
-				curr = curr->next;
+				curr = nextOf(curr);
 			}
 
 			pred->lock();
@@ -77,9 +110,9 @@ public:
 				}
 				else
 				{
-					Node* node{ new Node{key} };
-					node->next = curr;
-					pred->next = node;
+					uint32_t node{ newNode(key) };
+					pool.get(node)->next.store(pred->next.load(memory_order_relaxed), memory_order_relaxed);
+					pred->next.store(node, memory_order_release);		// 락 없이 순회하는 스레드도 초기화된 노드를 보도록
 
 					pred->unlock();
 					curr->unlock();
@@ -97,13 +130,13 @@ public:
 	{
 		while (true)
 		{
-			Node* pred{ &head };
-			Node* curr{ pred->next };
+			Node* pred{ head };
+			Node* curr{ nextOf(pred) };
 
 			while (curr->key < key)
 			{
 				pred = curr;
-				curr = curr->next;
+				curr = nextOf(curr);
 			}
 
 			pred->lock();
@@ -113,12 +146,13 @@ public:
 			{
 				if (key == curr->key)
 				{
-					curr->marked = true;
-					atomic_thread_fence(memory_order_seq_cst);
-					pred->next = curr->next;
+					// release로 떼어내므로 마킹이 떼어내기보다 먼저 보인다. -> full fence가 필요없다.
+					curr->marked.store(true, memory_order_relaxed);
+					pred->next.store(curr->next.load(memory_order_relaxed), memory_order_release);
 					pred->unlock();
 					curr->unlock();
-					//delete curr;
+					stats.onRemove(THREAD_ID);
+					//pool.free(THREAD_ID, pool.indexOf(curr));
 					return true;
 				}
 				else
@@ -137,22 +171,24 @@ public:
 	}
 	bool contains(int key)
 	{
-		Node* node{ head.next };
-		while (node->key < key) node = node->next;
-		return node->key == key && !node->marked;
+		Node* node{ nextOf(head) };
+		while (node->key < key) node = nextOf(node);
+		return node->key == key && !node->marked.load(memory_order_relaxed);
 	}
+	// 락 없이 순회하므로 next는 acquire로 읽는다.
+	Node* nextOf(Node* node) { return pool.get(node->next.load(memory_order_acquire)); }
 	bool valid(Node* pred, Node* curr)
 	{
-		return !pred->marked && !curr->marked && pred->next == curr;
+		return !pred->marked.load(memory_order_relaxed) && !curr->marked.load(memory_order_relaxed) && nextOf(pred) == curr;
 	}
 	void printElement(int count)
 	{
-		Node* node{ head.next };
+		Node* node{ nextOf(head) };
 		for (int i = 0; i < count; ++i)
 		{
-			if (&tail == node) break;
+			if (tail == node) break;
 			cout << node->key << " ";
-			node = node->next;
+			node = nextOf(node);
 		}
 		cout << "\n";
 	}
@@ -160,14 +196,15 @@ public:
 
 constexpr int NUM_TEST{ 4000000 };
 constexpr int KEY_RANGE{ 1000 };
-constexpr int MAX_THREADS{ 8 };
 
 List lst;
 
-void ThreadFunc(int numOfThread)
+void ThreadFunc(int numOfThread, int threadID)
 {
 	int key{};
 
+	THREAD_ID = threadID;
+
 	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
 	{
 		switch (rand() % 3) {
@@ -192,18 +229,31 @@ void ThreadFunc(int numOfThread)
 int main()
 {
 	vector<thread> threads{};
+	RssSampler sampler{};
+
+	stressSet(MAX_THREADS, STRESS_OPS, STRESS_KEY_RANGE,
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.add(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.remove(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.contains(key); });
+	lst.init();
 
 	for (int i = 1; i <= MAX_THREADS; i *= 2)
 	{
 		threads.clear();
+		sampler.start();
 		auto start{ high_resolution_clock::now() };
 
-		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i);
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
 		for (auto& thread : threads) thread.join();
+		sampler.stop();
 
 		lst.printElement(20);
 
 		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
 		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds\n";
+		stats.print();
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
 	}
 }
\ No newline at end of file
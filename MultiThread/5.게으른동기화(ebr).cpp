@@ -0,0 +1,455 @@
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include "ebr.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "node_pool.h"
+#include "stress_test.h"
+
+using namespace std;
+using namespace std::chrono;
+
+/*
+	게으른동기화(ebr)
+
+	1. remove 대상을 아무도 가리키고있지 않다면 delete해도 된다. -> shared_ptr을 이용해 메모리 릭 해결?
+
+	※ shared_ptr은 속도가 매우 느리다. -> 순회 한칸마다 참조카운트 원자연산이 2번, shared_ptr 대입 자체는 원자적이지 않다.
+	※ 참조카운트를 링크(외부 카운트)와 노드(내부 카운트)로 나눠도 순회 한칸마다 링크에 fetch_add 한번과 해제가 남는다.
+	   -> 카운트를 pred, curr에만 쓰고 순회는 에포크로 보호해도, 카운트는 하는 일 없이 연산마다 RMW 4번만 늘린다.
+
+	2. 누가 노드를 가리키는지 세지 않고, 누가 리스트를 읽고 있는지만 센다. -> 4.게으른동기화.cpp에 EBR을 더한다.
+	   - add, remove, contains 전체를 에포크로 감싼다. 순회는 4.게으른동기화.cpp와 똑같이 next만 읽는다.
+	   - remove는 떼어낸 노드를 EBR에 넘긴다. 에포크 안의 스레드가 모두 나간 뒤에 풀로 돌아간다.
+	   -> 연산마다 에포크를 여닫는 store 두번만 늘어난다. 순회 한칸마다 원자연산이 없다.
+	3. 노드는 NodePool에서 할당하고, next는 포인터 대신 32비트 인덱스로 가리킨다. (4.게으른동기화.cpp와 같다.)
+
+	※ 같은 부하로 세 리스트를 비교한다.
+	   - SharedList: shared_ptr로 가리키는 원래의 리스트. next는 atomic_load, atomic_store로만 읽고 쓴다. (그냥 대입하면 데이터 레이스)
+	   - List<false>: 4.게으른동기화.cpp. 떼어낸 노드를 해제하지 않는다.
+	   - List<true>: EBR로 떼어낸 노드를 해제한다.
+*/
+
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
+NodeStats<MAX_THREADS> sharedStats{}, leakStats{}, ebrStats{};
+
+class SharedNode
+{
+private:
+	mutex mtx{};
+public:
+	int key{};
+	atomic<bool> marked{};
+	shared_ptr<SharedNode> next{};
+public:
+	SharedNode(int value)
+	{
+		key = value;
+		sharedStats.onAlloc(THREAD_ID);
+	}
+	~SharedNode() { sharedStats.onFree(THREAD_ID); }
+
+	void lock() { mtx.lock(); }
+	void unlock() { mtx.unlock(); }
+};
+
+class SharedList
+{
+private:
+	shared_ptr<SharedNode> head{ make_shared<SharedNode>(0x80000000) }, tail{ make_shared<SharedNode>(0x7FFFFFFF) };
+public:
+	SharedList() { head->next = tail; }
+	~SharedList() = default;
+
+	// 남은 노드를 떼어내면 참조카운트가 0이 되면서 연쇄적으로 해제된다.
+	void init()
+	{
+		for (shared_ptr<SharedNode> node{ head->next }; node != tail; node = node->next) sharedStats.onRemove(THREAD_ID);
+		head->next = tail;
+	}
+	bool add(int key)
+	{
+		while (true)
+		{
+			shared_ptr<SharedNode> pred{ head };
+			shared_ptr<SharedNode> curr{ atomic_load(&pred->next) };
+
+			while (curr->key < key)
+			{
+				pred = curr;
+				curr = atomic_load(&curr->next);
+			}
+
+			pred->lock();
+			curr->lock();
+
+			if (valid(pred, curr))
+			{
+				if (key == curr->key)
+				{
+					pred->unlock();
+					curr->unlock();
+					return false;
+				}
+				else
+				{
+					shared_ptr<SharedNode> node{ make_shared<SharedNode>(key) };
+					node->next = curr;
+					atomic_store(&pred->next, node);
+
+					pred->unlock();
+					curr->unlock();
+					return true;
+				}
+			}
+			else
+			{
+				pred->unlock();
+				curr->unlock();
+			}
+		}
+	}
+	bool remove(int key)
+	{
+		while (true)
+		{
+			shared_ptr<SharedNode> pred{ head };
+			shared_ptr<SharedNode> curr{ atomic_load(&pred->next) };
+
+			while (curr->key < key)
+			{
+				pred = curr;
+				curr = atomic_load(&curr->next);
+			}
+
+			pred->lock();
+			curr->lock();
+
+			if (valid(pred, curr))
+			{
+				if (key == curr->key)
+				{
+					curr->marked.store(true, memory_order_relaxed);		// atomic_store가 seq_cst이므로 떼어내기보다 먼저 보인다.
+					atomic_store(&pred->next, atomic_load(&curr->next));
+					sharedStats.onRemove(THREAD_ID);
+					pred->unlock();
+					curr->unlock();
+					return true;		// 마지막 shared_ptr이 사라질 때 해제된다.
+				}
+				else
+				{
+					pred->unlock();
+					curr->unlock();
+					return false;
+				}
+			}
+			else
+			{
+				pred->unlock();
+				curr->unlock();
+			}
+		}
+	}
+	bool contains(int key)
+	{
+		shared_ptr<SharedNode> node{ atomic_load(&head->next) };
+		while (node->key < key) node = atomic_load(&node->next);
+		return node->key == key && !node->marked.load(memory_order_relaxed);
+	}
+	bool valid(const shared_ptr<SharedNode>& pred, const shared_ptr<SharedNode>& curr)
+	{
+		return !pred->marked.load(memory_order_relaxed) && !curr->marked.load(memory_order_relaxed) && atomic_load(&pred->next) == curr;
+	}
+	void printElement(int count)
+	{
+		shared_ptr<SharedNode> node{ head->next };
+		for (int i = 0; i < count; ++i)
+		{
+			if (tail == node) break;
+			cout << node->key << " ";
+			node = node->next;
+		}
+		cout << "\n";
+	}
+};
+
+class alignas(64) Node
+{
+private:
+	mutex mtx{};
+public:
+	int key{};
+	atomic<bool> marked{};
+	atomic<uint32_t> next{};
+public:
+	Node() = default;
+	Node(int value) { key = value; }
+	~Node() = default;
+
+	void lock() { mtx.lock(); }
+	void unlock() { mtx.unlock(); }
+};
+
+NodePool<Node, MAX_THREADS> pool{};
+
+// EBR이 해제할 노드를 delete하는 대신 풀에 반환
+struct NodeDeleter
+{
+	void operator()(Node* node) const
+	{
+		pool.free(THREAD_ID, pool.indexOf(node));
+		ebrStats.onFree(THREAD_ID);
+	}
+};
+
+// IS_RECLAIMED가 false이면 4.게으른동기화.cpp와 같다.
+template <bool IS_RECLAIMED>
+class List
+{
+private:
+	Node* head{}, * tail{};
+	uint32_t tailIndex{};
+	NodeStats<MAX_THREADS>* stats{};
+	EBR<Node, MAX_THREADS, NodeDeleter> ebr{};
+public:
+	List(NodeStats<MAX_THREADS>* nodeStats)
+	{
+		stats = nodeStats;
+		head = pool.get(newNode(0x80000000));
+		tailIndex = newNode(0x7FFFFFFF);
+		tail = pool.get(tailIndex);
+		head->next.store(tailIndex, memory_order_relaxed);
+	}
+	~List() {}
+
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void init()
+	{
+		uint32_t ptr{};
+		while (head->next.load(memory_order_relaxed) != tailIndex)
+		{
+			ptr = head->next.load(memory_order_relaxed);
+			head->next.store(pool.get(ptr)->next.load(memory_order_relaxed), memory_order_relaxed);
+			pool.free(THREAD_ID, ptr);
+			stats->onRemove(THREAD_ID);
+			stats->onFree(THREAD_ID);
+		}
+		if (IS_RECLAIMED) ebr.clear();
+	}
+	uint32_t newNode(int key)
+	{
+		uint32_t index{ pool.alloc(THREAD_ID) };
+		stats->onAlloc(THREAD_ID);
+		Node* node{ pool.get(index) };
+		node->key = key;
+		node->marked.store(false, memory_order_relaxed);
+		return index;
+	}
+	bool add(int key)
+	{
+		enter();
+		while (true)
+		{
+			Node* pred{ head };
+			Node* curr{ nextOf(pred) };
+
+			while (curr->key < key)
+			{
+				pred = curr;
+				curr = nextOf(curr);
+			}
+
+			pred->lock();
+			curr->lock();
+
+			if (valid(pred, curr))
+			{
+				if (key == curr->key)
+				{
+					pred->unlock();
+					curr->unlock();
+					leave();
+					return false;
+				}
+				else
+				{
+					uint32_t node{ newNode(key) };
+					pool.get(node)->next.store(pred->next.load(memory_order_relaxed), memory_order_relaxed);
+					pred->next.store(node, memory_order_release);		// 락 없이 순회하는 스레드도 초기화된 노드를 보도록
+
+					pred->unlock();
+					curr->unlock();
+					leave();
+					return true;
+				}
+			}
+			else
+			{
+				pred->unlock();
+				curr->unlock();
+			}
+		}
+	}
+	bool remove(int key)
+	{
+		enter();
+		while (true)
+		{
+			Node* pred{ head };
+			Node* curr{ nextOf(pred) };
+
+			while (curr->key < key)
+			{
+				pred = curr;
+				curr = nextOf(curr);
+			}
+
+			pred->lock();
+			curr->lock();
+
+			if (valid(pred, curr))
+			{
+				if (key == curr->key)
+				{
+					// release로 떼어내므로 마킹이 떼어내기보다 먼저 보인다. -> full fence가 필요없다.
+					curr->marked.store(true, memory_order_relaxed);
+					pred->next.store(curr->next.load(memory_order_relaxed), memory_order_release);
+					pred->unlock();
+					curr->unlock();
+					stats->onRemove(THREAD_ID);
+					if (IS_RECLAIMED) ebr.retire(THREAD_ID, curr);		// 에포크 안에서 curr를 읽고 있는 스레드가 있을 수 있다.
+					leave();
+					return true;
+				}
+				else
+				{
+					pred->unlock();
+					curr->unlock();
+					leave();
+					return false;
+				}
+			}
+			else
+			{
+				pred->unlock();
+				curr->unlock();
+			}
+		}
+	}
+	bool contains(int key)
+	{
+		enter();
+		Node* node{ nextOf(head) };
+		while (node->key < key) node = nextOf(node);
+		bool result{ node->key == key && !node->marked.load(memory_order_relaxed) };
+		leave();
+		return result;
+	}
+	// 락 없이 순회하므로 next는 acquire로 읽는다.
+	Node* nextOf(Node* node) { return pool.get(node->next.load(memory_order_acquire)); }
+	bool valid(Node* pred, Node* curr)
+	{
+		return !pred->marked.load(memory_order_relaxed) && !curr->marked.load(memory_order_relaxed) && nextOf(pred) == curr;
+	}
+	void printElement(int count)
+	{
+		Node* node{ nextOf(head) };
+		for (int i = 0; i < count; ++i)
+		{
+			if (tail == node) break;
+			cout << node->key << " ";
+			node = nextOf(node);
+		}
+		cout << "\n";
+	}
+private:
+	void enter() { if (IS_RECLAIMED) ebr.start(THREAD_ID); }
+	void leave() { if (IS_RECLAIMED) ebr.end(THREAD_ID); }
+};
+
+constexpr int NUM_TEST{ 4000000 };
+constexpr int KEY_RANGE{ 1000 };
+
+SharedList sharedList;
+List<false> leakList{ &leakStats };
+List<true> ebrList{ &ebrStats };
+
+template <class Set>
+void ThreadFunc(Set* set, int numOfThread, int threadID)
+{
+	int key{};
+
+	THREAD_ID = threadID;
+
+	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
+	{
+		switch (rand() % 3) {
+		case 0:
+			key = rand() % KEY_RANGE;
+			set->add(key);
+			break;
+		case 1:
+			key = rand() % KEY_RANGE;
+			set->remove(key);
+			break;
+		case 2:
+			key = rand() % KEY_RANGE;
+			set->contains(key);
+			break;
+		default: cout << "Error\n";
+			exit(-1);
+		}
+	}
+}
+
+template <class Set>
+void benchmark(Set* set, NodeStats<MAX_THREADS>* stats)
+{
+	vector<thread> threads{};
+	RssSampler sampler{};
+
+	stressSet(MAX_THREADS, STRESS_OPS, STRESS_KEY_RANGE,
+		[set](int threadID, int key) { THREAD_ID = threadID; return set->add(key); },
+		[set](int threadID, int key) { THREAD_ID = threadID; return set->remove(key); },
+		[set](int threadID, int key) { THREAD_ID = threadID; return set->contains(key); });
+	set->init();
+
+	for (int i = 1; i <= MAX_THREADS; i *= 2)
+	{
+		threads.clear();
+		sampler.start();
+		auto start{ high_resolution_clock::now() };
+
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc<Set>, set, i, j);
+		for (auto& thread : threads) thread.join();
+		sampler.stop();
+
+		set->printElement(20);
+
+		auto duration{ high_resolution_clock::now() - start };
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds\n";
+		stats->print();
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+	}
+	THREAD_ID = 0;
+	set->init();
+}
+
+int main()
+{
+	cout << "[List<true>] EBR\n";
+	benchmark(&ebrList, &ebrStats);
+	cout << "[List<false>] 4.게으른동기화.cpp\n";		// 떼어낸 노드가 풀로 돌아가지 않으므로 RSS가 계속 는다. -> 마지막에 잰다.
+	benchmark(&leakList, &leakStats);
+	cout << "[SharedList]\n";
+	benchmark(&sharedList, &sharedStats);
+}
@@ -4,50 +4,76 @@
 #include <mutex> 
 #include <vector> 
 #include <atomic> 
+#include "ebr.h"
+#include "node_pool.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
 
 using namespace std; 
 using namespace std::chrono; 
 
 /*
-	ȭ
+	게으른동기화
 
-	1. node removed(ŷ)  ޸𸮷  ѹ CAS Ѵ.
+	1. node와 removed(마킹)을 한 메모리로 관리해 한번에 CAS연산을 수행한다.
+	2. 리스트에서 떼어낸 노드는 EBR로 모든 스레드가 참조하지 않게 된 뒤에 delete한다.
+	3. 노드는 NodePool에서 할당하고, next는 포인터 대신 32비트 인덱스로 가리킨다. -> 노드 하나가 16바이트
+	4. 남는 비트에는 버전을 넣어 CAS에 성공할 때마다 증가시킨다.
+	   -> pred->next를 읽은 뒤에 다른 스레드가 바꿨다가 같은 값으로 되돌려도, 버전이 다르므로 CAS에 실패한다. (ABA 방지)
+
+	5. next는 atomic으로 선언하고 읽기는 acquire, CAS는 acq_rel로 한다. -> 순회 한칸마다 full fence를 쓰지 않는다.
+
+	※ EBR은 노드를 delete하는 대신 풀에 반환하고, 재사용은 모든 스레드가 그 노드를 놓은 뒤에만 일어난다.
 */
 
-class Node; 
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
 
+// | index(32) | version(31) | removed(1) |
 class CPtr
 {
 private:
-	long long value{};
+	atomic<long long> value{};
+private:
+	static long long pack(uint32_t index, unsigned version, bool removed)
+	{
+		return static_cast<long long>((static_cast<unsigned long long>(index) << 32) | ((version & 0x7FFFFFFF) << 1) | (removed ? 0x01 : 0x00));
+	}
 public:
-	void set(Node* node, bool removed)
+	// 버전은 이전 값에서 하나 증가시킨다. 아직 공개되지 않은 노드나 혼자 쓰는 리스트에만 사용
+	void set(uint32_t index, bool removed)
 	{
-		value = reinterpret_cast<long long>(node);
-		if (removed) value = value | 0x01;
-		else value = value & 0xFFFFFFFFFFFFFFFE;
+		value.store(pack(index, getVersion() + 1, removed), memory_order_relaxed);
 	}
-	Node* getPtr()
+	uint32_t getIndex()
 	{
-		return reinterpret_cast<Node*>(value & 0xFFFFFFFFFFFFFFFE);
+		return static_cast<uint32_t>(static_cast<unsigned long long>(value.load(memory_order_acquire)) >> 32);
 	}
-	Node* getPtr(bool* removed)
+	uint32_t getIndex(bool* removed)
 	{
-		if (!(value & 0x01)) *removed = false;
-		else *removed = true;
-		return reinterpret_cast<Node*>(value & 0xFFFFFFFFFFFFFFFE);
+		long long val{ value.load(memory_order_acquire) };
+		*removed = val & 0x01;
+		return static_cast<uint32_t>(static_cast<unsigned long long>(val) >> 32);
 	}
-	bool CAS(Node* oldNode, Node* newNode, bool oldRemoved, bool newRemoved)
+	uint32_t getIndex(bool* removed, unsigned* version)
 	{
-		long long oldVal{ reinterpret_cast<long long>(oldNode) };
-		if (oldRemoved) oldVal = oldVal | 0x01;
-		else oldVal = oldVal & 0xFFFFFFFFFFFFFFFE;
-
-		long long newVal{ reinterpret_cast<long long>(newNode) };
-		if (oldRemoved) newVal = newVal | 0x01;
-		else newVal = newVal & 0xFFFFFFFFFFFFFFFE;
+		long long val{ value.load(memory_order_acquire) };
+		*removed = val & 0x01;
+		*version = static_cast<unsigned>(val >> 1) & 0x7FFFFFFF;
+		return static_cast<uint32_t>(static_cast<unsigned long long>(val) >> 32);
+	}
+	unsigned getVersion()
+	{
+		return static_cast<unsigned>(value.load(memory_order_relaxed) >> 1) & 0x7FFFFFFF;
+	}
+	// version은 oldIndex를 읽었을 때의 버전. 성공하면 버전이 하나 증가한다.
+	bool CAS(uint32_t oldIndex, uint32_t newIndex, bool oldRemoved, bool newRemoved, unsigned version)
+	{
+		long long oldVal{ pack(oldIndex, version, oldRemoved) };
+		long long newVal{ pack(newIndex, version + 1, newRemoved) };
 
-		return atomic_compare_exchange_strong(reinterpret_cast<atomic<long long>*>(&value), &oldVal, newVal);
+		return value.compare_exchange_strong(oldVal, newVal, memory_order_acq_rel, memory_order_relaxed);
 	}
 };
 
@@ -55,6 +81,7 @@ class Node
 {
 public:
 	int key{};
+	uint32_t index{};		// 풀에서 자신의 인덱스
 	CPtr next{};
 public:
 	Node() = default;
@@ -62,104 +89,175 @@ public:
 	~Node() = default;
 };
 
+NodePool<Node, MAX_THREADS> pool{};
+NodeStats<MAX_THREADS> stats{};
+
+// EBR이 해제할 노드를 delete하는 대신 풀에 반환
+struct NodeDeleter
+{
+	void operator()(Node* node) const
+	{
+		pool.free(THREAD_ID, node->index);
+		stats.onFree(THREAD_ID);
+	}
+};
+
 class List
 {
-	Node head{ 0x80000000 }, tail{ 0x7FFFFFFF };
+	Node* head{}, * tail{};
+	EBR<Node, MAX_THREADS, NodeDeleter> ebr{};
 public:
-	List() { head.next.set(&tail, false); }
+	List()
+	{
+		head = newNode(0x80000000);
+		tail = newNode(0x7FFFFFFF);
+		head->next.set(tail->index, false);
+	}
 	~List() = default;
 
 	void init()
 	{
 		Node* ptr{};
-		while (head.next.getPtr() != &tail)
+		while (head->next.getIndex() != tail->index)
 		{
-			ptr = head.next.getPtr();
-			head.next.set(ptr->next.getPtr(), false);
-			delete ptr;
+			ptr = pool.get(head->next.getIndex());
+			head->next.set(ptr->next.getIndex(), false);
+			pool.free(THREAD_ID, ptr->index);
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
 		}
+		ebr.clear();
+	}
+	void setReclaim(bool reclaim) { ebr.setEnabled(reclaim); }
+	Node* newNode(int key)
+	{
+		uint32_t index{ pool.alloc(THREAD_ID) };
+		Node* node{ pool.get(index) };
+		node->key = key;
+		node->index = index;
+		return node;
 	}
-	void find(Node*& pred, Node*& curr, int key)
+	// version에는 pred->next에서 curr를 읽었을 때의 버전을 돌려준다.
+	void find(Node*& pred, Node*& curr, unsigned& version, int key)
 	{
+		Node* predNode{}, * currNode{};
+		unsigned predVersion{};
+		bool isRemoved{};
+
 	RETRY:
-		pred = &head;
-		curr = pred->next.getPtr();
+		predNode = head;
+		currNode = pool.get(predNode->next.getIndex(&isRemoved, &predVersion));
 
 		while (true)
 		{
-			bool isRemoved{};
-			Node* succ{ curr->next.getPtr(&isRemoved) };
+			Node* succ{ pool.get(currNode->next.getIndex(&isRemoved)) };
 
 			while (isRemoved)
 			{
-				if (!pred->next.CAS(curr, succ, false, false)) goto RETRY;
-				curr = succ;
-				succ = curr->next.getPtr(&isRemoved);
+				if (!predNode->next.CAS(currNode->index, succ->index, false, false, predVersion)) goto RETRY;
+				ebr.retire(THREAD_ID, currNode);
+				++predVersion;
+				currNode = succ;
+				succ = pool.get(currNode->next.getIndex(&isRemoved));
 			} 
 
-			if (curr->key >= key) return;
+			if (currNode->key >= key)
+			{
+				// 순회는 지역변수로 하고 마지막에 한번만 돌려준다. -> 참조에 쓸 때마다 pool을 다시 읽지 않도록
+				pred = predNode;
+				curr = currNode;
+				version = predVersion;
+				return;
+			}
 
-			pred = curr;
-			curr = curr->next.getPtr();
+			predNode = currNode;
+			currNode = pool.get(currNode->next.getIndex(&isRemoved, &predVersion));
 		}
 	}
 	bool add(int key)
 	{
 		Node* pred{}, * curr{};
+		Node* node{};
+		unsigned version{};
 
+		ebr.start(THREAD_ID);
 		while (true)
 		{
-			find(pred, curr, key);
+			find(pred, curr, version, key);
 
-			if (key == curr->key) return false;
+			if (key == curr->key)
+			{
+				ebr.end(THREAD_ID);
+				if (node) pool.free(THREAD_ID, node->index);
+				return false;
+			}
 			else
 			{
-				Node* node{ new Node(key) };
-				node->next.set(curr, false);
-				if (pred->next.CAS(curr, node, false, false)) return true;
+				if (!node) node = newNode(key);
+				node->next.set(curr->index, false);
+				if (pred->next.CAS(curr->index, node->index, false, false, version))
+				{
+					stats.onAlloc(THREAD_ID);		// 리스트에 들어간 노드만 센다.
+					ebr.end(THREAD_ID);
+					return true;
+				}
 			}
 		}
 	}
 	bool remove(int key)
 	{
 		Node* pred{}, * curr{};
+		unsigned version{};
 
+		ebr.start(THREAD_ID);
 		while (true)
 		{
-			find(pred, curr, key);
+			find(pred, curr, version, key);
 
-			if (key != curr->key) return false;
+			if (key != curr->key)
+			{
+				ebr.end(THREAD_ID);
+				return false;
+			}
 			else
 			{
-				Node* succ{ curr->next.getPtr() };
+				bool isRemoved{};
+				unsigned succVersion{};
+				uint32_t succ{ curr->next.getIndex(&isRemoved, &succVersion) };
 
-				if (!pred->next.CAS(curr, curr, false, true)) continue;
-				pred->next.CAS(curr, succ, false, false);
+				// 마킹에 성공한 스레드만 제거에 성공한다. 떼어내지 못하면 이후의 find가 떼어내고 retire한다.
+				if (!curr->next.CAS(succ, succ, false, true, succVersion)) continue;
+				stats.onRemove(THREAD_ID);
+				if (pred->next.CAS(curr->index, succ, false, false, version)) ebr.retire(THREAD_ID, curr);
+				ebr.end(THREAD_ID);
 				return true;
 			}
 		}
 	}
 	bool contain(int key)
 	{
-		Node* pred{}, * curr{};
+		Node* curr{};
 		bool removed{};
 
-		curr = &head;
+		ebr.start(THREAD_ID);
+		curr = head;
 
 		while (curr->key < key)
 		{
-			curr = curr->next.getPtr();
-			curr->next.getPtr(&removed);
+			curr = pool.get(curr->next.getIndex());
+			curr->next.getIndex(&removed);
 		}
-		return curr->key == key && !removed;
+		bool result{ curr->key == key && !removed };
+		ebr.end(THREAD_ID);
+		return result;
 	}
 	void printElement(int count)
 	{
-		Node* node{ head.next.getPtr() };
-		while (node != &tail)
+		Node* node{ pool.get(head->next.getIndex()) };
+		while (node != tail)
 		{
 			cout << node->key << ", ";
-			node = node->next.getPtr();
+			node = pool.get(node->next.getIndex());
 			--count;
 			if (!count) break;
 		}
@@ -169,14 +267,15 @@ public:
 
 const int NUM_TEST{ 4000000 };
 const int KEY_RANGE{ 1000 };
-constexpr int MAX_THREADS{ 8 };
 
 List lst; 
 
-void ThreadFunc(int numOfThread)
+void ThreadFunc(int numOfThread, int threadID)
 {
 	int key{};
 
+	THREAD_ID = threadID;
+
 	for (int i = 0; i < NUM_TEST / numOfThread; i++)
 	{
 		switch (rand() % 3)
@@ -203,20 +302,43 @@ void ThreadFunc(int numOfThread)
 int main()
 {
 	vector<thread> threads{};
+	RssSampler sampler{};
 
-	for (int i = 1; i <= MAX_THREADS; i *= 2)
+	stressSet(MAX_THREADS, STRESS_OPS, STRESS_KEY_RANGE,
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.add(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.remove(key); },
+		[](int threadID, int key) { THREAD_ID = threadID; return lst.contain(key); });
+
+	// EBR로 노드를 해제하는 버전과 기존의 메모리 릭 버전을 비교
+	for (bool reclaim : { true, false })
 	{
-		threads.clear();
-		lst.init();
+		lst.setReclaim(reclaim);
+		cout << (reclaim ? "[EBR]\n" : "[Leak]\n");
+
+		for (int i = 1; i <= MAX_THREADS; i *= 2)
+		{
+			threads.clear();
+			lst.init();
 
-		auto start{ high_resolution_clock::now() };
+			size_t startMemory{ getResidentMemory() };
+			sampler.start();
+			auto start{ high_resolution_clock::now() };
 
-		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i);
-		for (auto& thread : threads) thread.join();
+			for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
+			for (auto& thread : threads) thread.join();
+			sampler.stop();
 
-		lst.printElement(20);
+			lst.printElement(20);
 
-		auto duration{ high_resolution_clock::now() - start };
-		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds\n";
+			auto duration{ high_resolution_clock::now() - start };
+			double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+			size_t endMemory{ getResidentMemory() };
+			cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+			cout << "Throughput = " << static_cast<long long>(NUM_TEST / seconds) << " ops/sec, ";
+			cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB)\n";
+			stats.print();
+			cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+			cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+		}
 	}
 }
\ No newline at end of file
@@ -3,17 +3,24 @@
 #include <mutex>
 #include <chrono>
 #include <vector>
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "magazine.h"
 
 using namespace std;
 using namespace std::chrono;
 
 /*
-	䵿ȭ
+	성긴동기화
 
-	1. ť ü mtx ü  ִ.
-	2. enq lock deq lock  Ѵ.
+	1. 큐 객체가 mtx 객체를 가지고 있다.
+	2. enq lock과 deq lock이 따로 존재한다.
+	3. 노드는 new, delete 대신 스레드별 Magazine에서 꺼내고 반환한다. -> 전역 할당자가 숨은 직렬화 지점이 되지 않도록
 */
 
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
 class Node
 {
 public:
@@ -24,13 +31,16 @@ public:
 	~Node() = default;
 };
 
+Magazine<Node, MAX_THREADS> magazine{};
+NodeStats<MAX_THREADS> stats{};
+
 class Queue
 {
 	Node* head{}, * tail{};
 	mutex pushMtx{}, popMtx{};
 public:
-	Queue() { head = tail = new Node{}; }
-	~Queue() { init(); delete head; }
+	Queue() { head = tail = newNode(0); }
+	~Queue() { init(); magazine.free(THREAD_ID, head); }
 
 	void init()
 	{
@@ -39,13 +49,24 @@ public:
 		{
 			ptr = head;
 			head = ptr->next;
-			delete ptr;
+			magazine.free(THREAD_ID, ptr);
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
 		}
 	}
+	Node* newNode(int key)
+	{
+		Node* node{ magazine.alloc(THREAD_ID) };
+		stats.onAlloc(THREAD_ID);
+		node->key = key;
+		node->next = nullptr;
+		return node;
+	}
 	void push(int key)
 	{
+		Node* node{ newNode(key) };
 		pushMtx.lock();
-		tail->next = new Node{ key };
+		tail->next = node;
 		tail = tail->next;
 		pushMtx.unlock();
 	}
@@ -57,7 +78,9 @@ public:
 		head = head->next;
 		int val{ ptr->key };
 		popMtx.unlock();
-		delete ptr;
+		magazine.free(THREAD_ID, ptr);
+		stats.onRemove(THREAD_ID);
+		stats.onFree(THREAD_ID);
 		return val;
 	}
 	void printElement(int count)
@@ -74,12 +97,13 @@ public:
 };
 
 constexpr int NUM_TEST{ 10000000 };
-constexpr int MAX_THREADS{ 8 };
 
 Queue que;
 
-void ThreadFunc(int numOfThread)
+void ThreadFunc(int numOfThread, int threadID)
 {
+	THREAD_ID = threadID;
+
 	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
 	{
 		switch (rand() % 2 || i < 2 / numOfThread)
@@ -94,20 +118,29 @@ void ThreadFunc(int numOfThread)
 int main()
 {
 	vector<thread> threads{};
+	RssSampler sampler{};
 
 	for (int i = 1; i <= MAX_THREADS; i *= 2)
 	{
 		threads.clear();
 		que.init();
+		magazine.resetCount();
 
+		sampler.start();
 		auto start{ high_resolution_clock::now() };
 
-		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i);
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
 		for (auto& thread : threads) thread.join();
+		sampler.stop();
 
 		que.printElement(20);
 
 		auto duration{ high_resolution_clock::now() - start };
-		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds\n";
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << "Allocator Calls = " << magazine.getAllocatorCalls() << " (new/delete = " << magazine.getRequests() << ")\n";
+		stats.print();
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
 	}
 }
\ No newline at end of file
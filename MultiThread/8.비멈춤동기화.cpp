@@ -3,66 +3,107 @@
 #include <atomic>
 #include <chrono>
 #include <vector>
+#include "hazard_pointer.h"
+#include "magazine.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
 
 using namespace std;
 using namespace std::chrono;
 
 /*
-	 ȭ
+	비멈춤 동기화
 
-	1. CAS ̿ push, popѴ. ϸ 忡 push, popϴ  ݺ
+	1. CAS를 이용해 push, pop한다. 실패하면 다음노드에 push, pop하는 로직을 반복
+	2. pop한 노드는 다른 스레드가 아직 읽고 있을 수 있으므로 해저드 포인터로 보호하고, 아무도 참조하지 않을 때 delete한다.
+	3. 노드는 new, delete 대신 스레드별 Magazine에서 꺼내고 반환한다. -> 전역 할당자가 숨은 직렬화 지점이 되지 않도록
+	4. head, tail, next는 atomic으로 선언하고 읽기는 acquire, CAS는 release로 한다.
+	   -> 노드를 연결한 CAS(release)를 읽은 스레드(acquire)는 초기화된 key를 본다. full fence는 해저드 포인터 게시에만 남는다.
 */
 
+constexpr int MAX_THREADS{ 8 };
+constexpr int SCAN_THRESHOLD{ 64 };	// retire 리스트가 이만큼 쌓이면 scan
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
+
 class Node
 {
 public:
 	int key{};
-	Node* next{};
+	atomic<Node*> next{};
 	Node() = default;
 	Node(int newKey) { key = newKey; }
 	~Node() = default;
 };
 
+Magazine<Node, MAX_THREADS> magazine{};
+NodeStats<MAX_THREADS> stats{};
+
+// 해저드 포인터가 해제할 노드를 delete하는 대신 매거진에 반환
+struct NodeDeleter
+{
+	void operator()(Node* node) const
+	{
+		magazine.free(THREAD_ID, node);
+		stats.onFree(THREAD_ID);
+	}
+};
+
 class Queue
 {
-	Node* volatile head{};
-	Node* volatile tail{};
+	atomic<Node*> head{};
+	atomic<Node*> tail{};
+	HazardPointer<Node, MAX_THREADS, 2, NodeDeleter> hp{ SCAN_THRESHOLD };
 public:
-	Queue() { head = tail = new Node{}; }
-	~Queue() { init(); delete head; }
+	Queue() { head = tail = newNode(0); }
+	~Queue() { init(); magazine.free(THREAD_ID, head); }
 
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
 	void init()
 	{
-		Node* ptr{};
-		while (head != tail) 
+		Node* ptr{ head.load(memory_order_relaxed) };
+		while (ptr != tail.load(memory_order_relaxed)) 
 		{
-			ptr = head;
-			head = head->next;
-			delete ptr;
+			Node* next{ ptr->next.load(memory_order_relaxed) };
+			magazine.free(THREAD_ID, ptr);
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
+			ptr = next;
 		}
+		head.store(ptr, memory_order_relaxed);
+		hp.clear();
+	}
+	Node* newNode(int key)
+	{
+		Node* node{ magazine.alloc(THREAD_ID) };
+		stats.onAlloc(THREAD_ID);
+		node->key = key;
+		node->next.store(nullptr, memory_order_relaxed);		// 연결하는 CAS가 release이므로 relaxed
+		return node;
 	}
+	void setReclaim(bool reclaim) { hp.setEnabled(reclaim); }
 
-	bool CAS(Node* volatile& addr, const Node* oldNode, const Node* newNode) 
+	bool CAS(atomic<Node*>& addr, Node* oldNode, Node* newNode) 
 	{
-		long long oldvalue{ reinterpret_cast<long long>(oldNode) };
-		long long newvalue{ reinterpret_cast<long long>(newNode) };
-		return atomic_compare_exchange_strong((atomic<long long>*)(&addr), &oldvalue, newvalue);
+		return addr.compare_exchange_strong(oldNode, newNode, memory_order_release, memory_order_relaxed);
 	}
 	void push(int key)
 	{
-		Node* newNode{ new Node{key} };
+		Node* node{ newNode(key) };
 
 		while (true)
 		{
-			Node* cur{ tail };
-			Node* next{ cur->next };
+			Node* cur{ hp.protect(THREAD_ID, 0, tail) };
+			Node* next{ cur->next.load(memory_order_acquire) };
 
-			if (cur != tail) continue;
+			if (cur != tail.load(memory_order_relaxed)) continue;
 			if (!next)
 			{
-				if (CAS(cur->next, nullptr, newNode))
+				if (CAS(cur->next, nullptr, node))
 				{
-					CAS(tail, cur, newNode); return;
+					CAS(tail, cur, node);
+					hp.release(THREAD_ID);
+					return;
 				}
 			}
 			else CAS(tail, cur, next);
@@ -72,27 +113,29 @@ public:
 	{
 		while (true)
 		{
-			Node* cur{ head };
-			Node* next{ cur->next };
-			Node* last{ tail };
+			Node* cur{ hp.protect(THREAD_ID, 0, head) };
+			Node* last{ tail.load(memory_order_acquire) };
+			Node* next{ hp.protect(THREAD_ID, 1, cur->next) };
 
-			if (cur != head) continue;
-			if (!next) return -1;
+			if (cur != head.load(memory_order_relaxed)) continue;		// head가 그대로라면 next는 아직 retire되지 않았다.
+			if (!next) { hp.release(THREAD_ID); return -1; }
 			if (cur == last) { CAS(tail, last, next); continue; }
 
-			int result{ next->key };	// cur ʳ̹Ƿ next ȯ
+			int result{ next->key };	// cur은 보초노드이므로 next를 반환
 			if (!CAS(head, cur, next)) continue;
-			delete cur;
+			hp.release(THREAD_ID);
+			stats.onRemove(THREAD_ID);
+			hp.retire(THREAD_ID, cur);
 			return result;
 		}
 	}
 	void printElement(int count)
 	{
-		Node* cur{ head->next };
+		Node* cur{ head.load()->next };
 		while (cur)
 		{ 
 			cout << cur->key << ", ";
-			cur = cur->next;
+			cur = cur->next.load();
 			if (!(--count)) break;
 		} 
 		cout << endl;
@@ -100,12 +143,13 @@ public:
 };
 
 constexpr int NUM_TEST{ 10000000 };
-constexpr int MAX_THREADS{ 8 };
 
 Queue que;
 
-void ThreadFunc(int numOfThread)
+void ThreadFunc(int numOfThread, int threadID)
 {
+	THREAD_ID = threadID;
+
 	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
 	{
 		switch (rand() % 2)
@@ -120,20 +164,44 @@ void ThreadFunc(int numOfThread)
 int main()
 {
 	vector<thread> threads{};
+	RssSampler sampler{};
 
-	for (int i = 1; i <= MAX_THREADS; i *= 2)
-	{
-		threads.clear();
-		que.init();
-
-		auto start{ high_resolution_clock::now() };
+	stressQueue(MAX_THREADS, STRESS_OPS, true,
+		[](int threadID, int value) { THREAD_ID = threadID; que.push(value); },
+		[](int threadID) { THREAD_ID = threadID; return que.pop(); });
 
-		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i);
-		for (auto& thread : threads) thread.join();
-
-		que.printElement(20);
+	// 해저드 포인터로 노드를 해제하는 버전과 해제하지 않는 메모리 릭 버전을 비교
+	for (bool reclaim : { true, false })
+	{
+		que.setReclaim(reclaim);
+		cout << (reclaim ? "[Hazard Pointer]\n" : "[Leak]\n");
 
-		auto duration{ high_resolution_clock::now() - start };
-		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds\n";
+		for (int i = 1; i <= MAX_THREADS; i *= 2)
+		{
+			threads.clear();
+			que.init();
+			magazine.resetCount();
+
+			size_t startMemory{ getResidentMemory() };
+			sampler.start();
+			auto start{ high_resolution_clock::now() };
+
+			for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i, j);
+			for (auto& thread : threads) thread.join();
+			sampler.stop();
+
+			que.printElement(20);
+
+			auto duration{ high_resolution_clock::now() - start };
+			double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+			size_t endMemory{ getResidentMemory() };
+			cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+			cout << duration_cast<nanoseconds>(duration).count() / NUM_TEST << " ns/op, ";
+			cout << "Memory = " << endMemory / MEGABYTE << " MB (" << showpos << (static_cast<double>(endMemory) - startMemory) / MEGABYTE << noshowpos << " MB), ";
+			cout << "Allocator Calls = " << magazine.getAllocatorCalls() << " (new/delete = " << magazine.getRequests() << ")\n";
+			stats.print();
+			cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+			cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
+		}
 	}
 }
\ No newline at end of file
@@ -3,42 +3,62 @@
 #include <atomic>
 #include <chrono>
 #include <vector>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "magazine.h"
+#include "memory_usage.h"
+#include "node_stats.h"
+#include "stress_test.h"
 
 using namespace std;
 using namespace std::chrono;
 
 /*
-	㵿ȭ(stamp)
+	비멈춤동기화(stamp)
+
+	1. 노드에 카운트 정보를 추가한다. 이를 스탬프라 칭한다.
+	2. CAS연산 시 스탬프가 일치하지 않는다면, CAS는 실패한다.
+
+	※ Queue의 stampCAS는 Ptr을 포인터 크기 정수로 CAS한다. -> 노드만 비교하고 스탬프는 비교하지 않는다. (ABA 발생 가능)
+
+	3. WidePtr: {노드, 스탬프}를 16바이트 CAS(cmpxchg16b) 한번으로 비교하고 교환한다. (32비트에서는 8바이트 CAS)
+	4. PackedPtr: 64비트 주소의 쓰지 않는 상위 16비트에 스탬프를 넣어 8바이트 CAS 한번으로 처리한다.
+	5. 스탬프가 진짜로 비교되므로 StampQueue는 pop한 노드를 바로 Magazine에 반환해서 재사용한다.
+
+	※ PackedPtr의 스탬프는 65536번마다 한바퀴 돈다. -> 한 스레드가 읽고 CAS하는 사이에 같은 노드가 65536번 재사용되면 ABA
+
+	6. next와 head, tail은 atomic으로 선언하고 읽기는 acquire, CAS는 release로 한다.
 
-	1. 忡 īƮ  ߰Ѵ. ̸  ĪѴ.
-	2. CAS   ġ ʴ´ٸ, CAS Ѵ.
+	※ WidePtr는 volatile 필드와 cmpxchg16b를 그대로 쓴다. -> 16바이트 std::atomic은 lock-free가 아니다. (MSVC는 락으로 구현)
 */
 
-#ifdef _WIN64
-using integer = long long;
-#else
-using integer = int;
-#endif
+constexpr int MAX_THREADS{ 8 };
+thread_local int THREAD_ID{};		// 스레드마다 THREAD_ID 변수가 할당됨
 
 class Node
 {
 public:
 	int key{};
-	Node* next{};
+	atomic<Node*> next{};
 	Node() = default;
 	Node(int newKey) { key = newKey; }
 	~Node() = default;
 };
 
-// 忡   ߰ Ŭ
+Magazine<Node, MAX_THREADS> magazine{};
+NodeStats<MAX_THREADS> stats{};
+
+// 노드에 스탬프 정보를 추가한 클래스
 class Ptr
 {
 public:
-	Node* volatile node{};
-	volatile int stamp{};
+	atomic<Node*> node{};
+	int stamp{};
 
 	Ptr() = default;
-	Ptr(Node* newPtr, int newStamp) { node = newPtr; stamp = newStamp; }
+	Ptr(Node* newPtr, int newStamp) { node.store(newPtr, memory_order_relaxed); stamp = newStamp; }
 };
 
 class Queue
@@ -51,76 +71,243 @@ public:
 
 	void init()
 	{
+		Node* sentinel{ head.node.load(memory_order_relaxed) };
 		Node* node{};
-		while (head.node->next)
+		while (sentinel->next.load(memory_order_relaxed))
 		{
-			node = head.node->next;
-			head.node->next = head.node->next->next;
+			node = sentinel->next.load(memory_order_relaxed);
+			sentinel->next.store(node->next.load(memory_order_relaxed), memory_order_relaxed);
 			delete node;
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
 		}
-		tail = head;
+		tail.node.store(sentinel, memory_order_relaxed);
+		tail.stamp = head.stamp;
 	}
 
-	bool CAS(Node* volatile* node, Node* oldNode, Node* newNode)
+	bool CAS(atomic<Node*>& next, Node* oldNode, Node* newNode)
 	{ 
-		return atomic_compare_exchange_strong(
-			reinterpret_cast<volatile atomic<integer>*>(node),
-			reinterpret_cast<integer*>(&oldNode),
-			reinterpret_cast<integer>(newNode));		// newNode ̹Ƿ 
+		return next.compare_exchange_strong(oldNode, newNode, memory_order_release, memory_order_relaxed);
 	}
-	// CAS Ѵٸ  1 
-	bool stampCAS(Ptr* node, Node* oldNode, int oldStamp, Node* newNode)
+	// 포인터 크기만큼만 CAS하던 것과 같다. -> 노드만 비교하고 교환하며, 스탬프는 비교되지도 증가하지도 않는다.
+	bool stampCAS(Ptr* ptr, Node* oldNode, int /*oldStamp*/, Node* newNode)
 	{ 
-		Ptr oldPtr{ oldNode, oldStamp };
-		Ptr newPtr{ newNode, oldStamp + 1 };
-		return atomic_compare_exchange_strong(
-			reinterpret_cast<atomic<integer>*>(node),
-			reinterpret_cast<integer*>(&oldPtr),
-			*(reinterpret_cast<integer*>(&newPtr)));	// newPtr Ͱ ƴϹǷ ̷
+		return ptr->node.compare_exchange_strong(oldNode, newNode, memory_order_release, memory_order_relaxed);
 	}
 
 	void push(int key)
 	{
 		Node* newNode{ new Node{key} };
+		stats.onAlloc(THREAD_ID);
+
+		while (true)
+		{
+			Node* cur{ tail.node.load(memory_order_acquire) };
+			int curStamp{ tail.stamp };
+			Node* next{ cur->next.load(memory_order_acquire) };
+
+			if (cur != tail.node.load(memory_order_relaxed)) continue;
+			if (!next)
+			{
+				if (CAS(cur->next, nullptr, newNode))
+				{
+					stampCAS(&tail, cur, curStamp, newNode);
+					return;
+				}
+			}
+			else stampCAS(&tail, cur, curStamp, next);
+		}
+	}
+	int pop()
+	{
+		while (true)
+		{
+			Node* cur{ head.node.load(memory_order_acquire) };
+			int curStamp{ head.stamp };
+			Node* last{ tail.node.load(memory_order_acquire) };
+			int lastStamp{ tail.stamp };
+			Node* next{ cur->next.load(memory_order_acquire) };
+
+			if (cur != head.node.load(memory_order_relaxed)) continue;
+			if (!next) return -1;
+			if (cur == last) { stampCAS(&tail, last, lastStamp, next); continue; }
+
+			int result{ next->key };	// cur은 보초노드이므로 next를 반환
+			if (!stampCAS(&head, cur, curStamp, next)) continue;
+			delete cur;
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
+			return result;
+		}
+	}
+	void printElement(int count)
+	{
+		Node* cur{ head.node.load()->next };
+		while (cur)
+		{
+			cout << cur->key << ", ";
+			cur = cur->next;
+			if (!(--count)) break;
+		}
+		cout << endl;
+	}
+};
+
+// 한번에 읽은 {노드, 스탬프}
+struct Stamped
+{
+	Node* node;
+	unsigned long long stamp;
+};
+
+// 16바이트 {노드, 스탬프}. CAS는 두 필드를 한번에 비교하고 스탬프를 1 증가
+class alignas(2 * sizeof(void*)) WidePtr
+{
+private:
+	Node* volatile node{};
+	volatile uintptr_t stamp{};
+public:
+	void store(Node* newNode) { node = newNode; }
+	Node* getNode() { return node; }
+	// 두 필드를 따로 읽으므로 어긋난 쌍을 읽을 수 있다. -> 그런 쌍으로는 CAS가 실패한다.
+	Stamped load()
+	{
+		uintptr_t oldStamp{ stamp };
+		return { node, oldStamp };
+	}
+	bool CAS(const Stamped& old, Node* newNode)
+	{
+#if defined(_MSC_VER) && defined(_M_X64)
+		long long comparand[2]{ reinterpret_cast<long long>(old.node), static_cast<long long>(old.stamp) };
+		return _InterlockedCompareExchange128(reinterpret_cast<volatile long long*>(this),
+			static_cast<long long>(old.stamp + 1), reinterpret_cast<long long>(newNode), comparand);
+#elif defined(__x86_64__)
+		uintptr_t expectedNode{ reinterpret_cast<uintptr_t>(old.node) }, expectedStamp{ old.stamp };
+		bool result{};
+		__asm__ __volatile__("lock cmpxchg16b %1\n\tsete %0"
+			: "=q"(result), "+m"(*this), "+a"(expectedNode), "+d"(expectedStamp)
+			: "b"(reinterpret_cast<uintptr_t>(newNode)), "c"(old.stamp + 1)
+			: "cc", "memory");
+		return result;
+#else
+		// 32비트에서는 {노드, 스탬프}가 8바이트이므로 64비트 CAS로 충분하다.
+		long long oldVal{ static_cast<long long>((static_cast<unsigned long long>(static_cast<uint32_t>(old.stamp)) << 32) | reinterpret_cast<uint32_t>(old.node)) };
+		long long newVal{ static_cast<long long>((static_cast<unsigned long long>(static_cast<uint32_t>(old.stamp + 1)) << 32) | reinterpret_cast<uint32_t>(newNode)) };
+		return atomic_compare_exchange_strong(reinterpret_cast<atomic<long long>*>(this), &oldVal, newVal);
+#endif
+	}
+};
+
+// | stamp(16) | node(48) |
+class PackedPtr
+{
+private:
+	static constexpr int STAMP_SHIFT{ 48 };
+	static constexpr unsigned long long NODE_MASK{ (1ULL << STAMP_SHIFT) - 1 };
+private:
+	atomic<unsigned long long> value{};
+public:
+	void store(Node* newNode) { value.store(reinterpret_cast<uintptr_t>(newNode), memory_order_relaxed); }
+	Node* getNode() { return reinterpret_cast<Node*>(static_cast<uintptr_t>(value.load(memory_order_relaxed) & NODE_MASK)); }
+	Stamped load()
+	{
+		unsigned long long val{ value.load(memory_order_acquire) };
+		return { reinterpret_cast<Node*>(static_cast<uintptr_t>(val & NODE_MASK)), val >> STAMP_SHIFT };
+	}
+	bool CAS(const Stamped& old, Node* newNode)
+	{
+		unsigned long long oldVal{ (old.stamp << STAMP_SHIFT) | reinterpret_cast<uintptr_t>(old.node) };
+		unsigned long long newVal{ (((old.stamp + 1) & 0xFFFF) << STAMP_SHIFT) | reinterpret_cast<uintptr_t>(newNode) };
+		return value.compare_exchange_strong(oldVal, newVal, memory_order_release, memory_order_relaxed);
+	}
+};
+
+template <class Ptr>
+class StampQueue
+{
+	Ptr head{};
+	Ptr tail{};
+public:
+	StampQueue()
+	{
+		Node* sentinel{ newNode(0) };
+		head.store(sentinel);
+		tail.store(sentinel);
+	}
+	~StampQueue() = default;
+
+	void init()
+	{
+		Node* sentinel{ head.getNode() };
+		Node* node{};
+		while (sentinel->next.load(memory_order_relaxed))
+		{
+			node = sentinel->next.load(memory_order_relaxed);
+			sentinel->next.store(node->next.load(memory_order_relaxed), memory_order_relaxed);
+			magazine.free(THREAD_ID, node);
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
+		}
+		tail.store(sentinel);
+	}
+	Node* newNode(int key)
+	{
+		Node* node{ magazine.alloc(THREAD_ID) };
+		stats.onAlloc(THREAD_ID);
+		node->key = key;
+		node->next.store(nullptr, memory_order_relaxed);		// 연결하는 CAS가 release이므로 relaxed
+		return node;
+	}
+
+	bool CAS(atomic<Node*>& next, Node* oldNode, Node* newNode)
+	{
+		return next.compare_exchange_strong(oldNode, newNode, memory_order_release, memory_order_relaxed);
+	}
+
+	void push(int key)
+	{
+		Node* node{ newNode(key) };
 
 		while (true)
 		{
-			Ptr cur{ tail };
-			Node* next{ cur.node->next };
+			Stamped cur{ tail.load() };
+			Node* next{ cur.node->next.load(memory_order_acquire) };
 
-			if (cur.node != tail.node) continue;
+			if (cur.node != tail.getNode()) continue;
 			if (!next)
 			{
-				if (CAS(&cur.node->next, nullptr, newNode))
+				if (CAS(cur.node->next, nullptr, node))
 				{
-					stampCAS(&tail, cur.node, cur.stamp, newNode);
+					tail.CAS(cur, node);
 					return;
 				}
 			}
-			else stampCAS(&tail, cur.node, cur.stamp, next);
+			else tail.CAS(cur, next);
 		}
 	}
 	int pop()
 	{
 		while (true)
 		{
-			Ptr cur{ head };
-			Ptr last{ tail };
-			Node* next{ cur.node->next };
+			Stamped cur{ head.load() };
+			Stamped last{ tail.load() };
+			Node* next{ cur.node->next.load(memory_order_acquire) };
 
-			if (cur.node != head.node) continue;
+			if (cur.node != head.getNode()) continue;
 			if (!next) return -1;
-			if (cur.node == last.node) { stampCAS(&tail, last.node, last.stamp, last.node->next); continue; }
+			if (cur.node == last.node) { tail.CAS(last, next); continue; }
 
-			int result{ next->key };	// cur ʳ̹Ƿ next ȯ
-			if (!stampCAS(&head, cur.node, cur.stamp, next)) continue;
-			delete cur.node;
+			int result{ next->key };	// cur은 보초노드이므로 next를 반환
+			if (!head.CAS(cur, next)) continue;
+			magazine.free(THREAD_ID, cur.node);		// 재사용되어도 스탬프가 다르므로 CAS가 실패한다.
+			stats.onRemove(THREAD_ID);
+			stats.onFree(THREAD_ID);
 			return result;
 		}
 	}
 	void printElement(int count)
 	{
-		Node* cur{ head.node->next };
+		Node* cur{ head.getNode()->next.load() };
 		while (cur)
 		{
 			cout << cur->key << ", ";
@@ -132,40 +319,70 @@ public:
 };
 
 constexpr int NUM_TEST{ 10000000 };
-constexpr int MAX_THREADS{ 8 };
 
 Queue que;
+StampQueue<WidePtr> wideQue;
+StampQueue<PackedPtr> packedQue;
 
-void ThreadFunc(int numOfThread)
+template <class Q>
+void ThreadFunc(Q* que, int numOfThread, int threadID)
 {
+	THREAD_ID = threadID;
+
 	for (int i = 0; i < NUM_TEST / numOfThread; ++i)
 	{
 		switch (rand() % 2)
 		{
-		case 0: que.push(i); break;
-		case 1: que.pop(); break;
+		case 0: que->push(i); break;
+		case 1: que->pop(); break;
 		default: cout << "Error\n"; exit(-1);
 		}
 	}
 }
 
-int main()
+template <class Q>
+void Benchmark(Q& que, const char* name)
 {
 	vector<thread> threads{};
+	RssSampler sampler{};
 
+	cout << name << "\n";
 	for (int i = 1; i <= MAX_THREADS; i *= 2)
 	{
 		threads.clear();
 		que.init();
 
+		sampler.start();
 		auto start{ high_resolution_clock::now() };
 
-		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc, i);
+		for (int j = 0; j < i; ++j) threads.emplace_back(ThreadFunc<Q>, &que, i, j);
 		for (auto& thread : threads) thread.join();
+		sampler.stop();
 
 		que.printElement(20);
 
 		auto duration{ high_resolution_clock::now() - start };
-		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds\n";
+		double seconds{ duration_cast<microseconds>(duration).count() / 1000000.0 };
+		cout << i << " Threads Duration = " << duration_cast<milliseconds>(duration).count() << " milliseconds, ";
+		cout << duration_cast<nanoseconds>(duration).count() / NUM_TEST << " ns/op\n";
+		stats.print();
+		cout << "\tRSS: avg = " << sampler.getAverage() / MEGABYTE << " MB, peak = " << sampler.getPeak() / MEGABYTE << " MB, ";
+		cout << static_cast<long long>(NUM_TEST / seconds / (sampler.getPeak() / MEGABYTE)) << " ops/sec/MB\n";
 	}
+}
+
+int main()
+{
+	// 기존 Queue는 pop한 노드를 바로 delete하므로 다른 스레드가 읽는 중일 수 있다. -> 스트레스 테스트는 StampQueue만
+	stressQueue(MAX_THREADS, STRESS_OPS, true,
+		[](int threadID, int value) { THREAD_ID = threadID; wideQue.push(value); },
+		[](int threadID) { THREAD_ID = threadID; return wideQue.pop(); });
+	stressQueue(MAX_THREADS, STRESS_OPS, true,
+		[](int threadID, int value) { THREAD_ID = threadID; packedQue.push(value); },
+		[](int threadID) { THREAD_ID = threadID; return packedQue.pop(); });
+
+	// 기존 Queue는 스탬프가 비교되지 않으므로 노드를 재사용하면 안된다. -> new, delete 유지
+	Benchmark(que, "[Queue: pointer-size CAS]");
+	Benchmark(wideQue, "[StampQueue<WidePtr>: 16byte CAS]");
+	Benchmark(packedQue, "[StampQueue<PackedPtr>: 16bit stamp]");
 }
\ No newline at end of file
@@ -15,8 +15,8 @@ volatile int sum{};
 class BakeryLock
 {
 private:
-	atomic<bool> flag[MAX_THREADS]{};	// ش 尡 ڿ  غ Ǿ°
-	atomic<int> label[MAX_THREADS]{};	// ش  ڿ 켱
+	atomic<bool> flag[MAX_THREADS]{};	// 해당 스레드가 자원을 점유할 준비가 되었는가
+	atomic<int> label[MAX_THREADS]{};	// 해당 스레드의 자원점유 우선순위
 public:
 	void lock(int threadID)
 	{
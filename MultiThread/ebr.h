@@ -0,0 +1,112 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <climits>
+#include <memory>
+
+/*
+	에포크 기반 메모리 재사용 (Epoch Based Reclamation)
+
+	1. 스레드는 연산을 시작할 때 전역 에포크를 자신의 슬롯에 알리고, 연산이 끝나면 슬롯을 비운다.
+	2. 리스트에서 떼어낸 노드는 그 시점의 에포크와 함께 스레드별 림보 리스트에 보관한다.
+	3. 림보 리스트가 일정 크기 이상 쌓이면, 모든 스레드가 알린 에포크보다 먼저 떼어낸 노드를 한번에 delete한다.
+	   -> 그 노드를 떼어낸 뒤에 연산을 시작한 스레드는 그 노드에 도달할 수 없다.
+
+	※ 순회 중에는 추가적인 원자연산이 없다. (연산마다 시작, 종료시 한번씩)
+	※ 어떤 스레드가 연산 도중 멈추면, 그 이후에 떼어낸 노드는 해제되지 않는다.
+	※ 해제 방법은 Deleter로 바꿀 수 있다. (기본은 delete, 풀을 쓰는 경우 풀에 반환)
+	※ 에포크를 알린 뒤와 reclaim에서 슬롯을 읽기 전에만 full fence가 필요하다. (StoreLoad)
+*/
+
+template <class T, int MAX_THREADS, class Deleter = std::default_delete<T>>
+class EBR
+{
+private:
+	static constexpr unsigned long long INACTIVE{ ULLONG_MAX };
+	static constexpr int EPOCH_FREQ{ 64 };		// 스레드가 이만큼 떼어낼 때마다 전역 에포크를 증가
+	static constexpr size_t RECLAIM_FREQ{ 256 };	// 림보 리스트가 이만큼 쌓이면 해제를 시도
+
+	struct Retired
+	{
+		T* node;
+		unsigned long long epoch;
+	};
+	struct alignas(64) Reservation
+	{
+		std::atomic<unsigned long long> epoch{ INACTIVE };
+	};
+	struct alignas(64) Limbo
+	{
+		std::vector<Retired> nodes{};
+		int retireCount{};
+	};
+private:
+	std::atomic<unsigned long long> epoch{ 1 };
+	Reservation reservations[MAX_THREADS]{};
+	Limbo limbo[MAX_THREADS]{};
+	bool enabled{ true };
+public:
+	EBR() = default;
+	~EBR() { clear(); }
+
+	// false라면 떼어낸 노드를 해제하지 않는다. (메모리 릭 버전과 비교용)
+	void setEnabled(bool flag) { enabled = flag; }
+
+	void start(int threadID)
+	{
+		reservations[threadID].epoch.store(epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);		// 알린 에포크가 이후의 순회보다 먼저 보여야 한다.
+	}
+	void end(int threadID) { reservations[threadID].epoch.store(INACTIVE, std::memory_order_release); }
+	void retire(int threadID, T* node)
+	{
+		if (!enabled) return;
+
+		Limbo& limboList{ limbo[threadID] };
+		limboList.nodes.push_back({ node, epoch.load(std::memory_order_relaxed) });
+		if (++limboList.retireCount % EPOCH_FREQ == 0) epoch.fetch_add(1, std::memory_order_relaxed);
+		if (limboList.nodes.size() >= RECLAIM_FREQ) reclaim(limboList);
+	}
+	// 드물게 떼어내는 큰 객체(해시 테이블 등)용. 림보 리스트가 쌓이기를 기다리지 않고 에포크를 올린 뒤 바로 해제를 시도한다.
+	// -> 이전에 떼어낸 객체는 그 뒤로 모든 스레드가 연산을 새로 시작했다면 해제된다.
+	void retireNow(int threadID, T* node)
+	{
+		if (!enabled) return;
+
+		Limbo& limboList{ limbo[threadID] };
+		limboList.nodes.push_back({ node, epoch.fetch_add(1, std::memory_order_acq_rel) });
+		reclaim(limboList);
+	}
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void clear()
+	{
+		for (auto& limboList : limbo)
+		{
+			for (auto& retired : limboList.nodes) Deleter{}(retired.node);
+			limboList.nodes.clear();
+		}
+	}
+private:
+	void reclaim(Limbo& limboList)
+	{
+		unsigned long long minEpoch{ INACTIVE };
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		for (auto& reservation : reservations)
+		{
+			unsigned long long reserved{ reservation.epoch.load(std::memory_order_acquire) };
+			if (reserved < minEpoch) minEpoch = reserved;
+		}
+
+		std::vector<Retired>& nodes{ limboList.nodes };
+		for (size_t i = 0; i < nodes.size();)
+		{
+			if (nodes[i].epoch < minEpoch)
+			{
+				Deleter{}(nodes[i].node);
+				nodes[i] = nodes.back();
+				nodes.pop_back();
+			}
+			else ++i;
+		}
+	}
+};
@@ -0,0 +1,104 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <memory>
+
+/*
+	해저드 포인터 (Hazard Pointer)
+
+	1. 스레드는 공유 포인터를 역참조하기 전에 자신의 해저드 슬롯에 그 포인터를 게시하고, 원본이 그대로인지 다시 확인한다.
+	2. 떼어낸 노드는 스레드별 retire 리스트에 보관한다.
+	3. retire 리스트가 임계값을 넘으면, 어떤 스레드의 해저드 슬롯에도 없는 노드만 delete한다. (scan)
+
+	※ 게시된 노드는 해제되지도, 재사용되지도 않으므로 ABA가 발생하지 않는다.
+	※ 해제되지 않고 남는 노드는 최대 (스레드 수 * 해저드 수 + 임계값)개로 제한된다.
+	※ 해제 방법은 Deleter로 바꿀 수 있다. (기본은 delete)
+	※ 게시와 재확인 사이, scan의 해저드 읽기 앞에는 full fence가 필요하다. (StoreLoad) -> 나머지는 relaxed, acquire
+*/
+
+template <class T, int MAX_THREADS, int NUM_HAZARDS = 2, class Deleter = std::default_delete<T>>
+class HazardPointer
+{
+private:
+	struct alignas(64) Slot
+	{
+		std::atomic<T*> hazards[NUM_HAZARDS]{};
+	};
+	struct alignas(64) RetireList
+	{
+		std::vector<T*> nodes{};
+	};
+private:
+	Slot slots[MAX_THREADS]{};
+	RetireList retireLists[MAX_THREADS]{};
+	size_t scanThreshold{};
+	bool enabled{ true };
+public:
+	explicit HazardPointer(size_t threshold = 2 * MAX_THREADS * NUM_HAZARDS) { scanThreshold = threshold; }
+	~HazardPointer() { clear(); }
+
+	// false라면 떼어낸 노드를 해제하지 않는다. (메모리 릭 버전과 비교용)
+	void setEnabled(bool flag) { enabled = flag; }
+	void setScanThreshold(size_t threshold) { scanThreshold = threshold; }
+
+	// src가 가리키는 노드를 index번 슬롯에 게시하고 반환한다.
+	T* protect(int threadID, int index, const std::atomic<T*>& src)
+	{
+		T* ptr{ src.load(std::memory_order_relaxed) };
+		while (true)
+		{
+			slots[threadID].hazards[index].store(ptr, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);		// 게시가 재확인보다 먼저 보여야 한다.
+			T* again{ src.load(std::memory_order_acquire) };
+			if (again == ptr) return ptr;
+			ptr = again;
+		}
+	}
+	void release(int threadID)
+	{
+		for (auto& hazard : slots[threadID].hazards) hazard.store(nullptr, std::memory_order_release);
+	}
+	void retire(int threadID, T* node)
+	{
+		if (!enabled) return;
+
+		std::vector<T*>& nodes{ retireLists[threadID].nodes };
+		nodes.push_back(node);
+		if (nodes.size() >= scanThreshold) scan(nodes);
+	}
+	// 모든 스레드가 종료된 뒤에만 호출해야 한다.
+	void clear()
+	{
+		for (auto& retireList : retireLists)
+		{
+			for (auto node : retireList.nodes) Deleter{}(node);
+			retireList.nodes.clear();
+		}
+	}
+private:
+	void scan(std::vector<T*>& nodes)
+	{
+		std::vector<T*> hazards{};
+		hazards.reserve(MAX_THREADS * NUM_HAZARDS);
+		std::atomic_thread_fence(std::memory_order_seq_cst);		// 떼어낸 뒤에 게시된 해저드를 놓치지 않도록
+		for (auto& slot : slots)
+			for (auto& hazard : slot.hazards)
+			{
+				T* ptr{ hazard.load(std::memory_order_acquire) };
+				if (ptr) hazards.push_back(ptr);
+			}
+		std::sort(hazards.begin(), hazards.end());
+
+		for (size_t i = 0; i < nodes.size();)
+		{
+			if (!std::binary_search(hazards.begin(), hazards.end(), nodes[i]))
+			{
+				Deleter{}(nodes[i]);
+				nodes[i] = nodes.back();
+				nodes.pop_back();
+			}
+			else ++i;
+		}
+	}
+};
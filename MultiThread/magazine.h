@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <utility>
+
+/*
+	매거진 노드 캐시 (Magazine)
+
+	1. 스레드마다 노드를 MAGAZINE_SIZE개까지 담는 매거진 2개(loaded, previous)를 가진다.
+	2. alloc, free는 자신의 매거진에서만 꺼내고 넣는다. -> 락, 원자연산 없음
+	3. loaded가 비거나 가득 차면 previous와 바꾼다. previous는 항상 비어있거나 가득 차있다.
+	4. 둘 다 안되면 공유 창고(depot)와 가득 찬 매거진을 통째로 주고받는다. -> 락은 최소 MAGAZINE_SIZE번에 한번
+	5. 창고에도 가득 찬 매거진이 없으면 노드 MAGAZINE_SIZE개를 new[] 한번으로 할당한다.
+
+	※ 노드는 프로그램이 끝날 때까지 운영체제에 반환하지 않는다. -> 해제된 노드를 읽어도 크래시가 나지는 않는다.
+	※ 꺼낸 노드는 이전에 쓰던 값을 그대로 가지고 있으므로 사용하는 쪽에서 초기화해야한다.
+*/
+
+template <class T, int MAX_THREADS, size_t MAGAZINE_SIZE = 64>
+class Magazine
+{
+private:
+	using Rounds = std::vector<T*>;
+
+	struct alignas(64) Cache
+	{
+		Rounds loaded{}, previous{};
+		size_t requests{};		// alloc, free 호출 수 -> new, delete를 썼다면 할당자를 호출했을 횟수
+	};
+private:
+	Cache caches[MAX_THREADS]{};
+	std::mutex depotMtx{};
+	std::vector<Rounds> fullMagazines{}, emptyMagazines{};
+	std::vector<T*> blocks{};
+	std::atomic<size_t> allocatorCalls{};
+public:
+	Magazine() = default;
+	~Magazine() { for (auto block : blocks) delete[] block; }
+
+	T* alloc(int threadID)
+	{
+		Cache& cache{ caches[threadID] };
+		++cache.requests;
+
+		if (cache.loaded.empty()) std::swap(cache.loaded, cache.previous);
+		if (cache.loaded.empty()) takeFull(cache.loaded);
+
+		T* node{ cache.loaded.back() };
+		cache.loaded.pop_back();
+		return node;
+	}
+	void free(int threadID, T* node)
+	{
+		Cache& cache{ caches[threadID] };
+		++cache.requests;
+
+		if (cache.loaded.size() == MAGAZINE_SIZE) std::swap(cache.loaded, cache.previous);
+		if (cache.loaded.size() == MAGAZINE_SIZE) giveFull(cache.loaded);
+
+		cache.loaded.push_back(node);
+	}
+
+	// 실제로 할당자(new[])를 호출한 횟수
+	size_t getAllocatorCalls() { return allocatorCalls; }
+	// 모든 스레드의 alloc, free 호출 수. 스레드가 모두 종료된 뒤에만 호출해야 한다.
+	size_t getRequests()
+	{
+		size_t sum{};
+		for (auto& cache : caches) sum += cache.requests;
+		return sum;
+	}
+	void resetCount()
+	{
+		allocatorCalls = 0;
+		for (auto& cache : caches) cache.requests = 0;
+	}
+private:
+	// 빈 매거진을 창고의 가득 찬 매거진과 바꾼다.
+	void takeFull(Rounds& magazine)
+	{
+		{
+			std::lock_guard<std::mutex> lock{ depotMtx };
+			if (!fullMagazines.empty())
+			{
+				std::swap(magazine, fullMagazines.back());
+				emptyMagazines.push_back(std::move(fullMagazines.back()));
+				fullMagazines.pop_back();
+				return;
+			}
+		}
+
+		T* block{ new T[MAGAZINE_SIZE] };
+		allocatorCalls.fetch_add(1, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock{ depotMtx };
+			blocks.push_back(block);
+		}
+		magazine.reserve(MAGAZINE_SIZE);
+		for (size_t i = 0; i < MAGAZINE_SIZE; ++i) magazine.push_back(&block[i]);
+	}
+	// 가득 찬 매거진을 창고에 넘기고 빈 매거진을 받아온다.
+	void giveFull(Rounds& magazine)
+	{
+		std::lock_guard<std::mutex> lock{ depotMtx };
+		fullMagazines.push_back(std::move(magazine));
+		magazine = Rounds{};
+		if (!emptyMagazines.empty())
+		{
+			std::swap(magazine, emptyMagazines.back());
+			emptyMagazines.pop_back();
+		}
+	}
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <thread>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <fstream>
+#include <unistd.h>
+#endif
+
+constexpr double MEGABYTE{ 1024.0 * 1024.0 };
+
+// 현재 프로세스의 상주 메모리(RSS) 크기를 바이트 단위로 반환
+inline size_t getResidentMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc{};
+	GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+	return pmc.WorkingSetSize;
+#else
+	size_t pages{}, resident{};
+	std::ifstream statm{ "/proc/self/statm" };
+	statm >> pages >> resident;
+	return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// 별도의 스레드에서 주기적으로 RSS를 측정해 평균과 최댓값을 기록한다.
+class RssSampler
+{
+private:
+	std::thread sampler{};
+	std::atomic<bool> running{};
+	std::chrono::milliseconds interval{};
+	size_t peak{}, total{}, count{};
+public:
+	explicit RssSampler(std::chrono::milliseconds period = std::chrono::milliseconds{ 10 }) { interval = period; }
+	~RssSampler() { stop(); }
+
+	void start()
+	{
+		peak = total = count = 0;
+		sample();
+		running = true;
+		sampler = std::thread{ [this]
+			{
+				while (running)
+				{
+					std::this_thread::sleep_for(interval);
+					sample();
+				}
+			} };
+	}
+	void stop()
+	{
+		if (!running) return;
+		running = false;
+		sampler.join();
+		sample();
+	}
+	// 바이트 단위, stop 이후에 읽어야 한다.
+	double getPeak() { return static_cast<double>(peak); }
+	double getAverage() { return count ? static_cast<double>(total) / count : 0.0; }
+private:
+	void sample()
+	{
+		size_t resident{ getResidentMemory() };
+		if (resident > peak) peak = resident;
+		total += resident;
+		++count;
+	}
+};
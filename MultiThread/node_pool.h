@@ -0,0 +1,116 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <new>
+#include <cstdint>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/*
+	노드 아레나 (Node Pool)
+
+	1. 노드를 미리 예약해둔 하나의 연속된 주소공간에 모아두고, 포인터 대신 32비트 인덱스로 가리킨다.
+	   -> 인덱스를 주소로 바꾸는 비용은 덧셈 한번
+	2. 주소공간은 슬랩(64바이트에 정렬된 노드 배열) 단위로 필요할 때 커밋하고 노드를 생성한다.
+	3. 할당은 스레드별 free 리스트에서 꺼내거나, 스레드가 미리 예약해둔 인덱스 구간을 하나씩 증가(bump)시킨다.
+	4. 해제한 노드는 스레드별 free 리스트에 넣어두고 재사용한다.
+
+	※ 인덱스 0(NIL)은 nullptr의 의미로 사용한다.
+	※ 슬랩의 노드는 슬랩을 만들 때 한번 생성되고 이후로는 재사용만 한다. -> mutex를 가진 노드도 사용 가능
+*/
+
+constexpr uint32_t NIL{ 0 };
+
+template <class T, int MAX_THREADS, uint32_t MAX_NODES = (sizeof(void*) == 8 ? (1u << 26) : (1u << 22))>
+class NodePool
+{
+private:
+	static constexpr int SLAB_BITS{ 16 };
+	static constexpr uint32_t SLAB_SIZE{ 1u << SLAB_BITS };		// 슬랩 하나의 노드 수
+	static constexpr uint32_t MAX_SLABS{ MAX_NODES / SLAB_SIZE };
+	static constexpr uint32_t CHUNK_SIZE{ 256 };				// 스레드가 한번에 예약하는 인덱스 수
+
+	struct alignas(64) Cache
+	{
+		std::vector<uint32_t> freeList{};
+		uint32_t bump{}, end{};
+	};
+private:
+	T* nodes{};
+	std::atomic<bool> made[MAX_SLABS]{};
+	std::atomic<uint32_t> reserved{};
+	Cache caches[MAX_THREADS]{};
+	std::mutex slabMtx{};
+public:
+	NodePool()
+	{
+#ifdef _WIN32
+		nodes = static_cast<T*>(VirtualAlloc(nullptr, sizeof(T) * size_t{ MAX_NODES }, MEM_RESERVE, PAGE_NOACCESS));
+#else
+		void* addr{ mmap(nullptr, sizeof(T) * size_t{ MAX_NODES }, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0) };
+		nodes = (MAP_FAILED == addr) ? nullptr : static_cast<T*>(addr);
+#endif
+		if (!nodes) throw std::bad_alloc{};
+	}
+	~NodePool()
+	{
+		for (uint32_t slab = 0; slab < MAX_SLABS; ++slab)
+		{
+			if (!made[slab].load(std::memory_order_relaxed)) continue;
+			for (uint32_t i = 0; i < SLAB_SIZE; ++i) nodes[slab * SLAB_SIZE + i].~T();
+		}
+#ifdef _WIN32
+		VirtualFree(nodes, 0, MEM_RELEASE);
+#else
+		munmap(nodes, sizeof(T) * size_t{ MAX_NODES });
+#endif
+	}
+
+	T* get(uint32_t index) { return nodes + index; }
+	// 노드에 인덱스를 저장할 자리가 없을 때 주소에서 인덱스를 구한다.
+	uint32_t indexOf(T* node) { return static_cast<uint32_t>(node - nodes); }
+	uint32_t alloc(int threadID)
+	{
+		Cache& cache{ caches[threadID] };
+		if (!cache.freeList.empty())
+		{
+			uint32_t index{ cache.freeList.back() };
+			cache.freeList.pop_back();
+			return index;
+		}
+		if (cache.bump == cache.end)
+		{
+			uint32_t start{ reserved.fetch_add(CHUNK_SIZE, std::memory_order_relaxed) };
+			if (start >= MAX_NODES) throw std::bad_alloc{};
+			makeSlab(start >> SLAB_BITS);
+			cache.bump = (NIL == start) ? start + 1 : start;
+			cache.end = start + CHUNK_SIZE;
+		}
+		return cache.bump++;
+	}
+	void free(int threadID, uint32_t index) { caches[threadID].freeList.push_back(index); }
+	// 지금까지 예약된 노드 수
+	size_t capacity() { return reserved.load(std::memory_order_relaxed); }
+private:
+	void makeSlab(uint32_t slab)
+	{
+		if (made[slab].load(std::memory_order_acquire)) return;
+
+		std::lock_guard<std::mutex> lock{ slabMtx };
+		if (made[slab].load(std::memory_order_relaxed)) return;
+
+		T* first{ nodes + size_t{ slab } * SLAB_SIZE };
+#ifdef _WIN32
+		VirtualAlloc(first, sizeof(T) * SLAB_SIZE, MEM_COMMIT, PAGE_READWRITE);
+#endif
+		for (uint32_t i = 0; i < SLAB_SIZE; ++i) new (&first[i]) T{};
+		made[slab].store(true, std::memory_order_release);
+	}
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <iostream>
+
+/*
+	노드 통계 (Node Stats)
+
+	1. 스레드마다 노드를 할당, 제거(자료구조에서 빠짐), 해제한 수를 따로 센다. -> 카운터를 공유하지 않으므로 원자연산이 없다.
+	2. live = 할당 - 해제 : 지금 메모리를 차지하고 있는 노드 수
+	3. unreclaimed = 제거 - 해제 : 자료구조에서는 빠졌지만 아직 해제되지 않은 노드 수 (메모리 릭, 재사용 대기)
+
+	※ 합계는 모든 스레드가 종료된 뒤에만 읽어야 한다.
+	※ 풀이나 매거진에 반환한 노드도 해제로 센다.
+*/
+
+template <int MAX_THREADS>
+class NodeStats
+{
+private:
+	struct alignas(64) Counter
+	{
+		long long allocated{}, removed{}, freed{};
+	};
+private:
+	Counter counters[MAX_THREADS]{};
+public:
+	void onAlloc(int threadID) { ++counters[threadID].allocated; }
+	void onRemove(int threadID) { ++counters[threadID].removed; }
+	void onFree(int threadID) { ++counters[threadID].freed; }
+
+	long long getAllocated() { return sum(&Counter::allocated); }
+	long long getRemoved() { return sum(&Counter::removed); }
+	long long getFreed() { return sum(&Counter::freed); }
+	long long getLive() { return getAllocated() - getFreed(); }
+	long long getUnreclaimed() { return getRemoved() - getFreed(); }
+
+	void print()
+	{
+		std::cout << "\tNodes: allocated = " << getAllocated() << ", live = " << getLive();
+		std::cout << ", removed = " << getRemoved() << ", unreclaimed = " << getUnreclaimed() << "\n";
+	}
+private:
+	long long sum(long long Counter::* field)
+	{
+		long long total{};
+		for (auto& counter : counters) total += counter.*field;
+		return total;
+	}
+};
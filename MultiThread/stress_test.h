@@ -0,0 +1,270 @@
+#pragma once
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/*
+	스트레스 테스트
+
+	1. stressSet: 스레드마다 자기 몫의 키(key % 스레드 수 == 스레드 번호)만 add, remove하고, contains는 모든 키에 한다.
+	   -> 자기 키에 대한 add, remove, contains의 결과는 정확히 예측할 수 있다. 끝난 뒤 모든 키의 포함 여부도 검사한다.
+	2. stressQueue: 스레드마다 (스레드 번호, 순번)을 담은 값을 push하면서 pop한다.
+	   -> 모든 값은 정확히 한번 나와야 하고, FIFO라면 같은 스레드가 넣은 값은 순번이 증가하는 순서로 나와야 한다.
+	3. stressProducerConsumer: 생산자 스레드는 push만, 소비자 스레드 하나(스레드 번호 = 생산자 수)는 pop만 한다.
+	   -> 소비자가 하나이므로 같은 생산자가 넣은 값은 순번이 하나씩 증가하며 빠짐없이 나와야 한다.
+	4. stressDeque: 주인 스레드(0번)는 자기 쪽 끝에 push, pop하고, 나머지 스레드는 반대쪽 끝에서 steal한다.
+	   -> 모든 값은 정확히 한번 나와야 하고, 훔쳐가는 쪽은 넣은 순서대로 가져가므로 스레드마다 값이 증가해야 한다.
+	5. stressPriorityQueue: 스레드마다 서로 겹치지 않는 키를 insert하면서 removeMin한다.
+	   -> 모든 키는 정확히 한번 나와야 하고, 스레드가 모두 끝난 뒤 남은 키는 작은 것부터 나와야 한다. (isStrict가 false면 순서는 검사하지 않는다.)
+
+	※ 연산은 (스레드 번호, 키)를 받는 함수로 넘긴다. -> THREAD_ID 설정은 넘기는 쪽에서 한다.
+	※ pop은 비어있으면 -1을 반환해야 한다. 넣는 값은 1 이상이다.
+	※ steal은 비어있거나 다른 스레드와 경쟁해서 졌으면 -1을 반환한다.
+	※ stressProducerConsumer의 push는 성공할 때까지 재시도해야 한다. (소비자가 따로 있으므로 가득 차도 언젠가 빈다.)
+*/
+
+constexpr int STRESS_OPS{ 100000 };		// 스레드당 연산 수
+constexpr int STRESS_KEY_RANGE{ 256 };	// 키를 좁혀서 같은 노드 주변의 경합을 늘린다.
+
+// 스레드마다 따로 쓰는 간단한 난수 생성기 (rand는 내부에서 락을 잡는다.)
+class XorShift
+{
+private:
+	unsigned state{};
+public:
+	explicit XorShift(unsigned seed) { state = seed * 2654435761u + 1; }
+	unsigned next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+};
+
+template <class Add, class Remove, class Contains>
+bool stressSet(int numThreads, int numOps, int keyRange, Add add, Remove remove, Contains contains)
+{
+	std::atomic<int> errors{};
+	std::vector<char> expected(keyRange);
+	std::vector<std::thread> threads{};
+
+	for (int t = 0; t < numThreads; ++t)
+		threads.emplace_back([&, t]
+			{
+				XorShift rng{ static_cast<unsigned>(t + 1) };
+				int numKeys{ (keyRange - t + numThreads - 1) / numThreads };
+				for (int i = 0; i < numOps; ++i)
+				{
+					unsigned r{ rng.next() };
+					int key{ static_cast<int>((r >> 2) % numKeys) * numThreads + t };
+					switch (r % 4)
+					{
+					case 0:
+						if (add(t, key) == static_cast<bool>(expected[key])) ++errors;
+						expected[key] = true;
+						break;
+					case 1:
+						if (remove(t, key) != static_cast<bool>(expected[key])) ++errors;
+						expected[key] = false;
+						break;
+					case 2:
+						if (contains(t, key) != static_cast<bool>(expected[key])) ++errors;
+						break;
+					default:
+						contains(t, static_cast<int>((r >> 2) % keyRange));		// 다른 스레드의 키
+						break;
+					}
+				}
+			});
+	for (auto& thread : threads) thread.join();
+
+	for (int key = 0; key < keyRange; ++key)
+		if (contains(0, key) != static_cast<bool>(expected[key])) ++errors;
+
+	std::cout << "[Stress Test] set: " << (errors ? "FAILED" : "OK") << " (errors = " << errors << ")\n";
+	return !errors;
+}
+
+template <class Push, class Pop>
+bool stressQueue(int numThreads, int numOps, bool isFifo, Push push, Pop pop)
+{
+	std::atomic<int> errors{};
+	std::vector<std::vector<int>> popped(numThreads);
+	std::vector<std::thread> threads{};
+
+	for (int t = 0; t < numThreads; ++t)
+		threads.emplace_back([&, t]
+			{
+				XorShift rng{ static_cast<unsigned>(t + 1) };
+				std::vector<int> lastSeq(numThreads, -1);
+				int seq{};
+				for (int i = 0; i < numOps; ++i)
+				{
+					if (rng.next() % 2) { push(t, t * numOps + seq + 1); ++seq; continue; }
+
+					int value{ pop(t) };
+					if (-1 == value) continue;
+					popped[t].push_back(value);
+
+					int producer{ (value - 1) / numOps }, order{ (value - 1) % numOps };
+					if (isFifo && order <= lastSeq[producer]) ++errors;
+					lastSeq[producer] = order;
+				}
+			});
+	for (auto& thread : threads) thread.join();
+
+	std::vector<char> seen(static_cast<size_t>(numThreads) * numOps);
+	for (int value = pop(0); -1 != value; value = pop(0)) popped[0].push_back(value);
+	for (auto& values : popped)
+		for (int value : values)
+		{
+			if (value < 1 || value > numThreads * numOps || seen[value - 1]) { ++errors; continue; }
+			seen[value - 1] = true;
+		}
+
+	// 넣은 값이 모두 나왔는지 확인하기 위해, 같은 난수열로 push 횟수를 다시 센다.
+	for (int t = 0; t < numThreads; ++t)
+	{
+		XorShift rng{ static_cast<unsigned>(t + 1) };
+		int seq{};
+		for (int i = 0; i < numOps; ++i) if (rng.next() % 2) ++seq;
+		for (int order = 0; order < numOps; ++order)
+			if (static_cast<bool>(seen[t * numOps + order]) != (order < seq)) ++errors;
+	}
+
+	std::cout << "[Stress Test] " << (isFifo ? "queue" : "stack") << ": " << (errors ? "FAILED" : "OK") << " (errors = " << errors << ")\n";
+	return !errors;
+}
+
+template <class Push, class Pop>
+bool stressProducerConsumer(int numProducers, int numOps, Push push, Pop pop)
+{
+	std::atomic<int> errors{};
+	std::vector<std::thread> threads{};
+
+	for (int t = 0; t < numProducers; ++t)
+		threads.emplace_back([&, t] { for (int seq = 0; seq < numOps; ++seq) push(t, t * numOps + seq + 1); });
+	threads.emplace_back([&]
+		{
+			std::vector<int> nextSeq(numProducers);
+			for (int received = 0; received < numProducers * numOps;)
+			{
+				int value{ pop(numProducers) };
+				if (-1 == value) { std::this_thread::yield(); continue; }
+				++received;
+
+				int producer{ (value - 1) / numOps }, order{ (value - 1) % numOps };
+				if (value < 1 || producer >= numProducers || order != nextSeq[producer]) { ++errors; continue; }
+				++nextSeq[producer];
+			}
+		});
+	for (auto& thread : threads) thread.join();
+
+	if (-1 != pop(numProducers)) ++errors;		// 넣은 것보다 많이 나오면 안된다.
+
+	std::cout << "[Stress Test] producer-consumer: " << (errors ? "FAILED" : "OK") << " (errors = " << errors << ")\n";
+	return !errors;
+}
+
+template <class Push, class Pop, class Steal>
+bool stressDeque(int numThreads, int numOps, Push push, Pop pop, Steal steal)
+{
+	std::atomic<int> errors{};
+	std::atomic<bool> done{};
+	std::vector<std::vector<int>> taken(numThreads);
+	std::vector<std::thread> threads{};
+	int pushed{};
+
+	threads.emplace_back([&]
+		{
+			XorShift rng{ 1 };
+			for (int i = 0; i < numOps; ++i)
+			{
+				if (rng.next() % 2) { push(0, ++pushed); continue; }
+				int value{ pop(0) };
+				if (-1 != value) taken[0].push_back(value);
+			}
+			done = true;
+		});
+	for (int t = 1; t < numThreads; ++t)
+		threads.emplace_back([&, t]
+			{
+				int last{};
+				while (!done)
+				{
+					int value{ steal(t) };
+					if (-1 == value) { std::this_thread::yield(); continue; }
+					if (value <= last) ++errors;
+					last = value;
+					taken[t].push_back(value);
+				}
+			});
+	for (auto& thread : threads) thread.join();
+
+	for (int value = pop(0); -1 != value; value = pop(0)) taken[0].push_back(value);
+	std::vector<char> seen(pushed);
+	for (auto& values : taken)
+		for (int value : values)
+		{
+			if (value < 1 || value > pushed || seen[value - 1]) { ++errors; continue; }
+			seen[value - 1] = true;
+		}
+	for (char flag : seen) if (!flag) ++errors;
+
+	std::cout << "[Stress Test] deque: " << (errors ? "FAILED" : "OK") << " (errors = " << errors << ")\n";
+	return !errors;
+}
+
+template <class Insert, class RemoveMin>
+bool stressPriorityQueue(int numThreads, int numOps, Insert insert, RemoveMin removeMin, bool isStrict = true)
+{
+	std::atomic<int> errors{};
+	std::vector<std::vector<int>> removed(numThreads);
+	std::vector<std::thread> threads{};
+
+	// 키는 (순번 * 스레드 수 + 스레드 번호 + 1) -> 스레드끼리 키가 섞인다.
+	for (int t = 0; t < numThreads; ++t)
+		threads.emplace_back([&, t]
+			{
+				XorShift rng{ static_cast<unsigned>(t + 1) };
+				int seq{};
+				for (int i = 0; i < numOps; ++i)
+				{
+					if (rng.next() % 2) { if (!insert(t, seq * numThreads + t + 1)) ++errors; ++seq; continue; }
+					int key{ removeMin(t) };
+					if (-1 != key) removed[t].push_back(key);
+				}
+			});
+	for (auto& thread : threads) thread.join();
+
+	int last{};
+	for (int key = removeMin(0); -1 != key; key = removeMin(0))
+	{
+		if (isStrict && key <= last) ++errors;
+		last = key;
+		removed[0].push_back(key);
+	}
+
+	std::vector<char> seen(static_cast<size_t>(numThreads) * numOps);
+	for (auto& keys : removed)
+		for (int key : keys)
+		{
+			if (key < 1 || key > numThreads * numOps || seen[key - 1]) { ++errors; continue; }
+			seen[key - 1] = true;
+		}
+
+	// 넣은 키가 모두 나왔는지 확인하기 위해, 같은 난수열로 insert 횟수를 다시 센다.
+	for (int t = 0; t < numThreads; ++t)
+	{
+		XorShift rng{ static_cast<unsigned>(t + 1) };
+		int seq{};
+		for (int i = 0; i < numOps; ++i) if (rng.next() % 2) ++seq;
+		for (int order = 0; order < numOps; ++order)
+			if (static_cast<bool>(seen[order * numThreads + t]) != (order < seq)) ++errors;
+	}
+
+	std::cout << "[Stress Test] priority queue: " << (errors ? "FAILED" : "OK") << " (errors = " << errors << ")\n";
+	return !errors;
+}
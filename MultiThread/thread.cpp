@@ -9,107 +9,107 @@ using namespace std;
 using namespace std::chrono;
 
 /*
-	μ:	 α׷		->	 ޸
-	:		α׷  帧	->	 ޸ ( )
+	프로세스:	실행중인 프로그램		->	독립 메모리
+	스레드:		프로그램 실행의 흐름	->	공유 메모리 (스택 제외)
 
-	Heterogeneous:	۾ ɰ 뵵 忡 ñ Ÿ (Ŭ̾Ʈ ַ )
-	Homogeneous:	۾ ɰ о 忡 ñ Ÿ ( ַ )
+	Heterogeneous:	작업을 쪼개 용도별로 스레드에 맡기는 스타일 (클라이언트에서 주로 사용)
+	Homogeneous:	작업을 쪼개 구분없이 스레드에 맡기는 스타일 (서버에서 주로 사용)
 
-	      (, ڵ,  )
-	 尡 ٰ   ƴ. ھ  ߴ° Ϲ (ھ    ȯ   ߻)
+	※ 스레드 각각에 고유한 스택이 존재 (데이터, 코드, 힙은 공유)
+	※ 스레드가 많다고 좋은 것이 아님. 코어의 개수에 맞추는게 일반적 (코어보다 많은 스레드 생성시 문맥전환에 대한 오버헤드 발생)
 */
 
 /*
-	)
-	1. 尣 ͸   
-	2. ޸𸮰 ֱ⿡ μ  , ȯ 尡  ĳƮ 
+	장점)
+	1. 스레드간 데이터를 공유할 수 있음
+	2. 공유메모리가 있기에 프로세스에 비해 생성, 문맥전환 오버헤드가 적고 캐시히트율이 높음
 
-	)
-	1. ͸ ϱ , ϳ 忡 ߻  μ  ĥ  
-	2.   ϰ ʱ⶧  
+	단점)
+	1. 데이터를 공유하기 때문에, 하나의 스레드에서 발생한 문제가 프로세스까지 영향을 끼칠 수 있음
+	2. 스레드 실행순서가 일관적이지 않기때문에 디버깅이 어려움
 */
 
 /*
-	)
-	DataRace:	 ޸𸮸  忡 а Ἥ ǵġ    .
-				ex) Ϳ  о    Ϸ ߿ ٸ 忡 鶧
-				 ݵ ϳ ̻   ־. ׷  ߻ϴϱ.
-				 ̱ھ ȯ Ͼ ͷ̽ Ͼ  
-	DeadLock:	  ¿  
-				ex) ߺ lock,  ̻ 尡   ڿ 䱸ϸ鼭  ڿ  
-	Convoy:		 ð ɸ 尡 ڿ  ٸ  شڿ ȹ Ǵ 
-	Lock Convoy:ڿ  尡 ڿ ݳ ʾҴµ ٸ (ȯ)Ǿ 
-				ٸ  شڿ ȹ Ǵ 
-				ھ     ߻
-	Starvation:	尣 ڿ 켱  尡  ڿ ȹ ϴ 
-	Priority	켱  尡 ڿ  켱    Ǵ 
-	Inverse:	ʿ Ȳ, 켱   ð   
-
-	  lock DataRace  Ʈ   ޸ ϰ )
-	Ϸ ȭ:	Ϸ Ƽ带  ʰ ڵ带 ȭϸ鼭  ߻ 
-					ex) ν: flag = false ->  1: while(flag) ->  2: flag = true -> ѷ
-					  ȭ ̷鼭 Ϳ  ÷ flag ϴ  ϰ 񱳸 ϴ° 
-					-> volatile ذ
-	Write Buffer:	忡 ޸𸮸 Write  ٸ Buffer ΰ ٸ ۾ .
-					CPU    ɺ ( , Out of Order Execution)ϸ鼭  ߻
-					޸𸮿 Write ϷǾ Ǵִ ϵ ־ ̱۽忡  ,
-					̴  ھ ϱ  Ƽھ  ߻  
-					-> CAS  ذ (CPU volatile  )
-	Cash Line:		CPU ޸𸮸 64byte ̷ ĳö  . ( ĳö  忡 ÿ  Ұ)
-					1.	ĳö 踦 ħ  ĳö ϰ  
-						ٸ 忡 ߰  о   -> , pragma pack 
-					2.	ڿ ִ ĳöο ϱ 尣 ȯ Ͼ  (Cash Thrashing)
-	ABA:			 A B Ǿµ ٽ A Ǵ  -> CAS ޸𸮸   ߻
-					ex) 1: A pop õ -> 2: A, B pop -> 3: A ޸𸮸  push -> 1: A pop 
-					  B popǾ ұϰ top  ޸𸮸 Ŵ
-					-> (忡 īƮ  ߰) or shared_ptr ذ
-
-	 volatile:		Ϸ ȭ ɼ   (弼 뵵 ƴ)
-					  *տ  Ͱ Ű  volatile, ڿ Ͱ volatile
+	주의점)
+	DataRace:	같은 메모리를 여러 스레드에서 읽고 써서 의도치 않은 결과가 나오는 것.
+				ex) 레지스터에 변수를 읽어와 연산 후 변수에 저장하려는 도중에 다른 스레드에서 끼어들때
+				※ 반드시 하나 이상의 쓰기 동작이 있어야함. 그래야 문제가 발생하니까.
+				※ 싱글코어에서도 문맥전환이 일어나면 데이터레이스가 일어날 수 있음
+	DeadLock:	무한정으로 대기해 교착상태에 빠지는 것
+				ex) 중복 lock, 둘 이상의 스레드가 서로 사용중인 자원을 요구하면서 각자의 자원을 놓지않을 때
+	Convoy:		상대적으로 시간이 오래걸리는 스레드가 자원을 점유해 다른 스레드의 해당자원 획득이 지연되는 것
+	Lock Convoy:자원을 점유한 스레드가 자원을 반납하지 않았는데 스케줄링에서 제외(문맥전환)되어 
+				다른 스레드의 해당자원 획득이 지연되는 것
+				코어개수보다 많은 스레드들을 생성할 때 발생
+	Starvation:	스레드간의 자원경쟁으로 우선순위가 낮은 스레드가 영원히 자원을 획득하지 못하는 것
+	Priority	우선순위가 낮은 스레드가 자원을 점유해 우선순위가 높은 스레드의 실행이 지연되는 것
+	Inverse:	필연적인 상황이지만, 우선순위가 낮은 스레드의 점유시간이 길어질수록 성능이 떨어짐
+
+	성능을 위해 lock없이 DataRace를 직접 컨트롤 할 때 메모리 일관성 문제)
+	컴파일러 최적화:	컴파일러가 멀티스레드를 고려하지 않고 코드를 최적화하면서 문제 발생 
+					ex) 메인스레드: flag = false -> 스레드 1: while(flag) -> 스레드 2: flag = true -> 무한루프
+					위 결과는 최적화가 이루어지면서 레지스터에 값을 올려 flag를 갱신하는 과정을 생략하고 비교만 하는게 원인
+					-> volatile로 해결
+	Write Buffer:	당장에 메모리를 Write할 수 없다면 Buffer에 놔두고 다른 작업을 수행함.
+					CPU가 먼저 실행 가능한 명령부터 수행(비순차적 실행, Out of Order Execution)하면서 문제 발생
+					메모리에 Write가 완료되었는지 판단해주는 하드웨어가 있어 싱글스레드에서는 문제가 없었지만,
+					이는 독립된 코어에서만 동작하기 때문에 멀티코어에서는 문제가 발생할 수 있음
+					-> CAS 연산으로 해결 (CPU는 volatile이 뭔지 모름)
+	Cash Line:		CPU는 메모리를 64byte로 이루어진 캐시라인 단위로 읽음. (한 캐시라인을 여러 스레드에서 동시에 접근 불가)
+					1.	캐시라인의 경계를 침범해 여러 캐시라인을 차지하게 될 경우
+						다른 스레드에서 중간 값을 읽어갈 수 있음 -> 포인터, pragma pack 주의
+					2.	공유자원이 있는 캐시라인에 접근하기위해 스레드간에 문맥전환이 일어나 성능저하 (Cash Thrashing)
+	ABA:			데이터 A가 B로 변경되었는데 다시 A로 변경되는 현상 -> CAS연산과 메모리를 재사용할 때 발생
+					ex) 스레드1: A pop 시도 -> 스레드2: A, B pop -> 스레드3: A 메모리를 재사용해 push -> 스레드1: A pop 성공
+					위의 결과로 B는 pop되었음에도 불구하고 top이 그 메모리를 가리킴
+					-> 스탬프(노드에 카운트 정보를 추가) or shared_ptr로 해결
+
+	※ volatile:		컴파일러의 최적화 옵션이 적용되지 않음 (스레드세이프 용도가 아님)
+					포인터의 경우 *앞에 오면 포인터가 가리키는 값이 volatile, 뒤에오면 포인터가 volatile
 */
 
 /*
 	thread)
-	join():		ش 尡   ٸ. ( 尡 ε α׷ Ǹ ȵǱ )
-				WaitForSingleObject ü
-	detach():	ش  ü  带 . (     , join()Ұ)
-	joinable():	ش 带 join() ٸ  ִ  bool ȯѴ. (detach ¶ false ȯ)
+	join():		해당 스레드가 종료될 때까지 기다린다. (아직 스레드가 실행중인데 프로그램이 종료되면 안되기 때문)
+				WaitForSingleObject를 대체
+	detach():	해당 스레드 객체에 연결된 스레드를 떼어낸다. (스레드는 계속 실행되지만 제어할 수 없음, join()불가능)
+	joinable():	해당 스레드를 join()으로 기다릴 수 있는 상태인지 bool값을 반환한다. (detach된 상태라면 false 반환)
 
 	mutex)
-	lock():		 ڿ ٸ 忡 ̸ .  ƴϸ ڽ 忡  ǥ
-	unLock():	 ǥø 
-	lock_guard<T>:	lock ɰ ڽ Ե   ڵ unlock
+	lock():		어떤 자원을 다른 스레드에서 사용중이면 대기. 사용중이 아니면 자신의 스레드에서 사용중 표시
+	unLock():	사용중 표시를 지움
+	lock_guard<T>:	lock을 걸고 자신이 포함된 스코프를 빠져나갈때 자동으로 unlock
 
-	 mutex ü  ( ڿ ϴ 帶 mutex  üϱ )
-	 Ȯ ö, ļ  os ȣϱ   ߻
-	   ,  밡 countŭ (μ) Ӱ迵   
+	※ mutex 객체는 전역변수여야함 (같은 자원을 사용하는 스레드마다 mutex도 같은 객체여야하기 때문)
+	※ 정확성은 올라가지만, 병렬성이 떨어지고 os를 호출하기 때문에 성능저하 발생
+	※ 세마포어와 비슷한 개념이지만, 세마포어는 수용가능한 count만큼 스레드(프로세스)가 임계영역에 들어갈 수 있음
 
 	atomic)
-	atomic<T>:							  ڷ (mutex , Ÿ )
-	atomic_thread_fence():				 ɾ     ɾ   ϰ 
-	atomic_compare_exchange_strong():	μ1 μ2  μ3 μ1 ϰ true ȯ
-										ȣ ~ Ϸ ٸ尡   
+	atomic<T>:							스레드 세이프한 자료형 (mutex보다 빠르지만, 타입제한이 존재)
+	atomic_thread_fence():				앞 명령어들의 수행이 끝나기 전까지 뒤 명령어들의 수행을 시작하지 못하게 함
+	atomic_compare_exchange_strong():	인수1과 인수2가 같으면 인수3을 인수1에 대입하고 true를 반환
+										호출 ~ 완료까지 다른스레드가 끼어들 수 없음
 										-> CAS (Compare And Set)
 	non-block)
-	wait-free:	 Լ  ð  ħ
-	lock-free:	ϳ ̻ Լ  ð  ħ
+	wait-free:	모든 함수가 정해진 시간에 수행을 끝마침
+	lock-free:	하나 이상의 함수가 정해진 시간에 수행을 끝마침
 
-		Lock ̿ϸ  Լ  ð  ĥ  .
-		Lock  CAS ̿ ŷ ڷᱸ  ȭϴ  ٶϴ.
-		CAS а   , 尣   쿡 CAS  ֱ⸦ ξ Ѵ.
-		-> ֱ⸦ Ҽ , Ҽ ª  (̸ BackOff Ѵ.)
+	※	Lock을 이용하면 모든 함수가 정해진 시간에 수행을 끝마칠 수 없다.
+		Lock 없이 CAS를 이용한 논블로킹 자료구조를 사용해 동기화하는 것이 바람직하다.
+	※	CAS의 실패가 많을 경우 즉, 스레드간 경쟁이 심할 경우에는 CAS를 적절한 주기를 두어 실행한다.
+		-> 주기를 실패할수록 길게, 성공할수록 짧게 설정 (이를 BackOff라 한다.)
 */
 
 constexpr int MAX_THREADS{ 64 };
 
-//  ظ  ǽڵ
+// 스레드의 이해를 돕기위한 실습코드
 volatile int global{};
 
 void workerThread(int numOfThread)
 {
-	// 1:		 ̽ ߻   
-	// 2:		Ϳ ϸ Ƽ ȯ濡 Cash Thrashing Ͼ  
-	// -> solution2() ذ
+	// 문제1:		데이터 레이스가 발생해 예상밖의 결과가 나옴
+	// 문제2:		데이터영역에 접근하면 멀티스레드 환경에서 Cash Thrashing이 일어나 성능이 떨어짐
+	// -> solution2()에서 해결
 	for (int i = 0; i < 500000000 / numOfThread; ++i) global += 2;
 }
 
@@ -132,7 +132,7 @@ void testThread()
 	}
 }
 
-// join() detach()  ǽڵ
+// join()과 detach()에 대한 실습코드
 void printID(int myID)
 {
 	cout << "My Thread ID: " << myID << endl;
@@ -154,27 +154,27 @@ void solution1()
 		threads[i].detach();
 	}
 	for (auto& thread : threads)
-		if (thread.joinable())	// join() ȣ  ִ Ȯ
-			thread.join();		// detachǸ join() ȣ ʱ   ൵ α׷ ȴ.
+		if (thread.joinable())	// join()을 호출할 수 있는지 확인
+			thread.join();		// detach되면 join()이 호출되지 않기 때문에 스레드 실행도중 프로그램이 종료된다.
 }
 
-// ȣ, Ӱ迵  ǽڵ
-int sum{};					//  ڿ
-atomic<int> atomicSum{};	//  ڿ
-mutex m{};					// mtx ü
+// 상호배제, 임계영역에 대한 실습코드
+int sum{};					// 스레드 공유자원
+atomic<int> atomicSum{};	// 스레드 공유자원
+mutex m{};					// mtx 객체
 
 void add(int numOfThread)
 {
-	volatile int localSum{};	// release ׽Ʈ  volatile 
+	volatile int localSum{};	// release 테스트를 위해 volatile 사용
 
-	// ϸ ϴ lock ʰ ϱ  ú 
+	// 부하를 유발하는 lock을 사용하지않고 연산하기 위해 로컬변수를 사용
 	for (int i = 0; i < 500000000 / numOfThread; ++i) localSum += 2;
 
-	m.lock();			// lock ɾ DataRace  sum  ٸ  
-	sum += localSum;	// ú  (ڿ) ٶ lock 
+	m.lock();			// lock을 걸어주지않으면 DataRace에 의해 sum은 예상과 다른 값이 됨
+	sum += localSum;	// 로컬변수의 결과를 전역변수(공유자원)에 더해줄때만 lock을 사용
 	m.unlock();
 
-	atomicSum += localSum;	// atomic ü ϸ lock ʿ
+	atomicSum += localSum;	// atomic 객체를 사용하면 lock이 필요없음
 }
 
 void solution2()